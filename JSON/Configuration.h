@@ -0,0 +1,40 @@
+// Copyright Benoit Blanchon 2014
+// MIT License
+//
+// Arduino JSON library
+// https://github.com/bblanchon/ArduinoJson
+
+#pragma once
+
+// Size from which JsonObject and JsonArray build a lookup index (a hash table
+// on the keys, an offset table for the arrays) the first time they are
+// searched. The index is allocated in the JsonBuffer, so keep some headroom
+// in a StaticJsonBuffer holding big documents (see JSON_INDEX_SIZE).
+// Define to 0 to always use the linear scan.
+#ifndef ARDUINOJSON_INDEX_THRESHOLD
+#define ARDUINOJSON_INDEX_THRESHOLD 16
+#endif
+
+// Define to 1 to store floating point values as float instead of double.
+// JsonVariant shrinks from 12 to 8 bytes on 32-bit targets, at the cost of
+// precision (about 7 significant digits).
+#ifndef ARDUINOJSON_USE_FLOAT32
+#define ARDUINOJSON_USE_FLOAT32 0
+#endif
+
+// Define to 1 to link the list nodes with 16-bit self-relative offsets
+// instead of pointers, and to pack nodes on 2-byte boundaries.
+// Nodes must then be less than 64KB apart, which always holds in a
+// StaticJsonBuffer. Don't use it with a DynamicJsonBuffer: its first block
+// lives on the stack and the others on the heap, add() would fail.
+#ifndef ARDUINOJSON_USE_NODE_OFFSETS
+#define ARDUINOJSON_USE_NODE_OFFSETS 0
+#endif
+
+// Alignment of the payloads inside the nodes: a word is enough even for a
+// double on the Cortex-M, and half a word keeps unaligned accesses cheap.
+#if ARDUINOJSON_USE_NODE_OFFSETS
+#define ARDUINOJSON_PACKED_MEMBER __attribute__((packed, aligned(2)))
+#else
+#define ARDUINOJSON_PACKED_MEMBER __attribute__((packed, aligned(4)))
+#endif
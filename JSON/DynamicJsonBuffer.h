@@ -23,7 +23,8 @@ class DynamicJsonBuffer : public JsonBuffer {
 
   size_t blockCount() const { return 1 + (_next ? _next->blockCount() : 0); }
 
-  static const size_t BLOCK_CAPACITY = 32;
+  // 32 bytes on the 32-bit targets, room for a JsonObject on 64-bit hosts
+  static const size_t BLOCK_CAPACITY = 8 * sizeof(void*);
 
  protected:
   virtual void* alloc(size_t bytes) {
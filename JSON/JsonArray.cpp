@@ -15,8 +15,14 @@ using namespace ArduinoJson::Internals;
 JsonArray JsonArray::_invalid(NULL);
 
 JsonVariant &JsonArray::at(int index) const {
+  if (index < 0 || index >= _size) return JsonVariant::invalid();
+
+  if (ARDUINOJSON_INDEX_THRESHOLD > 0 &&
+      _size >= ARDUINOJSON_INDEX_THRESHOLD && (_index || buildIndex()))
+    return _index[index]->content;
+
   node_type *node = _firstNode;
-  while (node && index--) node = node->next;
+  while (node && index--) node = node->getNext();
   return node ? node->content : JsonVariant::invalid();
 }
 
@@ -24,11 +30,39 @@ JsonVariant &JsonArray::add() {
   node_type *node = createNode();
   if (!node) return JsonVariant::invalid();
 
-  addNode(node);
+  if (!addNode(node)) return JsonVariant::invalid();
+  if (_index) {
+    if (_indexCount < _indexCapacity)
+      _index[_indexCount++] = node;
+    else
+      _index = NULL;  // full, a bigger table will be built on next lookup
+  }
 
   return node->content;
 }
 
+bool JsonArray::buildIndex() const {
+  // round up to leave room for the next elements
+  size_t capacity = ARDUINOJSON_INDEX_THRESHOLD;
+  while (capacity < static_cast<size_t>(_size)) capacity <<= 1;
+  if (capacity > 0xFFFF || !_buffer) return false;
+#if ARDUINOJSON_USE_NODE_OFFSETS
+  // a bigger table would put the next nodes out of reach of the offsets
+  if (capacity * sizeof(node_type *) > 0x4000) return false;
+#endif
+
+  void *table = _buffer->alloc(capacity * sizeof(node_type *));
+  if (!table) return false;
+
+  _index = static_cast<node_type **>(table);
+  _indexCapacity = static_cast<uint16_t>(capacity);
+  _indexCount = 0;
+  for (node_type *node = _firstNode; node; node = node->getNext()) {
+    _index[_indexCount++] = node;
+  }
+  return true;
+}
+
 JsonArray &JsonArray::createNestedArray() {
   if (!_buffer) return JsonArray::invalid();
   JsonArray &array = _buffer->createArray();
@@ -50,7 +84,7 @@ void JsonArray::writeTo(JsonWriter &writer) const {
   while (child) {
     child->content.writeTo(writer);
 
-    child = child->next;
+    child = child->getNext();
     if (!child) break;
 
     writer.writeComma();
@@ -82,7 +82,19 @@ class JsonArray : public Internals::JsonPrintable<JsonArray>,
  private:
   // Create an empty JsonArray attached to the specified JsonBuffer.
   explicit JsonArray(JsonBuffer *buffer)
-      : Internals::List<JsonVariant>(buffer) {}
+      : Internals::List<JsonVariant>(buffer),
+        _index(NULL),
+        _indexCapacity(0),
+        _indexCount(0) {}
+
+  // Allocates and fills the offset table, returns false if allocation fails.
+  bool buildIndex() const;
+
+  // Offset table of the nodes, built by at() once the array holds
+  // ARDUINOJSON_INDEX_THRESHOLD elements.
+  mutable node_type **_index;
+  mutable uint16_t _indexCapacity;
+  mutable uint16_t _indexCount;
 
   // The instance returned by JsonArray::invalid()
   static JsonArray _invalid;
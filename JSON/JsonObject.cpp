@@ -37,13 +37,20 @@ JsonVariant &JsonObject::operator[](const char *key) {
     if (!node) return JsonVariant::invalid();
 
     node->content.key = key;
-    addNode(node);
+    if (!addNode(node)) return JsonVariant::invalid();
+    if (_index) indexNode(node);
   }
 
   return node->content.value;
 }
 
-void JsonObject::remove(char const *key) { removeNode(getNodeAt(key)); }
+void JsonObject::remove(char const *key) {
+  node_type *node = getNodeAt(key);
+  if (!node) return;
+  removeNode(node);
+  // open addressing can't simply forget a slot, rebuild on next lookup
+  _index = NULL;
+}
 
 JsonArray &JsonObject::createNestedArray(char const *key) {
   if (!_buffer) return JsonArray::invalid();
@@ -59,13 +66,71 @@ JsonObject &JsonObject::createNestedObject(const char *key) {
   return object;
 }
 
+// FNV-1a, good enough for the short keys we get
+static uint16_t hashKey(const char *key) {
+  uint32_t hash = 2166136261UL;
+  while (*key) {
+    hash ^= static_cast<uint8_t>(*key++);
+    hash *= 16777619UL;
+  }
+  return static_cast<uint16_t>(hash ^ (hash >> 16));
+}
+
 JsonObject::node_type *JsonObject::getNodeAt(const char *key) const {
-  for (node_type *node = _firstNode; node; node = node->next) {
+  if (ARDUINOJSON_INDEX_THRESHOLD > 0 &&
+      _size >= ARDUINOJSON_INDEX_THRESHOLD && (_index || buildIndex())) {
+    uint16_t slot = hashKey(key) & _indexMask;
+    for (node_type *node; (node = _index[slot]) != NULL;
+         slot = (slot + 1) & _indexMask) {
+      if (!strcmp(node->content.key, key)) return node;
+    }
+    return NULL;
+  }
+
+  for (node_type *node = _firstNode; node; node = node->getNext()) {
     if (!strcmp(node->content.key, key)) return node;
   }
   return NULL;
 }
 
+bool JsonObject::buildIndex() const {
+  // keep the load factor under 1/2
+  size_t capacity = 2 * ARDUINOJSON_INDEX_THRESHOLD;
+  while (capacity < 2 * static_cast<size_t>(_size)) capacity <<= 1;
+  if (capacity > 0x8000 || !_buffer) return false;
+#if ARDUINOJSON_USE_NODE_OFFSETS
+  // a bigger table would put the next nodes out of reach of the offsets
+  if (capacity * sizeof(node_type *) > 0x4000) return false;
+#endif
+
+  void *table = _buffer->alloc(capacity * sizeof(node_type *));
+  if (!table) return false;
+  memset(table, 0, capacity * sizeof(node_type *));
+
+  _index = static_cast<node_type **>(table);
+  _indexMask = static_cast<uint16_t>(capacity - 1);
+  for (node_type *node = _firstNode; node; node = node->getNext()) {
+    indexNode(node);
+  }
+  return true;
+}
+
+void JsonObject::indexNode(node_type *node) const {
+  if (2 * static_cast<size_t>(_size) > static_cast<size_t>(_indexMask) + 1) {
+    // too full, a bigger table will be built on next lookup
+    _index = NULL;
+    return;
+  }
+
+  uint16_t slot = hashKey(node->content.key) & _indexMask;
+  while (_index[slot]) {
+    // same key twice: the first one in the list wins, like the linear scan
+    if (!strcmp(_index[slot]->content.key, node->content.key)) return;
+    slot = (slot + 1) & _indexMask;
+  }
+  _index[slot] = node;
+}
+
 void JsonObject::writeTo(JsonWriter &writer) const {
   writer.beginObject();
 
@@ -75,7 +140,7 @@ void JsonObject::writeTo(JsonWriter &writer) const {
     writer.writeColon();
     node->content.value.writeTo(writer);
 
-    node = node->next;
+    node = node->getNext();
     if (!node) break;
 
     writer.writeComma();
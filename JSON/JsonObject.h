@@ -96,11 +96,24 @@ class JsonObject : public Internals::JsonPrintable<JsonObject>,
 
  private:
   // Create an empty JsonArray attached to the specified JsonBuffer.
-  explicit JsonObject(JsonBuffer *buffer) : Internals::List<JsonPair>(buffer) {}
+  explicit JsonObject(JsonBuffer *buffer)
+      : Internals::List<JsonPair>(buffer), _index(NULL), _indexMask(0) {}
 
   // Returns the list node that matches the specified key.
   node_type *getNodeAt(key_type key) const;
 
+  // Allocates and fills the hash index, returns false if allocation fails.
+  bool buildIndex() const;
+
+  // Adds a node to the hash index, drops the index when it is too full.
+  void indexNode(node_type *node) const;
+
+  // Open addressing hash table of the nodes, built by getNodeAt() once the
+  // object holds ARDUINOJSON_INDEX_THRESHOLD pairs.
+  // _indexMask is the capacity of the table minus one.
+  mutable node_type **_index;
+  mutable uint16_t _indexMask;
+
   // The instance returned by JsonObject::invalid()
   static JsonObject _invalid;
 };
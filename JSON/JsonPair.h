@@ -11,8 +11,13 @@
 namespace ArduinoJson {
 
 // A key value pair for JsonObject.
+// The key comes last so that it can fill the tail of the variant
 struct JsonPair {
-  const char* key;
   JsonVariant value;
+#if ARDUINOJSON_USE_NODE_OFFSETS
+  const char* key ARDUINOJSON_PACKED_MEMBER;
+#else
+  const char* key;
+#endif
 };
 }
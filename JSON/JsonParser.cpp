@@ -7,7 +7,6 @@
 #include "JsonParser.h"
 
 #include <stdlib.h>  // for strtol, strtod
-#include <ctype.h>
 
 #include "QuotedString.h"
 #include "JsonArray.h"
@@ -17,8 +16,19 @@
 using namespace ArduinoJson;
 using namespace ArduinoJson::Internals;
 
+// Lookup table of the chars isspace() accepts (' ', \t, \n, \v, \f, \r),
+// one bit per char code below 32
+static const uint32_t SPACE_CHARS = (1UL << (' ' - 1)) | (1UL << ('\t' - 1)) |
+                                    (1UL << ('\n' - 1)) | (1UL << ('\v' - 1)) |
+                                    (1UL << ('\f' - 1)) | (1UL << ('\r' - 1));
+
+static inline bool isSpace(char c) {
+  uint8_t code = static_cast<uint8_t>(c) - 1;  // '\0' wraps to 255
+  return code < 32 && ((SPACE_CHARS >> code) & 1);
+}
+
 void JsonParser::skipSpaces() {
-  while (isspace(*_ptr)) _ptr++;
+  while (isSpace(*_ptr)) _ptr++;
 }
 
 bool JsonParser::skip(char charToSkip) {
@@ -162,7 +172,32 @@ void JsonParser::parseBooleanTo(JsonVariant &destination) {
     destination = JsonVariant::invalid();
 }
 
+// Parses optional '-' and up to 9 digits, enough to never overflow a long.
+// Returns false to let strtol() and strtod() handle everything else.
+static inline bool parseSmallInteger(char *s, char **end, long *result) {
+  bool negative = *s == '-';
+  if (negative) s++;
+
+  char *firstDigit = s;
+  unsigned long value = 0;
+  while (*s >= '0' && *s <= '9') {
+    if (s - firstDigit == 9) return false;
+    value = value * 10 + static_cast<uint8_t>(*s++ - '0');
+  }
+  if (s == firstDigit || *s == '.' || *s == 'e' || *s == 'E') return false;
+
+  *end = s;
+  *result = negative ? -static_cast<long>(value) : static_cast<long>(value);
+  return true;
+}
+
 void JsonParser::parseNumberTo(JsonVariant &destination) {
+  long integerValue;
+  if (parseSmallInteger(_ptr, &_ptr, &integerValue)) {
+    destination = integerValue;
+    return;
+  }
+
   char *endOfLong;
   long longValue = strtol(_ptr, &endOfLong, 10);
   char stopChar = *endOfLong;
@@ -174,7 +209,8 @@ void JsonParser::parseNumberTo(JsonVariant &destination) {
     // Yes => parse it as a double
     double doubleValue = strtod(_ptr, &_ptr);
     // Count the decimal digits
-    uint8_t decimals = static_cast<uint8_t>(_ptr - endOfLong - 1);
+    long digits = _ptr - endOfLong - 1;
+    uint8_t decimals = static_cast<uint8_t>(digits > 255 ? 255 : digits);
     // Set the variant as a double
     destination.set(doubleValue, decimals);
   } else {
@@ -52,8 +52,11 @@ void JsonVariant::set(const char *value) {
 
 void JsonVariant::set(double value, uint8_t decimals) {
   if (_type == JSON_INVALID) return;
-  _type = static_cast<JsonVariantType>(JSON_DOUBLE_0_DECIMALS + decimals);
-  _content.asDouble = value;
+  // _type is a byte, more decimals would wrap into the other types
+  if (decimals > 255 - JSON_DOUBLE_0_DECIMALS)
+    decimals = 255 - JSON_DOUBLE_0_DECIMALS;
+  _type = static_cast<uint8_t>(JSON_DOUBLE_0_DECIMALS + decimals);
+  _content.asDouble = static_cast<JsonFloat>(value);
 }
 
 void JsonVariant::set(long value) {
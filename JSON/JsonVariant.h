@@ -174,11 +174,12 @@ class JsonVariant : public Internals::JsonPrintable<JsonVariant> {
     return static_cast<T>(as<long>());
   }
 
-  // The current type of the variant
-  Internals::JsonVariantType _type;
+  // The current type of the variant, a JsonVariantType on a single byte
+  uint8_t _type;
 
   // The various alternatives for the value of the variant.
-  Internals::JsonVariantContent _content;
+  // Packed right after the tag rather than on the alignment of a double.
+  Internals::JsonVariantContent _content ARDUINOJSON_PACKED_MEMBER;
 
   // The instance returned by JsonVariant::invalid()
   static JsonVariant _invalid;
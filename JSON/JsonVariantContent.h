@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include "Configuration.h"
+
 namespace ArduinoJson {
 
 // Forward declarations
@@ -16,9 +18,15 @@ namespace Internals {
 
 // A union that defines the actual content of a JsonVariant.
 // The enum JsonVariantType determines which member is in use.
+#if ARDUINOJSON_USE_FLOAT32
+typedef float JsonFloat;
+#else
+typedef double JsonFloat;
+#endif
+
 union JsonVariantContent {
   bool asBoolean;
-  double asDouble;       // asDouble is also used for float
+  JsonFloat asDouble;    // asDouble is also used for float
   long asLong;           // asLong is also used for char, short and int
   const char* asString;  // asString can be null
   JsonArray* asArray;    // asArray cannot be null
@@ -12,22 +12,23 @@
 using namespace ArduinoJson;
 using namespace ArduinoJson::Internals;
 
-template <typename T>
-int List<T>::size() const {
-  int nodeCount = 0;
-  for (node_type *node = _firstNode; node; node = node->next) nodeCount++;
-  return nodeCount;
-}
-
 template <typename T>
 void List<T>::removeNode(node_type *nodeToRemove) {
   if (!nodeToRemove) return;
-  if (nodeToRemove == _firstNode) {
-    _firstNode = nodeToRemove->next;
+  node_type *previous = NULL;
+  if (nodeToRemove != _firstNode) {
+    previous = _firstNode;
+    while (previous && previous->getNext() != nodeToRemove)
+      previous = previous->getNext();
+    if (!previous) return;
+  }
+  if (previous) {
+    if (!previous->setNext(nodeToRemove->getNext())) return;
   } else {
-    for (node_type *node = _firstNode; node; node = node->next)
-      if (node->next == nodeToRemove) node->next = nodeToRemove->next;
+    _firstNode = nodeToRemove->getNext();
   }
+  if (_lastNode == nodeToRemove) _lastNode = previous;
+  _size--;
 }
 
 template class ArduinoJson::Internals::List<JsonPair>;
@@ -6,10 +6,19 @@
 
 #pragma once
 
+#include "Configuration.h"
 #include "JsonBuffer.h"
 #include "ListConstIterator.h"
 #include "ListIterator.h"
 
+// Upper bound of the memory taken by the index of a JsonObject or a JsonArray
+// with n elements, including the tables left behind while it was growing.
+#define JSON_INDEX_SIZE(NUMBER_OF_ELEMENTS)                              \
+  (ARDUINOJSON_INDEX_THRESHOLD > 0 &&                                    \
+           (NUMBER_OF_ELEMENTS) >= ARDUINOJSON_INDEX_THRESHOLD           \
+       ? 8 * (NUMBER_OF_ELEMENTS) * sizeof(void *)                       \
+       : 0)
+
 namespace ArduinoJson {
 namespace Internals {
 
@@ -29,7 +38,8 @@ class List {
   // When buffer is NULL, the List is not able to grow and success() returns
   // false. This is used to identify bad memory allocations and parsing
   // failures.
-  explicit List(JsonBuffer *buffer) : _buffer(buffer), _firstNode(NULL) {}
+  explicit List(JsonBuffer *buffer)
+      : _buffer(buffer), _firstNode(NULL), _lastNode(NULL), _size(0) {}
 
   // Returns true if the object is valid
   // Would return false in the following situation:
@@ -39,7 +49,7 @@ class List {
 
   // Returns the numbers of elements in the list.
   // For a JsonObject, it would return the number of key-value pairs
-  int size() const;
+  int size() const { return _size; }
 
   iterator begin() { return iterator(_firstNode); }
   iterator end() { return iterator(NULL); }
@@ -53,20 +63,24 @@ class List {
     return new (_buffer) node_type();
   }
 
-  void addNode(node_type *nodeToAdd) {
-    if (_firstNode) {
-      node_type *lastNode = _firstNode;
-      while (lastNode->next) lastNode = lastNode->next;
-      lastNode->next = nodeToAdd;
+  // Returns false if the node can't be linked (see ListNode::setNext())
+  bool addNode(node_type *nodeToAdd) {
+    if (_lastNode) {
+      if (!_lastNode->setNext(nodeToAdd)) return false;
     } else {
       _firstNode = nodeToAdd;
     }
+    _lastNode = nodeToAdd;
+    _size++;
+    return true;
   }
 
   void removeNode(node_type *nodeToRemove);
 
   JsonBuffer *_buffer;
   node_type *_firstNode;
+  node_type *_lastNode;
+  uint16_t _size;
 };
 }
 }
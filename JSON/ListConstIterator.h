@@ -29,7 +29,7 @@ class ListConstIterator {
   }
 
   ListConstIterator<T> &operator++() {
-    if (_node) _node = _node->next;
+    if (_node) _node = _node->getNext();
     return *this;
   }
 
@@ -30,7 +30,7 @@ class ListIterator {
   }
 
   ListIterator<T> &operator++() {
-    if (_node) _node = _node->next;
+    if (_node) _node = _node->getNext();
     return *this;
   }
 
@@ -6,8 +6,10 @@
 
 #pragma once
 
-#include <stddef.h>  // for NULL
+#include <stddef.h>  // for NULL, ptrdiff_t
+#include <stdint.h>  // for int16_t
 
+#include "Configuration.h"
 #include "JsonBufferAllocated.h"
 
 namespace ArduinoJson {
@@ -17,9 +19,44 @@ namespace Internals {
 // Used by List<T> and its iterators.
 template <typename T>
 struct ListNode : public Internals::JsonBufferAllocated {
-  ListNode() : next(NULL) {}
+#if ARDUINOJSON_USE_NODE_OFFSETS
+  ListNode() : _nextOffset(0) {}
+
+  ListNode<T> *getNext() const {
+    if (!_nextOffset) return NULL;
+    return reinterpret_cast<ListNode<T> *>(
+        const_cast<char *>(reinterpret_cast<const char *>(this)) +
+        2 * static_cast<ptrdiff_t>(_nextOffset));
+  }
+
+  // Returns false if the node is too far away to be linked
+  bool setNext(ListNode<T> *node) {
+    if (!node) {
+      _nextOffset = 0;
+      return true;
+    }
+    ptrdiff_t distance =
+        reinterpret_cast<char *>(node) - reinterpret_cast<char *>(this);
+    if ((distance & 1) || distance < -65536 || distance > 65534) return false;
+    _nextOffset = static_cast<int16_t>(distance / 2);
+    return true;
+  }
+
+  // Distance to the next node in 2-byte units, 0 for the last node
+  int16_t _nextOffset;
+#else
+  ListNode() : _next(NULL) {}
+
+  ListNode<T> *getNext() const { return _next; }
+
+  bool setNext(ListNode<T> *node) {
+    _next = node;
+    return true;
+  }
+
+  ListNode<T> *_next;
+#endif
 
-  ListNode<T> *next;
   T content;
 };
 }
@@ -8,19 +8,24 @@
 
 #include "Print.h"
 
-#include <stdio.h>  // for sprintf
+#include <stdio.h>   // for sprintf
+#include <string.h>  // for strlen
 
-size_t Print::print(const char s[]) {
+size_t Print::write(const uint8_t *buffer, size_t size) {
   size_t n = 0;
-  while (*s) {
-    n += write(*s++);
+  while (size--) {
+    n += write(*buffer++);
   }
   return n;
 }
 
+size_t Print::print(const char s[]) {
+  return write(reinterpret_cast<const uint8_t *>(s), strlen(s));
+}
+
 size_t Print::print(double value, int digits) {
   char tmp[32];
-  sprintf(tmp, "%.*f", digits, value);
+  snprintf(tmp, sizeof(tmp), "%.*f", digits, value);
   return print(tmp);
 }
 
@@ -11,6 +11,7 @@ class Print {
   virtual ~Print() {}
 
   virtual size_t write(uint8_t) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
 
   size_t print(const char[]);
   size_t print(double, int = 2);
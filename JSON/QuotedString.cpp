@@ -6,6 +6,9 @@
 
 #include "QuotedString.h"
 
+#include <stdint.h>  // for uintptr_t
+#include <string.h>  // for memcpy
+
 using namespace ArduinoJson::Internals;
 
 static inline char getSpecialChar(char c) {
@@ -52,6 +55,39 @@ static char unescapeChar(char c) {
 
 static inline bool isQuote(char c) { return c == '\"' || c == '\''; }
 
+// Word-at-a-time helpers, see "Bit Twiddling Hacks" (haszero)
+static const uint32_t ONES = 0x01010101UL;
+static const uint32_t HIGHS = 0x80808080UL;
+
+static inline uint32_t hasZeroByte(uint32_t word) {
+  return (word - ONES) & ~word & HIGHS;
+}
+
+static inline uint32_t hasByte(uint32_t word, char c) {
+  return hasZeroByte(word ^ (ONES * static_cast<uint8_t>(c)));
+}
+
+// Returns the first '\0', backslash or stopChar from s.
+// Works 4 chars at a time once s is aligned: an aligned word never crosses
+// the end of the memory holding the terminating '\0'.
+static char *findSpecialChar(char *s, char stopChar) {
+  while (reinterpret_cast<uintptr_t>(s) & 3) {
+    if (*s == '\0' || *s == stopChar || *s == '\\') return s;
+    s++;
+  }
+
+  for (;;) {
+    uint32_t word;
+    memcpy(&word, s, sizeof(word));
+    if (hasZeroByte(word) | hasByte(word, stopChar) | hasByte(word, '\\'))
+      break;
+    s += sizeof(word);
+  }
+
+  while (*s != '\0' && *s != stopChar && *s != '\\') s++;
+  return s;
+}
+
 char *QuotedString::extractFrom(char *input, char **endPtr) {
   char firstChar = *input;
 
@@ -63,8 +99,10 @@ char *QuotedString::extractFrom(char *input, char **endPtr) {
   char stopChar = firstChar;  // closing quote is the same as opening quote
 
   char *startPtr = input + 1;  // skip the quote
-  char *readPtr = startPtr;
-  char *writePtr = startPtr;
+
+  // Nothing to copy until the first escaped char
+  char *readPtr = findSpecialChar(startPtr, stopChar);
+  char *writePtr = readPtr;
   char c;
 
   for (;;) {
@@ -94,3 +94,27 @@ uint64_t StringToUInt64(const char *strData)
 
   return retValue;
 }
+
+// CRC-32 (IEEE 802.3), one nibble at a time to keep the table small
+static const uint32_t crc32Nibble[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+	0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+	0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+// Feed one byte, start with crc = 0
+uint32_t UpdateCRC32(uint32_t crc, uint8_t data)
+{
+	crc = ~crc;
+	crc = crc32Nibble[(crc ^ data) & 0x0F] ^ (crc >> 4);
+	crc = crc32Nibble[(crc ^ (data >> 4)) & 0x0F] ^ (crc >> 4);
+	return ~crc;
+}
+
+uint32_t CalcCRC32(const void *buf, size_t len, uint32_t crc)
+{
+	const uint8_t *p = (const uint8_t *)buf;
+	while( len-- ) crc = UpdateCRC32(crc, *p++);
+	return crc;
+}
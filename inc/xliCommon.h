@@ -156,12 +156,17 @@ typedef enum
 #define TheSerial       Serial
 #endif
 
+// Console output goes through the buffer in xlxBufferedPrint
 #ifndef SERIAL
-#define SERIAL          TheSerial.printf
+#define SERIAL          theOutput.printf
 #endif
 
 #ifndef SERIAL_LN
-#define SERIAL_LN       TheSerial.printlnf
+#define SERIAL_LN       theOutput.printlnf
+#endif
+
+#ifndef SERIAL_FLUSH
+#define SERIAL_FLUSH    theOutput.flush
 #endif
 
 #ifndef ASRPort
@@ -175,6 +180,8 @@ uint8_t h2i(const char c);
 char* PrintUint64(char *buf, uint64_t value, bool bHex = true);
 char* PrintMacAddress(char *buf, const uint8_t *mac, char delim = ':');
 uint64_t StringToUInt64(const char *strData);
+uint32_t UpdateCRC32(uint32_t crc, uint8_t data);
+uint32_t CalcCRC32(const void *buf, size_t len, uint32_t crc = 0);
 inline time_t tmConvert_t(US YYYY, UC MM, UC DD, UC hh, UC mm, UC ss)  // inlined for speed
 {
   struct tm t;
@@ -189,4 +196,6 @@ inline time_t tmConvert_t(US YYYY, UC MM, UC DD, UC hh, UC mm, UC ss)  // inline
   return t_of_day;
 };
 
+#include "xlxBufferedPrint.h"
+
 #endif /* xliCommon_h */
@@ -8,30 +8,35 @@
 //#define XL_FLASHEE_EEPROM
 
 //------------------------------------------------------------------
-// Emulated EEPROM: 2048bytes
+// Emulated EEPROM: 2047bytes, 0x000-0x7FE
 //------------------------------------------------------------------
+#define MEM_EEPROM_SIZE           2047
 #define MEM_BANK_1_BASE           0x800C000
 #define MEM_BANK_2_BASE           0x8010000
 
-// Device Status (16*48bytes)
+// Device Status (16*22bytes, twice, plus change records)
 #ifdef XL_FLASHEE_EEPROM
 #define MEM_DEVICE_STATUS_OFFSET  MEM_BANK_1_BASE
 #else
 #define MEM_DEVICE_STATUS_OFFSET  0x0000
 #endif
-#define MEM_DEVICE_STATUS_LEN     0x0300
+#define MEM_DEVICE_STATUS_LEN     0x0380
 
 // Parameters (256bytes)
 #define MEM_CONFIG_OFFSET         (MEM_DEVICE_STATUS_OFFSET + MEM_DEVICE_STATUS_LEN)
 #define MEM_CONFIG_LEN            0x0100
 
-// Schedule (256bytes)
+// Schedule (240bytes)
 #define MEM_SCHEDULE_OFFSET       (MEM_CONFIG_OFFSET + MEM_CONFIG_LEN)
-#define MEM_SCHEDULE_LEN          0x0100
+#define MEM_SCHEDULE_LEN          0x00F0
 
-// Node ID List (64*12bytes)
+// Node ID List (64*10bytes)
 #define MEM_NODELIST_OFFSET       (MEM_SCHEDULE_OFFSET + MEM_SCHEDULE_LEN)
-#define MEM_NODELIST_LEN          0x0300
+#define MEM_NODELIST_LEN          0x0280
+
+#if MEM_NODELIST_OFFSET + MEM_NODELIST_LEN - MEM_DEVICE_STATUS_OFFSET > MEM_EEPROM_SIZE
+#error "Emulated EEPROM regions don't fit in MEM_EEPROM_SIZE"
+#endif
 
 //------------------------------------------------------------------
 // P1 external Flash: 1MB, access via SPI flash library
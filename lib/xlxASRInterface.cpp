@@ -31,11 +31,18 @@
 #include "xlxASRInterface.h"
 #include "xlSmartRemote.h"
 #include "xlxConfig.h"
+#include "xlxScenario.h"
+#include "xlxRuleEngine.h"
+#include "xlxStatistics.h"
 
 #define ASR_TXCMD_PREFIX          0xbb
 #define ASR_RXCMD_PREFIX          0xaa
 #define ASR_CMD_LEN               3
 
+// Delay before executing a command, while the module plays its voice
+#define ASR_DELAY_SPEAKER         3000        // ms
+#define ASR_DELAY_QUIET           200         // ms
+
 //------------------------------------------------------------------
 // the one and only instance of ASRInterfaceClass
 ASRInterfaceClass theASR;
@@ -49,6 +56,7 @@ ASRInterfaceClass::ASRInterfaceClass()
   m_revCmd = 0;
   m_sndCmd = 0;
   m_delayCmdTimer = 0;
+  m_cmdPending = false;
 }
 
 void ASRInterfaceClass::Init(US _speed)
@@ -80,7 +88,8 @@ bool ASRInterfaceClass::processCommand()
       if( (UC)incomingByte == (UC)~m_revCmd ) {
         // Got a valid command
         /// Notes: delay to execute after voice playing due to lack of current while playing
-        m_delayCmdTimer = (theConfig.IsSpeakerEnabled() ? 30 : 2);   // * RTE_DELAY_SELFCHECK ms
+        m_delayCmdTimer = millis() + (theConfig.IsSpeakerEnabled() ? ASR_DELAY_SPEAKER : ASR_DELAY_QUIET);
+        m_cmdPending = true;
         //executeCmd(m_revCmd);
         rc = true;
       }
@@ -89,17 +98,22 @@ bool ASRInterfaceClass::processCommand()
   }
 
   // Delay Execution
-  if( m_delayCmdTimer > 0 ) {
-    if( --m_delayCmdTimer == 0 ) {
-      ASRPort.end();
-      executeCmd(m_revCmd);
-      ASRPort.begin(m_speed);
-    }
+  if( m_cmdPending && (long)(millis() - m_delayCmdTimer) >= 0 ) {
+    m_cmdPending = false;
+    ASRPort.end();
+    executeCmd(m_revCmd);
+    ASRPort.begin(m_speed);
   }
 
   return rc;
 }
 
+bool ASRInterfaceClass::isReady()
+{
+  if( ASRPort.available() > 0 ) return true;
+  return (m_cmdPending && (long)(millis() - m_delayCmdTimer) >= 0);
+}
+
 bool ASRInterfaceClass::sendCommand(UC _cmd)
 {
   UC buf[ASR_CMD_LEN];
@@ -124,6 +138,8 @@ UC ASRInterfaceClass::getLastSentCmd()
 void ASRInterfaceClass::executeCmd(UC _cmd)
 {
   SERIAL_LN("\n\rexecute ASR cmd: 0x%x", _cmd);
+  theRules.SetEvent(_cmd);
+  theStat.Command(STAT_SRC_ASR);
   UC _br;
   US _cct;
 
@@ -153,15 +169,11 @@ void ASRInterfaceClass::executeCmd(UC _cmd)
     break;
 
   case 0x05:    // Scenario
-    _br = BTN_FN2_BR;
-    _cct = BTN_FN2_CCT;
-    theSys.SendChangeBR_CCT(_br, _cct, NODEID_MAINDEVICE);
+    theScenario.Recall(SCN_ID_FN2);
     break;
 
   case 0x06:    // Scenario
-    _br = BTN_FN3_BR;
-    _cct = BTN_FN3_CCT;
-    theSys.SendChangeBR_CCT(_br, _cct, NODEID_MAINDEVICE);
+    theScenario.Recall(SCN_ID_FN3);
     break;
 
   case 0x07:    // lights on
@@ -10,13 +10,16 @@ class ASRInterfaceClass
 protected:
   UC m_revCmd;
   UC m_sndCmd;
-  UL m_delayCmdTimer;
+  UL m_delayCmdTimer;     // millis() when the received command is due
+  bool m_cmdPending;
 
 public:
   ASRInterfaceClass();
 
   void Init(US _speed = SERIALPORT_SPEED_LOW);
   bool processCommand();
+  // Input waiting, or a delayed command due
+  bool isReady();
   bool sendCommand(UC _cmd);
   UC getLastReceivedCmd();
   UC getLastSentCmd();
@@ -0,0 +1,117 @@
+/**
+ * xlxBufferedPrint.cpp - Xlight buffered console output
+ *
+ * Created by Baoshi Sun <bs.sun@datatellit.com>
+ * Copyright (C) 2015-2016 DTIT
+ * Full contributor list:
+ *
+ * Documentation:
+ * Support Forum:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * REVISION HISTORY
+ * Version 1.0 - Created by Baoshi Sun <bs.sun@datatellit.com>
+ *
+ * DESCRIPTION
+ * 1. SERIAL & SERIAL_LN write here instead of the port, so one line goes
+ *    out in one port write rather than one per printf fragment
+ * 2. The buffer is flushed on '\n', when it is full, and by the main loop
+ *    after each round of command processing
+ * 3. Non-blocking mode (default) never waits for the UART, so background
+ *    and log output can't stall the RF loop; excess output is dropped and
+ *    counted
+ * 4. Console command replies block in either mode, so 'help' or 'show dev'
+ *    come out whole
+ *
+ * ToDo:
+ * 1.
+ *
+**/
+
+#include "xlxBufferedPrint.h"
+
+//------------------------------------------------------------------
+// the one and only instance of BufferedPrintClass
+BufferedPrintClass theOutput;
+
+//------------------------------------------------------------------
+// Xlight Buffered Print Class
+//------------------------------------------------------------------
+BufferedPrintClass::BufferedPrintClass()
+{
+  m_len = 0;
+  m_nonBlocking = true;
+  m_replyDepth = 0;
+  m_dropped = 0;
+}
+
+size_t BufferedPrintClass::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t BufferedPrintClass::write(const uint8_t *buffer, size_t size)
+{
+  // Long block with nothing pending, no need to copy it
+  if( (!m_nonBlocking || m_replyDepth) && m_len == 0 && size >= sizeof(m_buf) ) {
+    TheSerial.write(buffer, size);
+    return size;
+  }
+
+  size_t n = 0;
+  while( n < size ) {
+    if( m_len >= sizeof(m_buf) ) {
+      flush();
+      if( m_len >= sizeof(m_buf) ) {
+        // TX is still full, drop the rest
+        m_dropped += size - n;
+        break;
+      }
+    }
+
+    // Copy up to the next newline or the end of the free space
+    size_t chunk = size - n;
+    if( chunk > sizeof(m_buf) - m_len ) chunk = sizeof(m_buf) - m_len;
+    const uint8_t *eol = (const uint8_t *)memchr(buffer + n, '\n', chunk);
+    if( eol ) chunk = eol - (buffer + n) + 1;
+    memcpy(m_buf + m_len, buffer + n, chunk);
+    m_len += chunk;
+    n += chunk;
+    if( eol ) flush();
+  }
+
+  // Report everything as written, dropped bytes are tracked here
+  return size;
+}
+
+void BufferedPrintClass::flush(BOOL wait)
+{
+  if( m_len == 0 ) return;
+
+  size_t n = m_len;
+  if( m_nonBlocking && !m_replyDepth && !wait ) {
+    int room = TheSerial.availableForWrite();
+    if( room <= 0 ) return;
+    if( n > (size_t)room ) n = room;
+  }
+
+  TheSerial.write(m_buf, n);
+  m_len -= n;
+  if( m_len > 0 ) memmove(m_buf, m_buf + n, m_len);
+}
+
+void BufferedPrintClass::discard()
+{
+  m_len = 0;
+}
+
+void BufferedPrintClass::SetNonBlocking(BOOL _nb)
+{
+  if( m_nonBlocking && !_nb ) flush(true);
+  m_nonBlocking = _nb;
+}
@@ -0,0 +1,55 @@
+//  xlxBufferedPrint.h - Xlight buffered console output
+
+#ifndef xlxBufferedPrint_h
+#define xlxBufferedPrint_h
+
+#include "xliCommon.h"
+
+// Size of the console output buffer, a few lines of text
+#ifndef BPRINT_BUFFER_SIZE
+#define BPRINT_BUFFER_SIZE        128
+#endif
+
+//------------------------------------------------------------------
+// Buffered Print Class
+//------------------------------------------------------------------
+// Collects small writes (printf fragments, echoed chars, JSON tokens) and
+// passes them to the serial port in chunks, on newline or when full.
+// In non-blocking mode a chunk is only written as far as the UART TX buffer
+// has room; what doesn't fit stays here, and overflow is dropped & counted.
+/// That is for background and log output: a console command's reply runs
+/// between BeginReply() and EndReply() and is written in full, blocking.
+class BufferedPrintClass : public Print
+{
+private:
+  uint8_t m_buf[BPRINT_BUFFER_SIZE];
+  US m_len;
+  BOOL m_nonBlocking;
+  UC m_replyDepth;              // inside a console command, block anyway
+  UL m_dropped;                 // bytes dropped in non-blocking mode
+
+public:
+  BufferedPrintClass();
+
+  virtual size_t write(uint8_t c);
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  using Print::write;
+
+  // Pass buffered bytes to the port, wait = true forces a blocking write
+  void flush(BOOL wait = false);
+  void discard();
+
+  BOOL IsNonBlocking() { return m_nonBlocking; }
+  void SetNonBlocking(BOOL _nb);
+  void BeginReply() { m_replyDepth++; }
+  void EndReply() { if( m_replyDepth ) m_replyDepth--; }
+  UL GetDroppedBytes() { return m_dropped; }
+  US GetPendingBytes() { return m_len; }
+};
+
+//------------------------------------------------------------------
+// Function & Class Helper
+//------------------------------------------------------------------
+extern BufferedPrintClass theOutput;
+
+#endif /* xlxBufferedPrint_h */
@@ -0,0 +1,195 @@
+/**
+ * xlxCloudPublisher.cpp - Xlight Cloud publish queue, coalesced and rate limited
+ *
+ * Created by Baoshi Sun <bs.sun@datatellit.com>
+ * Copyright (C) 2015-2016 DTIT
+ * Full contributor list:
+ *
+ * Documentation:
+ * Support Forum:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * REVISION HISTORY
+ * Version 1.0 - Created by Baoshi Sun <bs.sun@datatellit.com>
+ *
+ * DESCRIPTION
+ * 1. Console results for Cloud commands (CloudOutput) are published as
+ *    CPUB_EVENT_NAME events, e.g. ["Speaker is enabled","Cloud option 1"]
+ * 2. Token bucket: an event costs CPUB_RATE_MS, the bucket refills in real
+ *    time and holds up to CPUB_BURST events, as the Cloud allows
+ * 3. Whatever queues up while the bucket is empty goes out in the next
+ *    event, as many messages as fit in CPUB_EVENT_SIZE
+ * 4. Errors go first, and may push normal messages out of a full queue
+ * 5. Messages dropped since the last event are noted at its end,
+ *    e.g. "(3 dropped)"
+ * 6. Nothing is published while the Cloud is down, the queue waits
+ *
+ * ToDo:
+ *
+**/
+
+#include "xlxCloudPublisher.h"
+
+//------------------------------------------------------------------
+// the one and only instance of CloudPublisherClass
+CloudPublisherClass thePublisher;
+
+//------------------------------------------------------------------
+// Xlight Cloud Publisher Class
+//------------------------------------------------------------------
+CloudPublisherClass::CloudPublisherClass()
+{
+  m_count = 0;
+  m_tokens = CPUB_BURST * CPUB_RATE_MS;
+  m_lastRefill = 0;
+  m_events = 0;
+  m_published = 0;
+  m_merged = 0;
+  m_dropped = 0;
+  m_droppedShown = 0;
+  m_failed = 0;
+}
+
+BOOL CloudPublisherClass::Add(const char *text, UC prio)
+{
+  if( !text || !text[0] ) return false;
+
+  if( m_count >= CPUB_QUEUE_SIZE ) {
+    // Full: an error takes the place of the oldest normal message
+    UC i = CPUB_QUEUE_SIZE;
+    if( prio == CPUB_PRIO_ERROR ) {
+      for( i = 0; i < m_count; i++ ) {
+        if( m_queue[i].prio != CPUB_PRIO_ERROR ) break;
+      }
+    }
+    m_dropped++;
+    if( i >= m_count ) return false;
+    Remove(i);
+  }
+
+  CloudMsg_t &msg = m_queue[m_count++];
+  msg.prio = prio;
+  msg.queuedMs = millis();
+  strncpy(msg.text, text, CPUB_MSG_SIZE - 1);
+  msg.text[CPUB_MSG_SIZE - 1] = '\0';
+  return true;
+}
+
+void CloudPublisherClass::Remove(UC index)
+{
+  if( index >= m_count ) return;
+  m_count--;
+  if( index < m_count ) memmove(&m_queue[index], &m_queue[index + 1], (m_count - index) * sizeof(CloudMsg_t));
+}
+
+void CloudPublisherClass::Refill()
+{
+  UL now = millis();
+  m_tokens += now - m_lastRefill;
+  if( m_tokens > CPUB_BURST * CPUB_RATE_MS ) m_tokens = CPUB_BURST * CPUB_RATE_MS;
+  m_lastRefill = now;
+}
+
+// Append text as a JSON string after pos, with a comma if it isn't the
+/// first element. The new pos, or 0 if it doesn't fit before limit.
+US CloudPublisherClass::AppendJson(char *buf, US pos, US limit, const char *text)
+{
+  if( buf[pos - 1] != '[' ) {
+    if( pos >= limit ) return 0;
+    buf[pos++] = ',';
+  }
+  if( pos >= limit ) return 0;
+  buf[pos++] = '"';
+  for( ; *text; text++ ) {
+    char c = *text;
+    if( c == '"' || c == '\\' ) {
+      if( pos >= limit ) return 0;
+      buf[pos++] = '\\';
+    } else if( (UC)c < 0x20 ) {
+      c = ' ';
+    }
+    if( pos >= limit ) return 0;
+    buf[pos++] = c;
+  }
+  if( pos >= limit ) return 0;
+  buf[pos++] = '"';
+  return pos;
+}
+
+void CloudPublisherClass::Tick()
+{
+  Refill();
+  if( m_count == 0 || m_tokens < CPUB_RATE_MS ) return;
+
+  // Give a burst a moment to gather, unless an error waits or there's no room
+  BOOL hasError = false;
+  for( UC i = 0; i < m_count; i++ ) {
+    if( m_queue[i].prio == CPUB_PRIO_ERROR ) hasError = true;
+  }
+  if( !hasError && m_count < CPUB_QUEUE_SIZE && millis() - m_queue[0].queuedMs < CPUB_HOLD_MS ) return;
+
+  // The drop note is sure to fit, the messages get what is left before ']'
+  char strNote[24] = "";
+  if( m_dropped != m_droppedShown ) snprintf(strNote, sizeof(strNote), "(%lu dropped)", m_dropped - m_droppedShown);
+  US limit = CPUB_EVENT_SIZE - 1 - (strNote[0] ? strlen(strNote) + 3 : 0);
+
+  char strData[CPUB_EVENT_SIZE + 1];
+  US pos = 0;
+  strData[pos++] = '[';
+  BOOL taken[CPUB_QUEUE_SIZE];
+  memset(taken, 0x00, sizeof(taken));
+  UC nTaken = 0;
+  BOOL full = false;
+  for( SHORT prio = CPUB_PRIO_ERROR; prio >= CPUB_PRIO_NORMAL && !full; prio-- ) {
+    for( UC i = 0; i < m_count; i++ ) {
+      if( m_queue[i].prio != prio ) continue;
+      US next = AppendJson(strData, pos, limit, m_queue[i].text);
+      // The rest waits for the next event, in order
+      if( !next ) {
+        full = true;
+        break;
+      }
+      pos = next;
+      taken[i] = true;
+      nTaken++;
+    }
+  }
+  if( strNote[0] ) pos = AppendJson(strData, pos, CPUB_EVENT_SIZE - 1, strNote);
+  strData[pos++] = ']';
+  strData[pos] = '\0';
+
+  // A refused publish costs its token too, so a failing Cloud isn't hammered
+  m_tokens -= CPUB_RATE_MS;
+  if( !Particle.publish(CPUB_EVENT_NAME, strData, CPUB_EVENT_TTL, PRIVATE | NO_ACK) ) {
+    m_failed++;
+    return;
+  }
+
+  m_events++;
+  m_published += nTaken;
+  if( nTaken > 1 ) m_merged += nTaken - 1;
+  m_droppedShown = m_dropped;
+  for( SHORT i = m_count - 1; i >= 0; i-- ) {
+    if( taken[i] ) Remove(i);
+  }
+}
+
+void CloudPublisherClass::print()
+{
+  Refill();
+  SERIAL_LN("** Cloud publish: %d queued, %lu.%lu events in the bucket **", m_count,
+      m_tokens / CPUB_RATE_MS, (m_tokens % CPUB_RATE_MS) * 10 / CPUB_RATE_MS);
+  SERIAL_LN("  events:%lu messages:%lu merged:%lu dropped:%lu failed:%lu",
+      m_events, m_published, m_merged, m_dropped, m_failed);
+  UL now = millis();
+  for( UC i = 0; i < m_count; i++ ) {
+    SERIAL_LN("  %5lu ms %s %s", now - m_queue[i].queuedMs,
+        (m_queue[i].prio == CPUB_PRIO_ERROR ? "error " : "normal"), m_queue[i].text);
+  }
+  SERIAL_LN("");
+}
@@ -0,0 +1,75 @@
+//  xlxCloudPublisher.h - Xlight Cloud publish queue, coalesced and rate limited
+
+#ifndef xlxCloudPublisher_h
+#define xlxCloudPublisher_h
+
+#include "xliCommon.h"
+
+#define CPUB_EVENT_NAME           "xlc-console"
+#define CPUB_EVENT_TTL            60
+#define CPUB_EVENT_SIZE           255         // max. event data, bytes
+#define CPUB_MSG_SIZE             96          // a message is cut to this
+#define CPUB_QUEUE_SIZE           8
+#define CPUB_RATE_MS              1000        // one event per second on average
+#define CPUB_BURST                4           // and up to 4 in a row
+#define CPUB_HOLD_MS              200         // wait this long for more to merge, errors don't
+
+// Priorities
+#define CPUB_PRIO_NORMAL          0
+#define CPUB_PRIO_ERROR           1
+
+//------------------------------------------------------------------
+// Cloud Publisher Structures
+//------------------------------------------------------------------
+typedef struct
+{
+  UC prio;
+  UL queuedMs;
+  char text[CPUB_MSG_SIZE];
+} CloudMsg_t;
+
+//------------------------------------------------------------------
+// Cloud Publisher Class
+//------------------------------------------------------------------
+// Add() queues a message and returns; Tick(), from the cloud task, sends
+// what is queued as one event, a JSON array of strings with the errors
+// first, whenever the token bucket allows. So a burst of commands costs a
+// few events instead of being throttled by the Cloud.
+/// A full queue makes room for an error by dropping the oldest normal
+/// message; a normal message that finds the queue full is dropped.
+class CloudPublisherClass
+{
+private:
+  CloudMsg_t m_queue[CPUB_QUEUE_SIZE];      // in order of arrival
+  UC m_count;
+  UL m_tokens;                              // in ms, CPUB_RATE_MS per event
+  UL m_lastRefill;
+
+  // Statistics
+  UL m_events;
+  UL m_published;                           // messages
+  UL m_merged;                              // messages that shared an event
+  UL m_dropped;
+  UL m_droppedShown;                        // m_dropped at the last event
+  UL m_failed;                              // publish() refused
+
+  void Refill();
+  void Remove(UC index);
+  US AppendJson(char *buf, US pos, US size, const char *text);
+
+public:
+  CloudPublisherClass();
+
+  BOOL Add(const char *text, UC prio = CPUB_PRIO_NORMAL);
+  void Tick();
+  UC GetCount() { return m_count; }
+
+  void print();
+};
+
+//------------------------------------------------------------------
+// Function & Class Helper
+//------------------------------------------------------------------
+extern CloudPublisherClass thePublisher;
+
+#endif /* xlxCloudPublisher_h */
@@ -26,6 +26,7 @@
  * 2. Use EEPROM class (high level API) to access the emulated EEPROM.
  * 3. Use spark-flashee-eeprom (low level 3rd party API) to access P1 external Flash.
  * 4. Please refer to xliMemoryMap.h for memory allocation.
+ * 5. Config and device status are saved as delta records, see xlxRecordLog.
  *
  * ToDo:
  * 1. Move default config values to header as global #define's
@@ -36,24 +37,100 @@
 #include "xlxConfig.h"
 #include "xliMemoryMap.h"
 #include "xlxRF24Client.h"
+#include "xlxNodeList.h"
+#include "xlxScheduler.h"
+#include "xlxStatistics.h"
+#include "xlxProfiler.h"
+#include "xlxLogger.h"
 #include "xlSmartRemote.h"
 
 #define SECS_PER_HOUR (3600UL)
 #define SECS_PER_DAY  (SECS_PER_HOUR * 24UL)
 
 // the one and only instance of ConfigClass
-ConfigClass theConfig = ConfigClass();
+ConfigClass theConfig;
+
+//------------------------------------------------------------------
+// JSON Field Maps
+//------------------------------------------------------------------
+SJ_ACCESSORS(Hue_t, State)
+SJ_ACCESSORS(Hue_t, BR)
+SJ_ACCESSORS(Hue_t, CCT)
+SJ_ACCESSORS(Hue_t, R)
+SJ_ACCESSORS(Hue_t, G)
+SJ_ACCESSORS(Hue_t, B)
+
+static const sjField_t sjHueFields[] = {
+  SJ_NUMBER(Hue_t, "State", State, 0, 1),
+  SJ_NUMBER(Hue_t, "BR", BR, 0, 100),
+  SJ_NUMBER(Hue_t, "CCT", CCT, CT_MIN_VALUE, CT_MAX_VALUE),
+  SJ_NUMBER(Hue_t, "R", R, 0, 255),
+  SJ_NUMBER(Hue_t, "G", G, 0, 255),
+  SJ_NUMBER(Hue_t, "B", B, 0, 255)
+};
+SJ_SCHEMA(Hue_t, sjHueFields, true);
+
+SJ_ACCESSORS(Timezone_t, id)
+SJ_ACCESSORS(Timezone_t, offset)
+SJ_ACCESSORS(Timezone_t, dst)
+
+static const sjField_t sjTimezoneFields[] = {
+  SJ_NUMBER(Timezone_t, "id", id, 1, 500),
+  SJ_NUMBER(Timezone_t, "offset", offset, -780, 780),
+  SJ_NUMBER(Timezone_t, "dst", dst, 0, 1)
+};
+SJ_SCHEMA(Timezone_t, sjTimezoneFields, false);
+
+SJ_ACCESSORS(Config_t, indBrightness)
+SJ_ACCESSORS(Config_t, enableDailyTimeSync)
+SJ_ACCESSORS(Config_t, enableSpeaker)
+SJ_ACCESSORS(Config_t, rfPowerLevel)
+SJ_ACCESSORS(Config_t, stWiFi)
+SJ_ACCESSORS(Config_t, useCloud)
+
+// Left out on purpose: token is a runtime value, version is the layout
+/// (a mismatch resets the config at boot), and nodeID / networkID are the
+/// radio's address, which the RF network assigns
+static const sjField_t sjConfigFields[] = {
+  SJ_NUMBER(Config_t, "indBrightness", indBrightness, 0, 15),
+  SJ_STRUCT(Config_t, "timeZone", timeZone, Timezone_t),
+  SJ_STRING(Config_t, "Organization", Organization),
+  SJ_STRING(Config_t, "ProductName", ProductName),
+  SJ_NUMBER(Config_t, "enableDailyTimeSync", enableDailyTimeSync, 0, 1),
+  SJ_NUMBER(Config_t, "enableSpeaker", enableSpeaker, 0, 1),
+  SJ_NUMBER(Config_t, "rfPowerLevel", rfPowerLevel, RF24_PA_MIN, RF24_PA_MAX),
+  SJ_NUMBER(Config_t, "stWiFi", stWiFi, 0, 1),
+  SJ_NUMBER(Config_t, "useCloud", useCloud, CLOUD_DISABLE, CLOUD_MUST_CONNECT)
+};
+SJ_SCHEMA(Config_t, sjConfigFields, false);
+
+SJ_ACCESSORS(DevStatusRow_t, uid)
+SJ_ACCESSORS(DevStatusRow_t, node_id)
+SJ_ACCESSORS(DevStatusRow_t, present)
+SJ_ACCESSORS(DevStatusRow_t, type)
+
+static const sjField_t sjDevStatusFields[] = {
+  SJ_NUMBER(DevStatusRow_t, "uid", uid, 0, 255),
+  SJ_NUMBER(DevStatusRow_t, "node_id", node_id, 0, 255),
+  SJ_NUMBER(DevStatusRow_t, "present", present, 0, 1),
+  SJ_NUMBER(DevStatusRow_t, "type", type, 0, 255),
+  SJ_ARRAY(DevStatusRow_t, "ring", ring, Hue_t)
+};
+SJ_SCHEMA(DevStatusRow_t, sjDevStatusFields, false);
 
 //------------------------------------------------------------------
 // Xlight Config Class
 //------------------------------------------------------------------
 ConfigClass::ConfigClass()
+  : m_configLog(MEM_CONFIG_OFFSET, MEM_CONFIG_LEN, &m_savedConfig, sizeof(Config_t)),
+    m_devStatusLog(MEM_DEVICE_STATUS_OFFSET, MEM_DEVICE_STATUS_LEN, m_savedDevStatus, sizeof(m_devStatus))
 {
   m_isLoaded = false;
   m_isChanged = false;
-  m_isDSTChanged = false;
+  m_dstChanged = 0;
 	m_lastTimeSync = millis();
   InitConfig();
+  InitDevStatus();
 }
 
 void ConfigClass::InitConfig()
@@ -76,7 +153,7 @@ void ConfigClass::InitConfig()
   m_config.stWiFi = 1;
 }
 
-void ConfigClass::InitDevStatus(UC nodeID)
+void ConfigClass::InitDevRow(UC row, UC nodeID)
 {
 	Hue_t whiteHue;
 	whiteHue.B = 0;
@@ -86,34 +163,76 @@ void ConfigClass::InitDevStatus(UC nodeID)
 	whiteHue.CCT = 2700;
 	whiteHue.State = 1; // 1 for on, 0 for off
 
-	m_devStatus.uid = 0;
-	m_devStatus.node_id = nodeID;
-	m_devStatus.present = 0;
-	m_devStatus.type = devtypWRing3;  // White 3 rings
-	m_devStatus.ring[0] = whiteHue;
-	m_devStatus.ring[1] = whiteHue;
-	m_devStatus.ring[2] = whiteHue;
+	DevStatusRow_t &dev = m_devStatus[row];
+	dev.uid = row;
+	dev.node_id = nodeID;
+	dev.present = 0;
+	dev.reserved = 0;
+	dev.type = devtypWRing3;  // White 3 rings
+	dev.ring[0] = whiteHue;
+	dev.ring[1] = whiteHue;
+	dev.ring[2] = whiteHue;
+}
+
+// Empty table with the main device in the first row
+void ConfigClass::InitDevStatus()
+{
+	memset(m_devStatus, 0x00, sizeof(m_devStatus));
+	for( UC row = 0; row < MAX_DEVICE_PER_CONTROLLER; row++ ) {
+		m_devStatus[row].uid = row;
+		m_devStatus[row].node_id = DST_ROW_FREE;
+	}
+	InitDevRow(0, NODEID_MAINDEVICE);
+	BuildDevIndex();
+}
+
+void ConfigClass::BuildDevIndex()
+{
+	memset(m_devIndex, DST_ROW_NONE, sizeof(m_devIndex));
+	for( UC row = 0; row < MAX_DEVICE_PER_CONTROLLER; row++ ) {
+		UC nID = m_devStatus[row].node_id;
+		if( nID != DST_ROW_FREE && nID <= NODEID_MAX_DEVCIE )
+			m_devIndex[nID] = row;
+	}
+}
+
+// Row of the device, or -1 if it's unknown (and can't be added)
+SHORT ConfigClass::GetDevRow(UC _nodeID, BOOL _add)
+{
+	if( IS_NOT_DEVICE_NODEID(_nodeID) ) return -1;
+	if( m_devIndex[_nodeID] != DST_ROW_NONE ) return m_devIndex[_nodeID];
+	if( !_add ) return -1;
+
+	for( UC row = 0; row < MAX_DEVICE_PER_CONTROLLER; row++ ) {
+		if( m_devStatus[row].node_id == DST_ROW_FREE ) {
+			InitDevRow(row, _nodeID);
+			m_devIndex[_nodeID] = row;
+			SetDevRowChanged(row);
+			SERIAL_LN("Device %d added to DST row %d", _nodeID, row);
+			return row;
+		}
+	}
+	SERIAL_LN("DST is full, device %d ignored", _nodeID);
+	return -1;
+}
+
+void ConfigClass::SetDevRowChanged(UC row)
+{
+	m_dstChanged |= BITMASK(row);
 }
 
 BOOL ConfigClass::LoadConfig()
 {
   // Load System Configuration
-  if( sizeof(Config_t) <= MEM_CONFIG_LEN )
+  // Two slots of it must fit, see xlxRecordLog
+  if( 2 * (sizeof(RecordLogHeader_t) + sizeof(Config_t)) <= MEM_CONFIG_LEN )
   {
-    EEPROM.get(MEM_CONFIG_OFFSET, m_config);
-    if( m_config.version == 0xFF
-      || m_config.timeZone.id == 0
-      || m_config.timeZone.id > 500
-      || m_config.timeZone.dst > 1
-      || m_config.timeZone.offset < -780
-      || m_config.timeZone.offset > 780
-			|| m_config.rfPowerLevel > RF24_PA_MAX
-      || m_config.useCloud > CLOUD_MUST_CONNECT )
+    // The slot CRC vouches for the content, only the layout version matters
+    if( !m_configLog.Load(&m_config) || m_config.version != VERSION_CONFIG_DATA )
     {
       InitConfig();
-      m_isChanged = true;
       SERIAL_LN(F("Sysconfig is empty, use default settings."));
-      SaveConfig();
+      m_configLog.Format(&m_config);
     }
     else
     {
@@ -129,21 +248,36 @@ BOOL ConfigClass::LoadConfig()
 
 	// Load Device Status
 	LoadDeviceStatus();
+
+	// Load Node List
+	theNodeList.Load();
+
+	// Load Schedules
+	theScheduler.Load();
   return m_isLoaded;
 }
 
 BOOL ConfigClass::SaveConfig()
 {
+  UL saveStart = micros();
   if( m_isChanged )
   {
-    EEPROM.put(MEM_CONFIG_OFFSET, m_config);
+    US nBytes = m_configLog.Save(&m_config);
     m_isChanged = false;
-    SERIAL_LN(F("Sysconfig saved."));
+    SERIAL_LN("Sysconfig saved, %d bytes written.", nBytes);
   }
 
 	// Save Device Status
 	SaveDeviceStatus();
 
+	// Save changed Node List rows
+	US nRows = theNodeList.Save();
+	if( nRows > 0 ) SERIAL_LN("NodeList saved, %d row(s) written.", nRows);
+
+	// Save Schedules
+	theScheduler.Save();
+
+	theProfiler.Record(PERF_SAVE_CONFIG, micros() - saveStart);
   return true;
 }
 
@@ -164,12 +298,12 @@ void ConfigClass::SetConfigChanged(BOOL flag)
 
 BOOL ConfigClass::IsDSTChanged()
 {
-  return m_isDSTChanged;
+  return (m_dstChanged != 0);
 }
 
 void ConfigClass::SetDSTChanged(BOOL flag)
 {
-	m_isDSTChanged = flag;
+	m_dstChanged = (flag ? (US)((1UL << MAX_DEVICE_PER_CONTROLLER) - 1) : 0);
 }
 
 UC ConfigClass::GetVersion()
@@ -210,6 +344,9 @@ void ConfigClass::UpdateTimeZone()
 {
 	// Change System Timezone
 	Time.zone((float)GetTimeZoneOffset() / 60 + GetDaylightSaving());
+
+	// Alarms are in local time
+	theScheduler.Rearm();
 }
 
 UC ConfigClass::GetDaylightSaving()
@@ -261,11 +398,66 @@ BOOL ConfigClass::SetTimeZoneOffset(SHORT offset)
 
 String ConfigClass::GetTimeZoneJSON()
 {
-  String jsonStr = String::format("{\"id\":%d,\"offset\":%d,\"dst\":%d}",
-      GetTimeZoneID(), GetTimeZoneOffset(), GetDaylightSaving());
+  char strJson[48];
+  StructToJson(m_config.timeZone, strJson, sizeof(strJson));
+  String jsonStr = strJson;
   return jsonStr;
 }
 
+BOOL ConfigClass::UpdateConfig(const char *json)
+{
+  Config_t newConfig = m_config;
+  if( !JsonToStruct(json, newConfig) ) {
+    SERIAL_LN(F("Invalid config JSON"));
+    return false;
+  }
+
+  // Through the setters, so the radio and the time zone follow. The radio
+  /// goes first: if it can't be had nothing is applied
+  if( newConfig.rfPowerLevel != m_config.rfPowerLevel && !SetRFPowerLevel(newConfig.rfPowerLevel) ) {
+    SERIAL_LN(F("RF busy, config not applied"));
+    return false;
+  }
+  SetBrightIndicator(newConfig.indBrightness);
+  SetDailyTimeSyncEnabled(newConfig.enableDailyTimeSync);
+  SetSpeakerEnabled(newConfig.enableSpeaker);
+  SetUseCloud(newConfig.useCloud);
+  SetWiFiStatus(newConfig.stWiFi);
+  if( strcmp(newConfig.Organization, m_config.Organization) ) SetOrganization(newConfig.Organization);
+  if( strcmp(newConfig.ProductName, m_config.ProductName) ) SetProductName(newConfig.ProductName);
+  if( memcmp(&newConfig.timeZone, &m_config.timeZone, sizeof(Timezone_t)) ) {
+    m_config.timeZone = newConfig.timeZone;
+    m_isChanged = true;
+    theSys.m_tzString = GetTimeZoneJSON();
+    UpdateTimeZone();
+  }
+  return true;
+}
+
+BOOL ConfigClass::UpdateDevStatus(const char *json)
+{
+  // Find the row first, node_id defaults to the main device
+  DevStatusRow_t newStatus;
+  memset(&newStatus, 0x00, sizeof(newStatus));
+  newStatus.node_id = NODEID_MAINDEVICE;
+  if( !JsonToStruct(json, newStatus) ) {
+    SERIAL_LN(F("Invalid device status JSON"));
+    return false;
+  }
+  SHORT row = GetDevRow(newStatus.node_id, true);
+  if( row < 0 ) return false;
+
+  // Then apply the given keys over that row
+  newStatus = m_devStatus[row];
+  JsonToStruct(json, newStatus);
+  newStatus.uid = row;
+  if( memcmp(&newStatus, &m_devStatus[row], DST_ROW_SIZE) ) {
+    m_devStatus[row] = newStatus;
+    SetDevRowChanged(row);
+  }
+  return true;
+}
+
 String ConfigClass::GetOrganization()
 {
   String strName = m_config.Organization;
@@ -411,8 +603,12 @@ BOOL ConfigClass::SetRFPowerLevel(UC level)
 {
 	if( level > RF24_PA_MAX ) level = RF24_PA_MAX;
 	if( level != m_config.rfPowerLevel ) {
+		{
+			RFWorkerLock lock;
+			if( !lock.IsParked() ) return false;
+			theRadio.setPALevel(level);
+		}
 		m_config.rfPowerLevel = level;
-		theRadio.setPALevel(level);
 		m_isChanged = true;
 		return true;
 	}
@@ -453,24 +649,20 @@ BOOL ConfigClass::SetWiFiStatus(BOOL _st)
 // Load Device Status
 BOOL ConfigClass::LoadDeviceStatus()
 {
-	if (DST_ROW_SIZE <= MEM_DEVICE_STATUS_LEN)
+	if (2 * (sizeof(RecordLogHeader_t) + sizeof(m_devStatus)) <= MEM_DEVICE_STATUS_LEN)
 	{
-		EEPROM.get(MEM_DEVICE_STATUS_OFFSET, m_devStatus);
-		if (m_devStatus.uid != 0
-      || m_devStatus.ring[0].BR > 100
-      || m_devStatus.ring[0].CCT < CT_MIN_VALUE
-      || m_devStatus.ring[0].CCT > CT_MAX_VALUE)
+		if( !m_devStatusLog.Load(m_devStatus) )
 		{
-			InitDevStatus(NODEID_MAINDEVICE);
-      m_isDSTChanged = true;
+			InitDevStatus();
       SERIAL_LN(F("DST is empty, use default settings."));
-      SaveDeviceStatus();
+      m_devStatusLog.Format(m_devStatus);
     }
     else
     {
-      SERIAL_LN(F("DST loaded."));
+			BuildDevIndex();
+      SERIAL_LN("DST loaded, %d device(s).", GetDevCount());
     }
-		m_isDSTChanged = false;
+		m_dstChanged = 0;
 	}
 	else
 	{
@@ -481,95 +673,143 @@ BOOL ConfigClass::LoadDeviceStatus()
 	return true;
 }
 
-// Save Device Status
+// Save Device Status, only the span of changed rows is compared
 BOOL ConfigClass::SaveDeviceStatus()
 {
-	if (m_isDSTChanged)
+	if (m_dstChanged)
 	{
-		EEPROM.put(MEM_DEVICE_STATUS_OFFSET, m_devStatus);
-    m_isDSTChanged = false;
-    SERIAL_LN(F("DST saved."));
+		UC first = 0, last = MAX_DEVICE_PER_CONTROLLER - 1;
+		while( !BITTEST(m_dstChanged, first) ) first++;
+		while( !BITTEST(m_dstChanged, last) ) last--;
+		US nBytes = m_devStatusLog.Save(m_devStatus, first * DST_ROW_SIZE, (last - first + 1) * DST_ROW_SIZE);
+    m_dstChanged = 0;
+    SERIAL_LN("DST saved, %d bytes written.", nBytes);
 	}
 	return true;
 }
 
-BOOL ConfigClass::GetDevPresent()
+UC ConfigClass::GetDevCount()
+{
+	UC count = 0;
+	for( UC row = 0; row < MAX_DEVICE_PER_CONTROLLER; row++ ) {
+		if( m_devStatus[row].node_id != DST_ROW_FREE ) count++;
+	}
+	return count;
+}
+
+BOOL ConfigClass::GetDevPresent(UC _nodeID)
 {
-  return m_devStatus.present;
+  SHORT row = GetDevRow(_nodeID);
+  return (row >= 0 ? m_devStatus[row].present : false);
 }
 
-void ConfigClass::SetDevPresent(BOOL _present)
+void ConfigClass::SetDevPresent(BOOL _present, UC _nodeID)
 {
-  if( _present != m_devStatus.present )
+  SHORT row = GetDevRow(_nodeID, true);
+  if( row >= 0 && _present != m_devStatus[row].present )
   {
-    m_devStatus.present = _present;
-    m_isDSTChanged = true;
-    SERIAL_LN("Dev present %s", _present ? "Yes" : "No");
+    m_devStatus[row].present = _present;
+    SetDevRowChanged(row);
+    XLOG_INF(XLOG_MOD_DEV, "Dev %d present %s", _nodeID, _present ? "Yes" : "No");
   }
 }
 
-UC ConfigClass::GetDevType()
+UC ConfigClass::GetDevType(UC _nodeID)
 {
-  return m_devStatus.type;
+  SHORT row = GetDevRow(_nodeID);
+  return (row >= 0 ? m_devStatus[row].type : devtypUnknown);
 }
 
-void ConfigClass::SetDevType(UC _type)
+void ConfigClass::SetDevType(UC _type, UC _nodeID)
 {
-  if( _type != m_devStatus.type )
+  SHORT row = GetDevRow(_nodeID, true);
+  if( row >= 0 && _type != m_devStatus[row].type )
   {
-    m_devStatus.type = _type;
-    m_isDSTChanged = true;
+    m_devStatus[row].type = _type;
+    SetDevRowChanged(row);
   }
 }
 
-BOOL ConfigClass::GetDevStatus()
+BOOL ConfigClass::GetDevStatus(UC _nodeID, UC _ring)
 {
-  return m_devStatus.ring[0].State;
+  SHORT row = GetDevRow(_nodeID);
+  if( row < 0 || _ring > MAX_RING_NUM ) return false;
+  return m_devStatus[row].ring[_ring == RING_ID_ALL ? 0 : _ring - 1].State;
 }
 
-void ConfigClass::SetDevStatus(BOOL _status)
+void ConfigClass::SetDevStatus(BOOL _status, UC _nodeID, UC _ring)
 {
-  if( _status != m_devStatus.ring[0].State )
-  {
-    m_devStatus.ring[0].State = _status;
-    m_devStatus.ring[1].State = _status;
-    m_devStatus.ring[2].State = _status;
-    m_isDSTChanged = true;
-    SERIAL_LN("Dev Lights %s", _status ? "On" : "Off");
+  SHORT row = GetDevRow(_nodeID, true);
+  if( row < 0 || _ring > MAX_RING_NUM ) return;
+
+  BOOL changed = false;
+  for( UC r = 0; r < MAX_RING_NUM; r++ ) {
+    if( _ring != RING_ID_ALL && r != _ring - 1 ) continue;
+    if( _status != m_devStatus[row].ring[r].State ) {
+      m_devStatus[row].ring[r].State = _status;
+      changed = true;
+    }
+  }
+  if( changed ) {
+    SetDevRowChanged(row);
+    XLOG_INF(XLOG_MOD_DEV, "Dev %d Lights %s", _nodeID, _status ? "On" : "Off");
+
+    // Usage hours count while any ring is on
+    BOOL anyOn = false;
+    for( UC r = 0; r < MAX_RING_NUM; r++ ) anyOn |= m_devStatus[row].ring[r].State;
+    theStat.LampSwitch(_nodeID, anyOn);
   }
 }
 
-UC ConfigClass::GetDevBrightness()
+UC ConfigClass::GetDevBrightness(UC _nodeID, UC _ring)
 {
-  return m_devStatus.ring[0].BR;
+  SHORT row = GetDevRow(_nodeID);
+  if( row < 0 || _ring > MAX_RING_NUM ) return 0;
+  return m_devStatus[row].ring[_ring == RING_ID_ALL ? 0 : _ring - 1].BR;
 }
 
-void ConfigClass::SetDevBrightness(UC _level)
+void ConfigClass::SetDevBrightness(UC _level, UC _nodeID, UC _ring)
 {
-  if( _level != m_devStatus.ring[0].BR )
-  {
-    m_devStatus.ring[0].BR = _level;
-    m_devStatus.ring[1].BR = _level;
-    m_devStatus.ring[2].BR = _level;
-    m_isDSTChanged = true;
-    SERIAL_LN("Dev Brightness changed %d", _level);
+  SHORT row = GetDevRow(_nodeID, true);
+  if( row < 0 || _ring > MAX_RING_NUM ) return;
+
+  BOOL changed = false;
+  for( UC r = 0; r < MAX_RING_NUM; r++ ) {
+    if( _ring != RING_ID_ALL && r != _ring - 1 ) continue;
+    if( _level != m_devStatus[row].ring[r].BR ) {
+      m_devStatus[row].ring[r].BR = _level;
+      changed = true;
+    }
+  }
+  if( changed ) {
+    SetDevRowChanged(row);
+    XLOG_INF(XLOG_MOD_DEV, "Dev %d Brightness changed %d", _nodeID, _level);
   }
 }
 
-US ConfigClass::GetDevCCT()
+US ConfigClass::GetDevCCT(UC _nodeID, UC _ring)
 {
-  return m_devStatus.ring[0].CCT;
+  SHORT row = GetDevRow(_nodeID);
+  if( row < 0 || _ring > MAX_RING_NUM ) return CT_MIN_VALUE;
+  return m_devStatus[row].ring[_ring == RING_ID_ALL ? 0 : _ring - 1].CCT;
 }
 
-void ConfigClass::SetDevCCT(US _cct)
+void ConfigClass::SetDevCCT(US _cct, UC _nodeID, UC _ring)
 {
-  if( _cct != m_devStatus.ring[0].CCT )
-  {
-    m_devStatus.ring[0].CCT = _cct;
-    m_devStatus.ring[1].CCT = _cct;
-    m_devStatus.ring[2].CCT = _cct;
-    m_isDSTChanged = true;
-    SERIAL_LN("Dev CCT changed %d", _cct);
+  SHORT row = GetDevRow(_nodeID, true);
+  if( row < 0 || _ring > MAX_RING_NUM ) return;
+
+  BOOL changed = false;
+  for( UC r = 0; r < MAX_RING_NUM; r++ ) {
+    if( _ring != RING_ID_ALL && r != _ring - 1 ) continue;
+    if( _cct != m_devStatus[row].ring[r].CCT ) {
+      m_devStatus[row].ring[r].CCT = _cct;
+      changed = true;
+    }
+  }
+  if( changed ) {
+    SetDevRowChanged(row);
+    XLOG_INF(XLOG_MOD_DEV, "Dev %d CCT changed %d", _nodeID, _cct);
   }
 }
 
@@ -599,12 +839,25 @@ String ConfigClass::hue_to_string(Hue_t hue)
 
 void ConfigClass::print_devStatus()
 {
-	SERIAL_LN("==== DevStatus ====");
-	SERIAL_LN("uid = %d", m_devStatus.uid);
-	SERIAL_LN("node_id = %d", m_devStatus.node_id);
-	SERIAL_LN("type = %d", m_devStatus.type);
-  SERIAL_LN("Present = %s", GetDevPresent() ? "Yes" : "No");
-  SERIAL_LN("Status = %s", GetDevStatus() ? "On" : "Off");
-  SERIAL_LN("Brightness = %d", GetDevBrightness());
-  SERIAL_LN("Color Temperature = %d\n\r", GetDevCCT());
+	SERIAL_LN("==== DevStatus: %d device(s) ====", GetDevCount());
+	for( UC row = 0; row < MAX_DEVICE_PER_CONTROLLER; row++ ) {
+		const DevStatusRow_t &dev = m_devStatus[row];
+		if( dev.node_id == DST_ROW_FREE ) continue;
+		SERIAL_LN("uid = %d, node_id = %d, type = %d, Present = %s%s", dev.uid, dev.node_id, dev.type,
+				dev.present ? "Yes" : "No", BITTEST(m_dstChanged, row) ? ", unsaved" : "");
+		for( UC r = 0; r < MAX_RING_NUM; r++ ) {
+			SERIAL_LN("  ring%d %s", r + 1, hue_to_string(dev.ring[r]).c_str());
+		}
+	}
+	SERIAL_LN("");
+}
+
+void ConfigClass::print_logStatus()
+{
+  SERIAL_LN("** Config log: slot %c gen %lu, %d bytes used, %d free, %lu written, %d compactions",
+      'A' + m_configLog.GetSlot(), m_configLog.GetGeneration(), m_configLog.GetUsedBytes(),
+      m_configLog.GetFreeBytes(), m_configLog.GetBytesWritten(), m_configLog.GetCompactions());
+  SERIAL_LN("** DST log: slot %c gen %lu, %d bytes used, %d free, %lu written, %d compactions\n\r",
+      'A' + m_devStatusLog.GetSlot(), m_devStatusLog.GetGeneration(), m_devStatusLog.GetUsedBytes(),
+      m_devStatusLog.GetFreeBytes(), m_devStatusLog.GetBytesWritten(), m_devStatusLog.GetCompactions());
 }
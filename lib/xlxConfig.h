@@ -5,6 +5,8 @@
 
 #include "xliCommon.h"
 #include "xliMemoryMap.h"
+#include "xlxStructJson.h"
+#include "xlxRecordLog.h"
 
 #define PACK //MSVS intellisense doesn't work when structs are packed
 //------------------------------------------------------------------
@@ -66,6 +68,22 @@ typedef struct
 } DevStatusRow_t;
 
 #define DST_ROW_SIZE sizeof(DevStatusRow_t)
+#define DST_ROW_FREE              NODEID_GATEWAY    // node_id of an unused row
+#define DST_ROW_NONE              0xFF              // not in the table
+
+// One dirty bit per row
+#if MAX_DEVICE_PER_CONTROLLER > 16
+#error "Device Status Table dirty bitmap holds 16 rows"
+#endif
+
+//------------------------------------------------------------------
+// JSON Field Maps, see xlxStructJson.h
+//------------------------------------------------------------------
+// Hue_t is exchanged as [State, BR, CCT, R, G, B]
+template <> struct JsonSchema<Hue_t> { static const sjSchema_t schema; };
+template <> struct JsonSchema<Timezone_t> { static const sjSchema_t schema; };
+template <> struct JsonSchema<Config_t> { static const sjSchema_t schema; };
+template <> struct JsonSchema<DevStatusRow_t> { static const sjSchema_t schema; };
 
 //------------------------------------------------------------------
 // Xlight Configuration Class
@@ -75,19 +93,33 @@ class ConfigClass
 private:
   BOOL m_isLoaded;
   BOOL m_isChanged;         // Config Change Flag
-  BOOL m_isDSTChanged;      // Device Status Table Change Flag
+  US m_dstChanged;          // Device Status Table changed rows, bit per row
   UL m_lastTimeSync;
 
   Config_t m_config;
-  DevStatusRow_t m_devStatus;
+
+  // Device Status Table, rows are found by nodeID via m_devIndex
+  DevStatusRow_t m_devStatus[MAX_DEVICE_PER_CONTROLLER];
+  UC m_devIndex[NODEID_MAX_DEVCIE + 1];
+
+  // Persisted images and their record logs
+  Config_t m_savedConfig;
+  DevStatusRow_t m_savedDevStatus[MAX_DEVICE_PER_CONTROLLER];
+  RecordLogClass m_configLog;
+  RecordLogClass m_devStatusLog;
 
   void UpdateTimeZone();
   void DoTimeSync();
 
+  void InitDevRow(UC row, UC nodeID);
+  void BuildDevIndex();
+  SHORT GetDevRow(UC _nodeID, BOOL _add = false);
+  void SetDevRowChanged(UC row);
+
 public:
   ConfigClass();
   void InitConfig();
-  void InitDevStatus(UC nodeID);
+  void InitDevStatus();
 
   BOOL LoadConfig();
   BOOL SaveConfig();
@@ -96,6 +128,7 @@ public:
   BOOL LoadDeviceStatus();
   BOOL SaveDeviceStatus();
   void print_devStatus();
+  void print_logStatus();
 
   BOOL IsConfigChanged();
   void SetConfigChanged(BOOL flag);
@@ -117,6 +150,10 @@ public:
   BOOL SetTimeZoneOffset(SHORT offset);
   String GetTimeZoneJSON();
 
+  // Bulk update from JSON, only the keys present are changed
+  BOOL UpdateConfig(const char *json);
+  BOOL UpdateDevStatus(const char *json);
+
   String GetOrganization();
   void SetOrganization(const char *strName);
 
@@ -152,21 +189,24 @@ public:
   BOOL GetWiFiStatus();
   BOOL SetWiFiStatus(BOOL _st);
 
-  // DevStatusRow_t interfaces
-  BOOL GetDevPresent();
-  void SetDevPresent(BOOL _present);
+  // DevStatusRow_t interfaces, by device nodeID and ring (RING_ID_ALL for
+  /// every ring, or ring 1 when reading)
+  UC GetDevCount();
+
+  BOOL GetDevPresent(UC _nodeID = NODEID_MAINDEVICE);
+  void SetDevPresent(BOOL _present, UC _nodeID = NODEID_MAINDEVICE);
 
-  UC GetDevType();
-  void SetDevType(UC _type);
+  UC GetDevType(UC _nodeID = NODEID_MAINDEVICE);
+  void SetDevType(UC _type, UC _nodeID = NODEID_MAINDEVICE);
 
-  BOOL GetDevStatus();
-  void SetDevStatus(BOOL _status);
+  BOOL GetDevStatus(UC _nodeID = NODEID_MAINDEVICE, UC _ring = RING_ID_ALL);
+  void SetDevStatus(BOOL _status, UC _nodeID = NODEID_MAINDEVICE, UC _ring = RING_ID_ALL);
 
-  UC GetDevBrightness();
-  void SetDevBrightness(UC _level);
+  UC GetDevBrightness(UC _nodeID = NODEID_MAINDEVICE, UC _ring = RING_ID_ALL);
+  void SetDevBrightness(UC _level, UC _nodeID = NODEID_MAINDEVICE, UC _ring = RING_ID_ALL);
 
-  US GetDevCCT();
-  void SetDevCCT(US _cct);
+  US GetDevCCT(UC _nodeID = NODEID_MAINDEVICE, UC _ring = RING_ID_ALL);
+  void SetDevCCT(US _cct, UC _nodeID = NODEID_MAINDEVICE, UC _ring = RING_ID_ALL);
 
   String hue_to_string(Hue_t hue);
 };
@@ -0,0 +1,245 @@
+/**
+ * xlxConnManager.cpp - Xlight Wi-Fi and Cloud connection manager
+ *
+ * Created by Baoshi Sun <bs.sun@datatellit.com>
+ * Copyright (C) 2015-2016 DTIT
+ * Full contributor list:
+ *
+ * Documentation:
+ * Support Forum:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * REVISION HISTORY
+ * Version 1.0 - Created by Baoshi Sun <bs.sun@datatellit.com>
+ *
+ * DESCRIPTION
+ * 1. Each link goes off -> down -> connecting -> up, and back to down when
+ *    an attempt times out or the link drops
+ * 2. After a failed attempt the link waits CONN_BACKOFF_MIN, doubling up
+ *    to CONN_BACKOFF_MAX; the wait is picked at random from its upper half
+ *    so a room full of remotes doesn't retry in step
+ * 3. A drop is retried at once, the back-off only counts failed attempts
+ * 4. CLOUD_DISABLE keeps the Cloud off, CLOUD_ENABLE connects when Wi-Fi
+ *    is up, CLOUD_MUST_CONNECT also starts over from Wi-Fi after
+ *    CONN_CLOUD_MAX_FAILURES failed attempts in a row
+ * 5. No Wi-Fi attempt while there are no credentials or the module is
+ *    listening for them
+ *
+ * ToDo:
+ *
+**/
+
+#include "xlxConnManager.h"
+#include "xlxConfig.h"
+
+//------------------------------------------------------------------
+// the one and only instance of ConnManagerClass
+ConnManagerClass theConnMgr;
+
+static const char *connLinkNames[CONN_LINKS] = {"wifi", "cloud"};
+static const char *connStateNames[] = {"off", "down", "connecting", "up"};
+
+//------------------------------------------------------------------
+// Xlight Connection Manager Class
+//------------------------------------------------------------------
+ConnManagerClass::ConnManagerClass()
+{
+  memset(m_links, 0x00, sizeof(m_links));
+  m_links[CONN_WIFI].timeout = RTE_WIFI_CONN_TIMEOUT;
+  m_links[CONN_CLOUD].timeout = RTE_CLOUD_CONN_TIMEOUT;
+  m_started = false;
+  m_wifiEnabled = true;
+}
+
+void ConnManagerClass::Start()
+{
+  m_started = true;
+}
+
+void ConnManagerClass::SetState(UC link, UC state)
+{
+  ConnLink_t &lk = m_links[link];
+  UL now = millis();
+  if( lk.state == CONN_ST_UP ) lk.upMs += now - lk.since;
+  lk.state = state;
+  lk.since = now;
+}
+
+void ConnManagerClass::Failed(UC link)
+{
+  ConnLink_t &lk = m_links[link];
+  lk.failures++;
+  if( lk.attempts < 0xFF ) lk.attempts++;
+  lk.backoff = (lk.backoff ? lk.backoff * 2 : CONN_BACKOFF_MIN);
+  if( lk.backoff > CONN_BACKOFF_MAX ) lk.backoff = CONN_BACKOFF_MAX;
+  UL wait = lk.backoff / 2 + random(lk.backoff / 2 + 1);
+  lk.nextTry = millis() + wait;
+  SetState(link, CONN_ST_DOWN);
+  SERIAL_LN("%s connecting...Failed, retry in %lu ms", connLinkNames[link], wait);
+}
+
+void ConnManagerClass::TickWiFi()
+{
+  ConnLink_t &lk = m_links[CONN_WIFI];
+  UL now = millis();
+
+  if( !m_wifiEnabled ) {
+    if( lk.state != CONN_ST_OFF ) SetState(CONN_WIFI, CONN_ST_OFF);
+    return;
+  }
+
+  switch( lk.state ) {
+  case CONN_ST_OFF:
+    lk.nextTry = now;
+    SetState(CONN_WIFI, CONN_ST_DOWN);
+    break;
+
+  case CONN_ST_DOWN:
+    if( WiFi.ready() ) {
+      // Came up by itself
+      SetState(CONN_WIFI, CONN_ST_UP);
+      break;
+    }
+    if( (LONG)(now - lk.nextTry) < 0 ) break;
+    if( WiFi.listening() || !WiFi.hasCredentials() ) break;
+    SERIAL_LN("Wi-Fi connecting...");
+    WiFi.connect();
+    SetState(CONN_WIFI, CONN_ST_CONNECTING);
+    break;
+
+  case CONN_ST_CONNECTING:
+    if( WiFi.ready() ) {
+      lk.lastConnectMs = now - lk.since;
+      lk.sumConnectMs += lk.lastConnectMs;
+      lk.connects++;
+      lk.attempts = 0;
+      lk.backoff = 0;
+      SetState(CONN_WIFI, CONN_ST_UP);
+      SERIAL_LN("Wi-Fi connected in %lu ms", lk.lastConnectMs);
+    } else if( now - lk.since > lk.timeout ) {
+      // Stop the module from trying on its own, we'll be back
+      WiFi.disconnect();
+      Failed(CONN_WIFI);
+    }
+    break;
+
+  case CONN_ST_UP:
+    if( !WiFi.ready() ) {
+      lk.drops++;
+      lk.nextTry = now;
+      SetState(CONN_WIFI, CONN_ST_DOWN);
+      SERIAL_LN("Wi-Fi lost");
+    }
+    break;
+  }
+}
+
+void ConnManagerClass::TickCloud()
+{
+  ConnLink_t &lk = m_links[CONN_CLOUD];
+  UL now = millis();
+  UC useCloud = theConfig.GetUseCloud();
+
+  if( useCloud == CLOUD_DISABLE || !IsUp(CONN_WIFI) ) {
+    if( lk.state == CONN_ST_CONNECTING || (useCloud == CLOUD_DISABLE && Particle.connected()) ) {
+      Particle.disconnect();
+    }
+    if( lk.state != CONN_ST_OFF ) SetState(CONN_CLOUD, CONN_ST_OFF);
+    return;
+  }
+
+  switch( lk.state ) {
+  case CONN_ST_OFF:
+    lk.nextTry = now;
+    SetState(CONN_CLOUD, CONN_ST_DOWN);
+    break;
+
+  case CONN_ST_DOWN:
+    if( Particle.connected() ) {
+      SetState(CONN_CLOUD, CONN_ST_UP);
+      break;
+    }
+    if( (LONG)(now - lk.nextTry) < 0 ) break;
+    SERIAL_LN("Cloud connecting...");
+    Particle.connect();
+    SetState(CONN_CLOUD, CONN_ST_CONNECTING);
+    break;
+
+  case CONN_ST_CONNECTING:
+    if( Particle.connected() ) {
+      lk.lastConnectMs = now - lk.since;
+      lk.sumConnectMs += lk.lastConnectMs;
+      lk.connects++;
+      lk.attempts = 0;
+      lk.backoff = 0;
+      SetState(CONN_CLOUD, CONN_ST_UP);
+      SERIAL_LN("Cloud connected in %lu ms", lk.lastConnectMs);
+    } else if( now - lk.since > lk.timeout ) {
+      Particle.disconnect();
+      Failed(CONN_CLOUD);
+      if( useCloud == CLOUD_MUST_CONNECT && lk.attempts >= CONN_CLOUD_MAX_FAILURES ) {
+        // Must connect to the Cloud: start over from Wi-Fi
+        SERIAL_LN("Cloud unreachable, reconnecting Wi-Fi");
+        lk.attempts = 0;
+        WiFi.disconnect();
+      }
+    }
+    break;
+
+  case CONN_ST_UP:
+    if( !Particle.connected() ) {
+      lk.drops++;
+      lk.nextTry = now;
+      SetState(CONN_CLOUD, CONN_ST_DOWN);
+      SERIAL_LN("Cloud lost");
+    }
+    break;
+  }
+}
+
+void ConnManagerClass::Tick()
+{
+  if( !m_started ) return;
+  TickWiFi();
+  TickCloud();
+}
+
+void ConnManagerClass::Reconnect(UC link)
+{
+  if( link >= CONN_LINKS ) return;
+  ConnLink_t &lk = m_links[link];
+  lk.attempts = 0;
+  lk.backoff = 0;
+  lk.nextTry = millis();
+  if( link == CONN_WIFI ) m_wifiEnabled = true;
+}
+
+void ConnManagerClass::EnableWiFi(BOOL on)
+{
+  m_wifiEnabled = on;
+  if( on ) Reconnect(CONN_WIFI);
+}
+
+void ConnManagerClass::print()
+{
+  UL now = millis();
+  SERIAL_LN("** Connections: %s **", (m_started ? "managed" : "not started"));
+  for( UC i = 0; i < CONN_LINKS; i++ ) {
+    const ConnLink_t &lk = m_links[i];
+    UL upMs = lk.upMs + (lk.state == CONN_ST_UP ? now - lk.since : 0);
+    SERIAL_LN("  %-5s %-10s for %lu s, up %lu%% of the time", connLinkNames[i], connStateNames[lk.state],
+        (now - lk.since) / 1000, (now ? (UL)((uint64_t)upMs * 100 / now) : 0));
+    SERIAL_LN("        connects:%lu failures:%lu drops:%lu, connect ms last:%lu avg:%lu",
+        lk.connects, lk.failures, lk.drops, lk.lastConnectMs,
+        (lk.connects ? lk.sumConnectMs / lk.connects : 0));
+    if( lk.state == CONN_ST_DOWN && lk.attempts ) {
+      SERIAL_LN("        %d failed in a row, next try in %ld ms", lk.attempts, (LONG)(lk.nextTry - now));
+    }
+  }
+  SERIAL_LN("");
+}
@@ -0,0 +1,88 @@
+//  xlxConnManager.h - Xlight Wi-Fi and Cloud connection manager
+
+#ifndef xlxConnManager_h
+#define xlxConnManager_h
+
+#include "xliCommon.h"
+
+// Links
+#define CONN_WIFI                 0
+#define CONN_CLOUD                1
+#define CONN_LINKS                2
+
+// Link states
+#define CONN_ST_OFF               0           // not wanted, or not started
+#define CONN_ST_DOWN              1           // waiting for the next attempt
+#define CONN_ST_CONNECTING        2           // connect issued, verifying
+#define CONN_ST_UP                3
+
+#define CONN_BACKOFF_MIN          2000        // ms before the first retry,
+#define CONN_BACKOFF_MAX          300000      // doubling up to this, then jittered
+#define CONN_CLOUD_MAX_FAILURES   5           // CLOUD_MUST_CONNECT: start over from Wi-Fi after this many
+
+//------------------------------------------------------------------
+// Connection Manager Structures
+//------------------------------------------------------------------
+typedef struct
+{
+  UC state;                                 // CONN_ST_*
+  UL since;                                 // millis() of the last state change
+  UL timeout;                               // ms an attempt may take
+  UL nextTry;                               // millis() of the next attempt
+  UL backoff;                               // ms, before jitter
+  UC attempts;                              // failed in a row
+
+  // Metrics
+  UL connects;
+  UL failures;
+  UL drops;                                 // lost after being up
+  UL lastConnectMs;                         // time the last successful attempt took
+  UL sumConnectMs;
+  UL upMs;                                  // total time up, excluding the current stretch
+} ConnLink_t;
+
+//------------------------------------------------------------------
+// Connection Manager Class
+//------------------------------------------------------------------
+// Tick() moves each link one step: issue the connect when its back-off
+// is up, check on it until it is there or the attempt times out, and
+// notice when it drops. Nothing waits, so the main loop keeps running
+// while Wi-Fi or the Cloud are away. The Cloud follows the Wi-Fi link
+// and ConfigClass::GetUseCloud().
+class ConnManagerClass
+{
+private:
+  ConnLink_t m_links[CONN_LINKS];
+  BOOL m_started;
+  BOOL m_wifiEnabled;
+
+  void SetState(UC link, UC state);
+  void Failed(UC link);
+  void TickWiFi();
+  void TickCloud();
+
+public:
+  ConnManagerClass();
+
+  // Start managing, once the boot gets to the network
+  void Start();
+  void Tick();
+
+  // Try now, forgetting the back-off
+  void Reconnect(UC link);
+  // Keep Wi-Fi off, e.g. after giving up on it
+  void EnableWiFi(BOOL on);
+
+  BOOL IsUp(UC link) { return (link < CONN_LINKS && m_links[link].state == CONN_ST_UP); }
+  UC GetState(UC link) { return (link < CONN_LINKS ? m_links[link].state : CONN_ST_OFF); }
+  UL GetFailures(UC link) { return (link < CONN_LINKS ? m_links[link].failures : 0); }
+
+  void print();
+};
+
+//------------------------------------------------------------------
+// Function & Class Helper
+//------------------------------------------------------------------
+extern ConnManagerClass theConnMgr;
+
+#endif /* xlxConnManager_h */
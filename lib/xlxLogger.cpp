@@ -0,0 +1,204 @@
+/**
+ * xlxLogger.cpp - Xlight deferred log, binary records formatted in idle time
+ *
+ * Created by Baoshi Sun <bs.sun@datatellit.com>
+ * Copyright (C) 2015-2016 DTIT
+ * Full contributor list:
+ *
+ * Documentation:
+ * Support Forum:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * REVISION HISTORY
+ * Version 1.0 - Created by Baoshi Sun <bs.sun@datatellit.com>
+ *
+ * DESCRIPTION
+ * 1. XLOG_*() in the RF and device status paths store a record instead of
+ *    calling printf: the format string's address, millis() and up to
+ *    XLOG_MAX_ARGS arguments, a few stores in all
+ * 2. The output task formats XLOG_FLUSH_BATCH records a run, and only
+ *    while the serial port takes what is written, so a burst of frames
+ *    waits in the ring instead of being cut off by the output buffer
+ * 3. Lines carry the time they were logged, [seconds.ms], since they may
+ *    come out after lines printed directly
+ * 4. Levels per module, 'set log'; 'show log' formats everything pending
+ * 5. Direct mode formats each record at once, e.g. when chasing a crash
+ *    that would take the ring with it
+ *
+ * ToDo:
+ * 1. Keep the ring in retained memory to read it after a reset
+ *
+**/
+
+#include "xlxLogger.h"
+
+//------------------------------------------------------------------
+// the one and only instance of LoggerClass
+LoggerClass theLogger;
+
+static const char *xlogModNames[XLOG_MODULES] = {"sys", "rf", "dev", "net"};
+static const char *xlogLevelNames[XLOG_LEVELS] = {"off", "error", "warn", "info", "debug"};
+
+//------------------------------------------------------------------
+// Xlight Logger Class
+//------------------------------------------------------------------
+LoggerClass::LoggerClass()
+{
+  m_head = 0;
+  m_tail = 0;
+  m_used = 0;
+  m_peak = 0;
+  memset(m_level, XLOG_DEFAULT_LEVEL, sizeof(m_level));
+  m_direct = false;
+  m_written = 0;
+  m_dropped = 0;
+  m_droppedShown = 0;
+}
+
+void LoggerClass::Put(UC module, UC level, const char *fmt, const XLogSlot_t *args, UC nargs)
+{
+  if( m_direct ) {
+    // Keep the order: what is pending goes first
+    Flush(0xFFFF, true);
+    XLogSlot_t rec[XLOG_HEAD_SLOTS + XLOG_MAX_ARGS];
+    rec[0] = (XLogSlot_t)fmt;
+    rec[1] = millis();
+    rec[2] = (module << 16) | (level << 8) | nargs;
+    memcpy(rec + XLOG_HEAD_SLOTS, args, nargs * sizeof(XLogSlot_t));
+    m_written++;
+    Format(rec);
+    return;
+  }
+
+  US size = XLOG_HEAD_SLOTS + nargs;
+  US room = XLOG_RING_SLOTS - m_head;
+  US skip = (room < size ? room : 0);
+  if( m_used + skip + size > XLOG_RING_SLOTS ) {
+    m_dropped++;
+    return;
+  }
+  if( skip ) {
+    // Null format: the reader goes back to the start
+    m_ring[m_head] = 0;
+    m_used += skip;
+    m_head = 0;
+  }
+
+  XLogSlot_t *p = m_ring + m_head;
+  p[0] = (XLogSlot_t)fmt;
+  p[1] = millis();
+  p[2] = (module << 16) | (level << 8) | nargs;
+  for( UC i = 0; i < nargs; i++ ) p[XLOG_HEAD_SLOTS + i] = args[i];
+  m_head += size;
+  if( m_head >= XLOG_RING_SLOTS ) m_head = 0;
+  m_used += size;
+  if( m_used > m_peak ) m_peak = m_used;
+  m_written++;
+}
+
+BOOL LoggerClass::Pop(XLogSlot_t *rec)
+{
+  if( m_used == 0 ) return false;
+  if( m_ring[m_tail] == 0 ) {
+    m_used -= XLOG_RING_SLOTS - m_tail;
+    m_tail = 0;
+  }
+
+  US size = XLOG_HEAD_SLOTS + (m_ring[m_tail + 2] & 0xFF);
+  memcpy(rec, m_ring + m_tail, size * sizeof(XLogSlot_t));
+  m_tail += size;
+  if( m_tail >= XLOG_RING_SLOTS ) m_tail = 0;
+  m_used -= size;
+  // Empty, start over so fewer records hit the end of the ring
+  if( m_used == 0 ) m_head = m_tail = 0;
+  return true;
+}
+
+void LoggerClass::Format(const XLogSlot_t *rec)
+{
+  // Arguments the format doesn't use are passed as 0
+  XLogSlot_t a[XLOG_MAX_ARGS];
+  UC nargs = rec[2] & 0xFF;
+  memset(a, 0x00, sizeof(a));
+  memcpy(a, rec + XLOG_HEAD_SLOTS, nargs * sizeof(XLogSlot_t));
+
+  char strLine[XLOG_LINE_SIZE];
+  UL ms = rec[1];
+  int n = snprintf(strLine, sizeof(strLine), "[%lu.%03lu] ", ms / 1000, ms % 1000);
+  snprintf(strLine + n, sizeof(strLine) - n, (const char *)rec[0],
+      a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8]);
+  SERIAL_LN("%s", strLine);
+}
+
+void LoggerClass::Flush(US maxRecords, BOOL wait)
+{
+  XLogSlot_t rec[XLOG_HEAD_SLOTS + XLOG_MAX_ARGS];
+  for( US n = 0; n < maxRecords; n++ ) {
+    // Leave the rest for the next run if the port is behind
+    if( !wait && theOutput.GetPendingBytes() > 0 ) return;
+    if( !Pop(rec) ) break;
+    Format(rec);
+    if( wait ) SERIAL_FLUSH(true);
+  }
+
+  if( m_used == 0 && m_dropped != m_droppedShown ) {
+    SERIAL_LN("(%lu log records dropped, ring full)", m_dropped - m_droppedShown);
+    m_droppedShown = m_dropped;
+  }
+}
+
+void LoggerClass::SetLevel(UC module, UC level)
+{
+  if( module < XLOG_MODULES && level < XLOG_LEVELS ) m_level[module] = level;
+}
+
+void LoggerClass::SetLevelAll(UC level)
+{
+  for( UC i = 0; i < XLOG_MODULES; i++ ) SetLevel(i, level);
+}
+
+void LoggerClass::SetDirect(BOOL direct)
+{
+  if( direct ) Flush(0xFFFF, true);
+  m_direct = direct;
+}
+
+UC LoggerClass::ParseModule(const char *name)
+{
+  UC i;
+  for( i = 0; i < XLOG_MODULES; i++ ) {
+    if( stricmp(name, xlogModNames[i]) == 0 ) break;
+  }
+  return i;
+}
+
+// "0".."4", or a name or the start of one, e.g. "warn" or "w"
+UC LoggerClass::ParseLevel(const char *name)
+{
+  if( name[0] >= '0' && name[0] <= '9' ) {
+    int level = atoi(name);
+    return (level < XLOG_LEVELS ? level : XLOG_LEVELS);
+  }
+  UC i;
+  for( i = 0; i < XLOG_LEVELS; i++ ) {
+    if( name[0] && strnicmp(xlogLevelNames[i], name, strlen(name)) == 0 ) break;
+  }
+  return i;
+}
+
+void LoggerClass::print()
+{
+  SERIAL_LN("** Log: %s, %d of %d slots used, peak %d, %lu written, %lu dropped **",
+      (m_direct ? "direct" : "deferred"), m_used, XLOG_RING_SLOTS, m_peak, m_written, m_dropped);
+  SERIAL("  levels:");
+  for( UC i = 0; i < XLOG_MODULES; i++ ) SERIAL(" %s:%s", xlogModNames[i], xlogLevelNames[m_level[i]]);
+  SERIAL_LN("");
+  SERIAL_LN("");
+  // On demand: all that is pending
+  Flush(0xFFFF, true);
+}
@@ -0,0 +1,112 @@
+//  xlxLogger.h - Xlight deferred log, binary records formatted in idle time
+
+#ifndef xlxLogger_h
+#define xlxLogger_h
+
+#include "xliCommon.h"
+
+// Ring size in slots, a record takes XLOG_HEAD_SLOTS plus one per argument
+#ifndef XLOG_RING_SLOTS
+#define XLOG_RING_SLOTS           512
+#endif
+#define XLOG_HEAD_SLOTS           3           // format, millis(), module|level|args
+#define XLOG_MAX_ARGS             9
+#define XLOG_LINE_SIZE            160
+#define XLOG_FLUSH_BATCH          4           // records formatted per output task run
+
+// Levels, a record passes if its level is not above its module's
+#define XLOG_OFF                  0
+#define XLOG_ERROR                1
+#define XLOG_WARN                 2
+#define XLOG_INFO                 3
+#define XLOG_DEBUG                4
+#define XLOG_LEVELS               5
+#define XLOG_DEFAULT_LEVEL        XLOG_INFO
+
+// Modules
+#define XLOG_MOD_SYS              0
+#define XLOG_MOD_RF               1           // frames in and out
+#define XLOG_MOD_DEV              2           // device status changes
+#define XLOG_MOD_NET              3
+#define XLOG_MODULES              4
+
+// Log a record if the module's level lets it through. Arguments are kept
+// as they are, not formatted, so they must be integers or string literals:
+// a %s to a buffer would be read when the buffer is long gone.
+#define XLOG(mod, lvl, fmt, ...)  do { if( theLogger.IsOn((mod), (lvl)) ) \
+    theLogger.Write((mod), (lvl), (fmt), ##__VA_ARGS__); } while(0)
+#define XLOG_ERR(mod, fmt, ...)   XLOG((mod), XLOG_ERROR, (fmt), ##__VA_ARGS__)
+#define XLOG_WRN(mod, fmt, ...)   XLOG((mod), XLOG_WARN, (fmt), ##__VA_ARGS__)
+#define XLOG_INF(mod, fmt, ...)   XLOG((mod), XLOG_INFO, (fmt), ##__VA_ARGS__)
+#define XLOG_DBG(mod, fmt, ...)   XLOG((mod), XLOG_DEBUG, (fmt), ##__VA_ARGS__)
+
+// A slot holds an argument or the format pointer
+typedef uintptr_t XLogSlot_t;
+
+//------------------------------------------------------------------
+// Logger Class
+//------------------------------------------------------------------
+// Write() copies the format pointer, the time and the arguments into the
+// ring and returns; printf runs later, from the output task while the
+// serial port keeps up, or from 'show log'. A record that doesn't fit is
+// dropped and counted, the ones already in are kept.
+/// A record never wraps: if it doesn't fit before the end of the ring, the
+/// rest of the ring is skipped (a null format marks it) and it goes first.
+/// Main loop only, the ring has no lock.
+class LoggerClass
+{
+private:
+  XLogSlot_t m_ring[XLOG_RING_SLOTS];
+  US m_head;                                // where the next record goes
+  US m_tail;                                // oldest record
+  US m_used;                                // slots, skipped ones included
+  US m_peak;
+  UC m_level[XLOG_MODULES];
+  BOOL m_direct;                            // format at once, e.g. to debug a crash
+
+  // Statistics
+  UL m_written;
+  UL m_dropped;
+  UL m_droppedShown;                        // m_dropped when last reported
+
+  void Put(UC module, UC level, const char *fmt, const XLogSlot_t *args, UC nargs);
+  BOOL Pop(XLogSlot_t *rec);
+  void Format(const XLogSlot_t *rec);
+
+public:
+  LoggerClass();
+
+  BOOL IsOn(UC module, UC level) { return (level <= m_level[module]); }
+
+  template <typename... Args>
+  void Write(UC module, UC level, const char *fmt, Args... args)
+  {
+    static_assert(sizeof...(args) <= XLOG_MAX_ARGS, "too many log arguments");
+    XLogSlot_t slots[sizeof...(args) + 1] = {(XLogSlot_t)args...};
+    Put(module, level, fmt, slots, sizeof...(args));
+  }
+
+  // Format up to maxRecords while the output doesn't back up; wait = true
+  /// blocks on the serial port and formats all of them
+  void Flush(US maxRecords = XLOG_FLUSH_BATCH, BOOL wait = false);
+  US GetPending() { return m_used; }
+
+  UC GetLevel(UC module) { return m_level[module]; }
+  void SetLevel(UC module, UC level);
+  void SetLevelAll(UC level);
+  BOOL IsDirect() { return m_direct; }
+  void SetDirect(BOOL direct);
+
+  // Module or level by name or number, XLOG_MODULES / XLOG_LEVELS if unknown
+  static UC ParseModule(const char *name);
+  static UC ParseLevel(const char *name);
+
+  void print();
+};
+
+//------------------------------------------------------------------
+// Function & Class Helper
+//------------------------------------------------------------------
+extern LoggerClass theLogger;
+
+#endif /* xlxLogger_h */
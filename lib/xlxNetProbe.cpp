@@ -0,0 +1,204 @@
+/**
+ * xlxNetProbe.cpp - Xlight network health prober, off the main loop
+ *
+ * Created by Baoshi Sun <bs.sun@datatellit.com>
+ * Copyright (C) 2015-2016 DTIT
+ * Full contributor list:
+ *
+ * Documentation:
+ * Support Forum:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * REVISION HISTORY
+ * Version 1.0 - Created by Baoshi Sun <bs.sun@datatellit.com>
+ *
+ * DESCRIPTION
+ * 1. A probe resolves NP_WAN_HOST; if that fails it pings the gateway, and
+ *    if that fails too, itself. LAN is good if either ping gets an answer
+ * 2. The probes run on their own thread, at the application's priority,
+ *    so a DNS timeout holds up neither the main loop nor the RF worker
+ * 3. A good result is kept for NP_TTL_GOOD. While WAN is down the probe
+ *    interval doubles from NP_BACKOFF_MIN up to NP_BACKOFF_MAX
+ * 4. Wi-Fi dropping clears the results, and the next probe goes out as
+ *    soon as it is back
+ *
+ * ToDo:
+ *
+**/
+
+#include "xlxNetProbe.h"
+
+//------------------------------------------------------------------
+// the one and only instance of NetProbeClass
+NetProbeClass theNetProbe;
+
+static const char *npStepNames[] = {"idle", "resolve", "ping-gw", "ping-self", "done"};
+
+//------------------------------------------------------------------
+// Xlight Network Probe Class
+//------------------------------------------------------------------
+NetProbeClass::NetProbeClass()
+{
+  m_running = false;
+  m_request = 0;
+  m_done = 0;
+  m_step = NP_STEP_IDLE;
+  m_stepWAN = false;
+  m_stepLAN = false;
+  m_stepSelf = false;
+  m_stepStart = 0;
+  m_isWAN = false;
+  m_isLAN = false;
+  m_isSelf = false;
+  m_pending = false;
+  m_lastProbe = 0;
+  m_lastDuration = 0;
+  m_nextProbe = 0;
+  m_backoff = 0;
+  m_probes = 0;
+  m_failures = 0;
+}
+
+void NetProbeClass::ThreadMain(void *param)
+{
+  NetProbeClass *probe = (NetProbeClass *)param;
+  while( true ) {
+    UL req = __atomic_load_n(&probe->m_request, __ATOMIC_ACQUIRE);
+    if( req == probe->m_done ) {
+      delay(NP_IDLE_MS);
+      continue;
+    }
+    probe->m_step = NP_STEP_RESOLVE;
+    probe->m_stepStart = millis();
+    while( probe->m_step != NP_STEP_DONE ) probe->Step();
+    __atomic_store_n(&probe->m_done, req, __ATOMIC_RELEASE);
+  }
+}
+
+BOOL NetProbeClass::Begin()
+{
+  if( m_running ) return true;
+
+  Thread *thread = new Thread("netprobe", ThreadMain, this, OS_THREAD_PRIORITY_DEFAULT, NP_STACK_SIZE);
+  m_running = (thread && thread->isValid());
+  if( !m_running ) SERIAL_LN("Network probe thread not started, probing from the main loop");
+  return m_running;
+}
+
+// One blocking call
+void NetProbeClass::Step()
+{
+  switch( m_step ) {
+  case NP_STEP_RESOLVE:
+    m_stepWAN = WiFi.resolve(NP_WAN_HOST);
+    m_stepLAN = m_stepWAN;
+    m_stepSelf = m_stepWAN;
+    m_step = (m_stepWAN ? NP_STEP_DONE : NP_STEP_PING_GATEWAY);
+    break;
+
+  case NP_STEP_PING_GATEWAY:
+    m_stepLAN = (WiFi.ping(WiFi.gatewayIP(), NP_PING_COUNT) > 0);
+    m_stepSelf = m_stepLAN;
+    m_step = (m_stepLAN ? NP_STEP_DONE : NP_STEP_PING_SELF);
+    break;
+
+  case NP_STEP_PING_SELF:
+    m_stepSelf = (WiFi.ping(WiFi.localIP(), NP_PING_COUNT) > 0);
+    m_step = NP_STEP_DONE;
+    break;
+
+  default:
+    m_step = NP_STEP_DONE;
+    break;
+  }
+}
+
+void NetProbeClass::Collect()
+{
+  UL now = millis();
+  m_pending = false;
+  m_isWAN = m_stepWAN;
+  m_isLAN = (m_stepLAN || m_stepSelf);
+  m_isSelf = m_stepSelf;
+  m_lastProbe = now;
+  if( !m_lastProbe ) m_lastProbe = 1;
+  m_lastDuration = now - m_stepStart;
+  m_probes++;
+
+  if( m_isWAN ) {
+    m_backoff = 0;
+    m_nextProbe = now + NP_TTL_GOOD;
+  } else {
+    m_failures++;
+    if( !m_stepLAN ) {
+      SERIAL_LN("Cannot reach local gateway!");
+      if( !m_stepSelf ) SERIAL_LN("Cannot reach itself!");
+    }
+    m_backoff = (m_backoff ? m_backoff * 2 : NP_BACKOFF_MIN);
+    if( m_backoff > NP_BACKOFF_MAX ) m_backoff = NP_BACKOFF_MAX;
+    m_nextProbe = now + m_backoff;
+  }
+}
+
+BOOL NetProbeClass::Tick()
+{
+  if( m_pending ) {
+    if( !m_running && m_step != NP_STEP_DONE ) {
+      Step();
+      if( m_step == NP_STEP_DONE ) m_done = m_request;
+    }
+    if( __atomic_load_n(&m_done, __ATOMIC_ACQUIRE) != m_request ) return false;
+    Collect();
+    return true;
+  }
+
+  if( (LONG)(millis() - m_nextProbe) < 0 || !WiFi.ready() ) return false;
+
+  m_pending = true;
+  if( m_running ) {
+    __atomic_store_n(&m_request, m_request + 1, __ATOMIC_RELEASE);
+  } else {
+    m_request++;
+    m_step = NP_STEP_RESOLVE;
+    m_stepStart = millis();
+  }
+  return false;
+}
+
+void NetProbeClass::Kick()
+{
+  if( !m_pending ) m_nextProbe = millis();
+}
+
+void NetProbeClass::Reset()
+{
+  m_isWAN = false;
+  m_isLAN = false;
+  m_isSelf = false;
+  m_backoff = 0;
+  Kick();
+}
+
+void NetProbeClass::print()
+{
+  UL now = millis();
+  SERIAL_LN("** Network Probe: %s **", (m_running ? "thread" : "stepped from the main loop"));
+  if( m_lastProbe ) {
+    SERIAL_LN("  WAN %s, LAN %s, self %s, %lu s ago in %lu ms", (m_isWAN ? "good" : "down"),
+        (m_isLAN ? "good" : "down"), (m_isSelf ? "good" : "down"), (now - m_lastProbe) / 1000, m_lastDuration);
+  } else {
+    SERIAL_LN("  no result yet");
+  }
+  if( m_pending ) {
+    SERIAL_LN("  probing: %s for %lu ms", npStepNames[m_step], now - m_stepStart);
+  } else {
+    SERIAL_LN("  next probe in %ld s, backoff %lu s", (LONG)(m_nextProbe - now) / 1000, m_backoff / 1000);
+  }
+  SERIAL_LN("  probes:%lu failed:%lu", m_probes, m_failures);
+  SERIAL_LN("");
+}
@@ -0,0 +1,88 @@
+//  xlxNetProbe.h - Xlight network health prober, off the main loop
+
+#ifndef xlxNetProbe_h
+#define xlxNetProbe_h
+
+#include "xliCommon.h"
+
+#define NP_WAN_HOST               "www.google.com"
+#define NP_PING_COUNT             3
+#define NP_TTL_GOOD               50000       // ms a good result is trusted
+#define NP_BACKOFF_MIN            10000       // ms between probes once the network is down,
+#define NP_BACKOFF_MAX            320000      // doubling up to this
+#define NP_STACK_SIZE             3072
+#define NP_IDLE_MS                100         // thread sleep between request checks
+
+// Probe steps, each one blocking call
+#define NP_STEP_IDLE              0
+#define NP_STEP_RESOLVE           1
+#define NP_STEP_PING_GATEWAY      2
+#define NP_STEP_PING_SELF         3
+#define NP_STEP_DONE              4
+
+//------------------------------------------------------------------
+// Network Probe Class
+//------------------------------------------------------------------
+// WiFi.resolve() and WiFi.ping() block for seconds when the network is
+// down, and there is no asynchronous version. A probe thread runs them:
+// the main loop's Tick() decides when a probe is due, asks the thread for
+// one, and picks up the outcome when the thread says it's done. The
+// results are cached; Is*Good() only reads the cache.
+/// Without the thread, Tick() runs one step per call instead.
+class NetProbeClass
+{
+private:
+  BOOL m_running;                           // thread started
+
+  // Handshake: main thread writes m_request, worker writes m_done
+  UL m_request;                             // sequence of the probe asked for
+  UL m_done;                                // sequence of the last probe finished
+
+  // Probe in progress, owned by whoever runs Step()
+  UC m_step;
+  BOOL m_stepWAN;
+  BOOL m_stepLAN;
+  BOOL m_stepSelf;
+  UL m_stepStart;
+
+  // Cached results, main thread
+  BOOL m_isWAN;
+  BOOL m_isLAN;
+  BOOL m_isSelf;
+  BOOL m_pending;                           // asked for, not collected yet
+  UL m_lastProbe;                           // millis() the last result came in, 0 if none
+  UL m_lastDuration;                        // ms the last probe took
+  UL m_nextProbe;                           // millis() of the next probe
+  UL m_backoff;                             // ms, 0 while the network is good
+  UL m_probes;
+  UL m_failures;
+
+  static void ThreadMain(void *param);
+  void Step();
+  void Collect();
+
+public:
+  NetProbeClass();
+
+  // Start the thread, Tick() steps the probe itself if it can't
+  BOOL Begin();
+  // Main loop: start a probe when due, true if a new result came in
+  BOOL Tick();
+  // Probe on the next tick, e.g. after Wi-Fi came back
+  void Kick();
+  // Wi-Fi is down, nothing to probe
+  void Reset();
+
+  BOOL IsWANGood() { return m_isWAN; }
+  BOOL IsLANGood() { return m_isLAN; }
+  BOOL IsProbing() { return m_pending; }
+
+  void print();
+};
+
+//------------------------------------------------------------------
+// Function & Class Helper
+//------------------------------------------------------------------
+extern NetProbeClass theNetProbe;
+
+#endif /* xlxNetProbe_h */
@@ -0,0 +1,321 @@
+/**
+ * xlxNodeList.cpp - Xlight node directory, cached in RAM and kept in MEM_NODELIST
+ *
+ * Created by Baoshi Sun <bs.sun@datatellit.com>
+ * Copyright (C) 2015-2016 DTIT
+ * Full contributor list:
+ *
+ * Documentation:
+ * Support Forum:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * REVISION HISTORY
+ * Version 1.0 - Created by Baoshi Sun <bs.sun@datatellit.com>
+ *
+ * DESCRIPTION
+ * 1. Every node we hear from gets an entry: node ID, type, device type,
+ *    capabilities and identity (MAC or network ID)
+ * 2. Lookup by node ID or identity goes through open-addressing indexes
+ *    of twice the table size, so probes stay short
+ * 3. Row i of the table is row i in MEM_NODELIST; only changed rows are
+ *    written, and only when the config is saved
+ * 4. Last seen time and send/receive counters are kept in RAM only
+ *
+ * ToDo:
+ * 1. Age out nodes that have not been seen for a long time
+ *
+**/
+
+#include "xlxNodeList.h"
+
+//------------------------------------------------------------------
+// the one and only instance of NodeListClass
+NodeListClass theNodeList;
+
+//------------------------------------------------------------------
+// Xlight Node List Class
+//------------------------------------------------------------------
+NodeListClass::NodeListClass()
+{
+  Clear();
+}
+
+void NodeListClass::Clear()
+{
+  for( UC row = 0; row < MAX_NODE_PER_CONTROLLER; row++ ) {
+    memset(&m_nodes[row], 0x00, sizeof(NodeInfo_t));
+    m_nodes[row].nodeID = NODEID_DUMMY;
+  }
+  m_count = 0;
+  m_dirty = 0;
+  BuildIndex();
+}
+
+US NodeListClass::HashID(UC nodeID)
+{
+  return (US)((nodeID * 0x9E37U) >> 5) & (NLIST_INDEX_SIZE - 1);
+}
+
+US NodeListClass::HashIdentity(uint64_t identity)
+{
+  UL h = (UL)identity ^ (UL)(identity >> 32);
+  return (US)((h * 2654435761UL) >> 16) & (NLIST_INDEX_SIZE - 1);
+}
+
+UC NodeListClass::TypeByID(UC nodeID)
+{
+  if( nodeID == NODEID_GATEWAY ) return NODE_TYP_GW;
+  if( !IS_NOT_DEVICE_NODEID(nodeID) ) return NODE_TYP_LAMP;
+  if( !IS_NOT_REMOTE_NODEID(nodeID) ) return NODE_TYP_REMOTE;
+  return NODE_TYP_THIRDPARTY;
+}
+
+SHORT NodeListClass::FindRow(UC nodeID)
+{
+  US slot = HashID(nodeID);
+  for( US probe = 0; probe < NLIST_INDEX_SIZE; probe++ ) {
+    UC row = m_idIndex[slot];
+    if( row == NLIST_SLOT_EMPTY ) break;
+    if( m_nodes[row].nodeID == nodeID ) return row;
+    slot = (slot + 1) & (NLIST_INDEX_SIZE - 1);
+  }
+  return -1;
+}
+
+SHORT NodeListClass::FindRowByIdentity(uint64_t identity)
+{
+  if( identity == 0 ) return -1;
+  US slot = HashIdentity(identity);
+  for( US probe = 0; probe < NLIST_INDEX_SIZE; probe++ ) {
+    UC row = m_identityIndex[slot];
+    if( row == NLIST_SLOT_EMPTY ) break;
+    if( m_nodes[row].identity == identity ) return row;
+    slot = (slot + 1) & (NLIST_INDEX_SIZE - 1);
+  }
+  return -1;
+}
+
+// Insert a row into both indexes, the tables never fill up (load <= 1/2)
+void NodeListClass::IndexRow(UC row)
+{
+  US slot = HashID(m_nodes[row].nodeID);
+  while( m_idIndex[slot] != NLIST_SLOT_EMPTY ) slot = (slot + 1) & (NLIST_INDEX_SIZE - 1);
+  m_idIndex[slot] = row;
+
+  if( m_nodes[row].identity ) {
+    slot = HashIdentity(m_nodes[row].identity);
+    while( m_identityIndex[slot] != NLIST_SLOT_EMPTY ) slot = (slot + 1) & (NLIST_INDEX_SIZE - 1);
+    m_identityIndex[slot] = row;
+  }
+}
+
+// Removing from open addressing would need tombstones; removal is rare,
+/// so just rebuild
+void NodeListClass::BuildIndex()
+{
+  memset(m_idIndex, NLIST_SLOT_EMPTY, sizeof(m_idIndex));
+  memset(m_identityIndex, NLIST_SLOT_EMPTY, sizeof(m_identityIndex));
+  for( UC row = 0; row < MAX_NODE_PER_CONTROLLER; row++ ) {
+    if( m_nodes[row].nodeID != NODEID_DUMMY ) IndexRow(row);
+  }
+}
+
+void NodeListClass::SetRowChanged(UC row)
+{
+  m_dirty |= ((uint64_t)1 << row);
+}
+
+BOOL NodeListClass::Load()
+{
+  Clear();
+  if( MAX_NODE_PER_CONTROLLER * NLIST_ROW_SIZE > MEM_NODELIST_LEN ) {
+    SERIAL_LN(F("Failed to load NodeList, too large."));
+    return false;
+  }
+
+  NodeRow_t nodeRow;
+  for( UC row = 0; row < MAX_NODE_PER_CONTROLLER; row++ ) {
+    EEPROM.get(MEM_NODELIST_OFFSET + row * NLIST_ROW_SIZE, nodeRow);
+    if( nodeRow.nodeID == NODEID_DUMMY || FindRow(nodeRow.nodeID) >= 0 ) continue;
+    if( nodeRow.type != NODE_TYP_GW && nodeRow.type != NODE_TYP_LAMP && nodeRow.type != NODE_TYP_REMOTE
+      && nodeRow.type != NODE_TYP_SYSTEM && nodeRow.type != NODE_TYP_THIRDPARTY ) {
+      // Garbage, free the row on the next save
+      SetRowChanged(row);
+      continue;
+    }
+
+    NodeInfo_t &node = m_nodes[row];
+    node.nodeID = nodeRow.nodeID;
+    node.type = nodeRow.type;
+    node.devType = nodeRow.devType;
+    node.caps = nodeRow.caps;
+    node.identity = 0;
+    for( SHORT i = sizeof(nodeRow.identity) - 1; i >= 0; i-- )
+      node.identity = (node.identity << 8) | nodeRow.identity[i];
+    IndexRow(row);
+    m_count++;
+  }
+
+  SERIAL_LN("NodeList loaded, %d node(s).", m_count);
+  return true;
+}
+
+// Write the changed rows, returns the number of rows written
+US NodeListClass::Save()
+{
+  US nRows = 0;
+  for( UC row = 0; m_dirty && row < MAX_NODE_PER_CONTROLLER; row++ ) {
+    if( !(m_dirty & ((uint64_t)1 << row)) ) continue;
+    m_dirty &= ~((uint64_t)1 << row);
+
+    const NodeInfo_t &node = m_nodes[row];
+    NodeRow_t nodeRow;
+    memset(&nodeRow, NLIST_SLOT_EMPTY, sizeof(nodeRow));
+    if( node.nodeID != NODEID_DUMMY ) {
+      nodeRow.nodeID = node.nodeID;
+      nodeRow.type = node.type;
+      nodeRow.devType = node.devType;
+      nodeRow.caps = node.caps;
+      for( UC i = 0; i < sizeof(nodeRow.identity); i++ )
+        nodeRow.identity[i] = (UC)(node.identity >> (i * 8));
+    }
+
+    // Only the bytes that differ
+    US addr = MEM_NODELIST_OFFSET + row * NLIST_ROW_SIZE;
+    const UC *data = (const UC *)&nodeRow;
+    for( UC i = 0; i < NLIST_ROW_SIZE; i++ ) {
+      if( EEPROM.read(addr + i) != data[i] ) EEPROM.write(addr + i, data[i]);
+    }
+    nRows++;
+  }
+  return nRows;
+}
+
+NodeInfo_t *NodeListClass::GetNode(UC nodeID)
+{
+  SHORT row = FindRow(nodeID);
+  return (row >= 0 ? &m_nodes[row] : NULL);
+}
+
+NodeInfo_t *NodeListClass::GetNodeByIdentity(uint64_t identity)
+{
+  SHORT row = FindRowByIdentity(identity);
+  return (row >= 0 ? &m_nodes[row] : NULL);
+}
+
+// Returns the existing or new entry, NULL if the table is full
+NodeInfo_t *NodeListClass::AddNode(UC nodeID, UC type)
+{
+  if( nodeID == NODEID_DUMMY ) return NULL;
+  SHORT row = FindRow(nodeID);
+  if( row >= 0 ) return &m_nodes[row];
+
+  for( row = 0; row < MAX_NODE_PER_CONTROLLER; row++ ) {
+    if( m_nodes[row].nodeID == NODEID_DUMMY ) {
+      NodeInfo_t &node = m_nodes[row];
+      memset(&node, 0x00, sizeof(NodeInfo_t));
+      node.nodeID = nodeID;
+      node.type = type;
+      IndexRow(row);
+      SetRowChanged(row);
+      m_count++;
+      return &node;
+    }
+  }
+
+  SERIAL_LN("NodeList is full, node %d ignored", nodeID);
+  return NULL;
+}
+
+BOOL NodeListClass::RemoveNode(UC nodeID)
+{
+  SHORT row = FindRow(nodeID);
+  if( row < 0 ) return false;
+
+  memset(&m_nodes[row], 0x00, sizeof(NodeInfo_t));
+  m_nodes[row].nodeID = NODEID_DUMMY;
+  SetRowChanged(row);
+  m_count--;
+  BuildIndex();
+  return true;
+}
+
+BOOL NodeListClass::SetIdentity(UC nodeID, uint64_t identity)
+{
+  NodeInfo_t *pNode = AddNode(nodeID, TypeByID(nodeID));
+  if( !pNode ) return false;
+  if( pNode->identity == identity ) return true;
+
+  // Another node can't keep the same identity
+  SHORT other = FindRowByIdentity(identity);
+  if( other >= 0 ) {
+    m_nodes[other].identity = 0;
+    SetRowChanged(other);
+  }
+
+  pNode->identity = identity;
+  SetRowChanged(pNode - m_nodes);
+  BuildIndex();
+  return true;
+}
+
+BOOL NodeListClass::SetDevType(UC nodeID, UC devType)
+{
+  NodeInfo_t *pNode = AddNode(nodeID, TypeByID(nodeID));
+  if( !pNode ) return false;
+
+  UC caps = 0;
+  if( IS_SUNNY(devType) ) {
+    caps = NCAP_SWITCH | NCAP_DIMMER | NCAP_CCT;
+  } else if( IS_RAINBOW(devType) ) {
+    caps = NCAP_SWITCH | NCAP_DIMMER | NCAP_CCT | NCAP_RGB;
+  } else if( IS_MIRAGE(devType) ) {
+    caps = NCAP_SWITCH | NCAP_DIMMER | NCAP_CCT | NCAP_RGB | NCAP_MOTION;
+  }
+
+  if( pNode->devType != devType || pNode->caps != caps ) {
+    pNode->devType = devType;
+    pNode->caps = caps;
+    SetRowChanged(pNode - m_nodes);
+  }
+  return true;
+}
+
+void NodeListClass::NodeSeen(UC nodeID)
+{
+  NodeInfo_t *pNode = AddNode(nodeID, TypeByID(nodeID));
+  if( pNode ) {
+    pNode->lastSeen = millis();
+    pNode->received++;
+  }
+}
+
+void NodeListClass::NodeSent(UC nodeID, BOOL ok)
+{
+  NodeInfo_t *pNode = GetNode(nodeID);
+  if( pNode ) {
+    pNode->sent++;
+    if( !ok ) pNode->sendFailed++;
+  }
+}
+
+void NodeListClass::print()
+{
+  char strDisplay[24];
+  SERIAL_LN("** Node List: %d node(s) **", m_count);
+  for( UC row = 0; row < MAX_NODE_PER_CONTROLLER; row++ ) {
+    const NodeInfo_t &node = m_nodes[row];
+    if( node.nodeID == NODEID_DUMMY ) continue;
+    SERIAL_LN("  %3d %c dev:%d caps:0x%02X id:%s seen:%lus rx:%d tx:%d fail:%d%s",
+        node.nodeID, node.type, node.devType, node.caps, PrintUint64(strDisplay, node.identity),
+        (node.lastSeen ? (millis() - node.lastSeen) / 1000 : 0),
+        node.received, node.sent, node.sendFailed,
+        (m_dirty & ((uint64_t)1 << row)) ? " unsaved" : "");
+  }
+  SERIAL_LN("");
+}
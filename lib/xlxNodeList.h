@@ -0,0 +1,105 @@
+//  xlxNodeList.h - Xlight node directory, cached in RAM and kept in MEM_NODELIST
+
+#ifndef xlxNodeList_h
+#define xlxNodeList_h
+
+#include "xliCommon.h"
+#include "xliMemoryMap.h"
+
+// Node capabilities
+#define NCAP_SWITCH               0x01
+#define NCAP_DIMMER               0x02
+#define NCAP_CCT                  0x04
+#define NCAP_RGB                  0x08
+#define NCAP_MOTION               0x10
+
+#define NLIST_INDEX_SIZE          (MAX_NODE_PER_CONTROLLER * 2)   // power of 2
+#define NLIST_SLOT_EMPTY          0xFF
+
+// One dirty bit per row
+#if MAX_NODE_PER_CONTROLLER > 64
+#error "Node list dirty bitmap holds 64 rows"
+#endif
+
+//------------------------------------------------------------------
+// Node Directory Structures
+//------------------------------------------------------------------
+// As stored in MEM_NODELIST, an erased row has nodeID 0xFF
+typedef struct
+{
+  UC nodeID;
+  UC type;                                  // NODE_TYP_*
+  UC devType;                               // devicetype_t or remotetype_t
+  UC caps;                                  // NCAP_* bits
+  UC identity[6];                           // MAC or network ID, LSB first
+} NodeRow_t;
+
+#define NLIST_ROW_SIZE            sizeof(NodeRow_t)
+
+// In RAM, with link statistics that are not persisted
+typedef struct
+{
+  UC nodeID;
+  UC type;
+  UC devType;
+  UC caps;
+  uint64_t identity;                        // 0 if unknown
+  UL lastSeen;                              // millis() of the last message
+  US received;
+  US sent;
+  US sendFailed;
+} NodeInfo_t;
+
+//------------------------------------------------------------------
+// Node List Class
+//------------------------------------------------------------------
+// Entries live in a fixed table; two open-addressing indexes (by node ID
+// and by identity) map keys to table rows. Changed rows are marked dirty
+// and written by Save(), which runs with the periodic config save.
+class NodeListClass
+{
+private:
+  NodeInfo_t m_nodes[MAX_NODE_PER_CONTROLLER];
+  UC m_idIndex[NLIST_INDEX_SIZE];
+  UC m_identityIndex[NLIST_INDEX_SIZE];
+  uint64_t m_dirty;                         // bit per row
+  UC m_count;
+
+  static US HashID(UC nodeID);
+  static US HashIdentity(uint64_t identity);
+  static UC TypeByID(UC nodeID);
+  SHORT FindRow(UC nodeID);
+  SHORT FindRowByIdentity(uint64_t identity);
+  void IndexRow(UC row);
+  void BuildIndex();
+  void SetRowChanged(UC row);
+
+public:
+  NodeListClass();
+
+  void Clear();
+  BOOL Load();
+  US Save();
+
+  UC GetCount() { return m_count; }
+  NodeInfo_t *GetNode(UC nodeID);
+  NodeInfo_t *GetNodeByIdentity(uint64_t identity);
+  NodeInfo_t *AddNode(UC nodeID, UC type);
+  BOOL RemoveNode(UC nodeID);
+
+  BOOL SetIdentity(UC nodeID, uint64_t identity);
+  BOOL SetDevType(UC nodeID, UC devType);
+
+  // Link statistics, RAM only
+  void NodeSeen(UC nodeID);
+  void NodeSent(UC nodeID, BOOL ok);
+
+  void print();
+};
+
+//------------------------------------------------------------------
+// Function & Class Helper
+//------------------------------------------------------------------
+extern NodeListClass theNodeList;
+
+#endif /* xlxNodeList_h */
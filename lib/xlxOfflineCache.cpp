@@ -0,0 +1,297 @@
+/**
+ * xlxOfflineCache.cpp - Xlight outbound command cache for when the link is down
+ *
+ * Created by Baoshi Sun <bs.sun@datatellit.com>
+ * Copyright (C) 2015-2016 DTIT
+ * Full contributor list:
+ *
+ * Documentation:
+ * Support Forum:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * REVISION HISTORY
+ * Version 1.0 - Created by Baoshi Sun <bs.sun@datatellit.com>
+ *
+ * DESCRIPTION
+ * 1. A C_SET or C_REQ message that fails to go out is appended to the cache
+ *    with a timestamp instead of being lost
+ * 2. A newer command for the same (dest, command, type, sensor) supersedes
+ *    the pending one, e.g. a brightness slider only replays its last value
+ * 3. Replay runs from the main loop one message at a time, right after the
+ *    link comes back and every OFFLINE_RETRY_INTERVAL while it's still down
+ * 4. Commands older than OFFLINE_MAX_AGE are dropped rather than replayed.
+ *    Age runs on millis(), so the clock jumping at the first Cloud sync
+ *    doesn't expire what was cached at boot
+ *
+ * ToDo:
+ * 1. External flash backend at MEM_OFFLINE_DATA_OFFSET on the P1
+ *
+**/
+
+#include "xlxOfflineCache.h"
+#include "xlxRF24Client.h"
+
+//------------------------------------------------------------------
+// the one and only instance of OfflineCacheClass, with RAM storage
+static UC offlineRamBuf[OFFLINE_RAM_SIZE];
+RamOfflineStorage theOfflineRam(offlineRamBuf, sizeof(offlineRamBuf));
+OfflineCacheClass theOffline;
+
+//------------------------------------------------------------------
+// RAM Storage
+//------------------------------------------------------------------
+RamOfflineStorage::RamOfflineStorage(void *buf, UL size, BOOL erase)
+{
+  m_buf = (UC *)buf;
+  m_size = size;
+  if( erase ) memset(m_buf, 0xFF, m_size);
+}
+
+BOOL RamOfflineStorage::Read(UL addr, void *buf, US len)
+{
+  if( addr + len > m_size ) return false;
+  memcpy(buf, m_buf + addr, len);
+  return true;
+}
+
+BOOL RamOfflineStorage::Write(UL addr, const void *buf, US len)
+{
+  if( addr + len > m_size ) return false;
+  memcpy(m_buf + addr, buf, len);
+  return true;
+}
+
+//------------------------------------------------------------------
+// Xlight Offline Cache Class
+//------------------------------------------------------------------
+OfflineCacheClass::OfflineCacheClass()
+{
+  m_storage = NULL;
+  m_slots = 0;
+  m_seq = 0;
+  m_replaying = false;
+  m_nextTry = 0;
+  m_cached = 0;
+  m_replayed = 0;
+  m_coalesced = 0;
+  m_dropped = 0;
+  m_expired = 0;
+  Clear();
+}
+
+// Command (C_SET, C_REQ) is at least 1, so a valid key is never 0.
+/// A V_RGBW set names its ring in payload[4], all rings if it is shorter;
+/// sets to different rings of a lamp don't replace each other.
+UL OfflineCacheClass::MakeKey(MyMessage &msg)
+{
+  UC ring = RING_ID_ALL;
+  if( msg.getCommand() == C_SET && msg.getType() == V_RGBW && msg.getLength() > 4 ) {
+    ring = ((UC *)msg.getCustom())[4];
+  }
+  return ((UL)msg.getDestination() << 24) | ((UL)(msg.getCommand() & 0x0F) << 20)
+    | ((UL)(ring & 0x0F) << 16) | ((UL)msg.getType() << 8) | msg.getSensor();
+}
+
+BOOL OfflineCacheClass::Begin(OfflineStorage *storage)
+{
+  m_storage = storage;
+  Clear();
+  if( !m_storage ) return false;
+
+  UL nSlots = m_storage->GetSize();
+  if( nSlots > MEM_OFFLINE_DATA_LEN ) nSlots = MEM_OFFLINE_DATA_LEN;
+  nSlots /= sizeof(OfflineEntry_t);
+  m_slots = (US)(nSlots < OFFLINE_MAX_ENTRIES ? nSlots : OFFLINE_MAX_ENTRIES);
+
+  // Pending entries run from the oldest to the newest sequence number
+  OfflineEntry_t entry;
+  MyMessage msg;
+  SHORT oldest = -1, newest = -1;
+  US seqOldest = 0, seqNewest = 0;
+  for( US slot = 0; slot < m_slots; slot++ ) {
+    if( !m_storage->Read(SlotAddr(slot), &entry, sizeof(entry)) ) continue;
+    if( entry.state != OFFLINE_ENT_VALID || entry.len < HEADER_SIZE || entry.len > MAX_MESSAGE_LENGTH ) continue;
+
+    memset(&msg.msg, 0x00, sizeof(msg.msg));
+    memcpy(&msg.msg, entry.data, entry.len);
+    m_keys[slot] = MakeKey(msg);
+    m_count++;
+
+    // From before the reset: aged by the clock if it is set on both ends,
+    /// else its age starts over now
+    UL age = 0;
+    if( entry.time && Time.isValid() && (UL)Time.now() >= entry.time ) age = (UL)Time.now() - entry.time;
+    if( age > OFFLINE_MAX_AGE ) age = OFFLINE_MAX_AGE + 1;
+    m_cachedAt[slot] = millis() - age * 1000;
+    if( oldest < 0 || (SHORT)(entry.seq - seqOldest) < 0 ) { oldest = slot; seqOldest = entry.seq; }
+    if( newest < 0 || (SHORT)(entry.seq - seqNewest) > 0 ) { newest = slot; seqNewest = entry.seq; }
+  }
+
+  if( m_count > 0 ) {
+    m_head = oldest;
+    m_span = (newest - oldest + m_slots) % m_slots + 1;
+    m_seq = seqNewest + 1;
+    SERIAL_LN("Offline cache: %d command(s) pending", m_count);
+  }
+  return true;
+}
+
+void OfflineCacheClass::Clear()
+{
+  memset(m_keys, 0x00, sizeof(m_keys));
+  m_head = 0;
+  m_span = 0;
+  m_count = 0;
+  m_inFlight = OFFLINE_NO_SLOT;
+  m_inFlightKey = 0;
+}
+
+void OfflineCacheClass::MarkDone(US slot)
+{
+  if( !m_keys[slot] ) return;
+  UC state = OFFLINE_ENT_DONE;
+  m_storage->Write(SlotAddr(slot), &state, 1);
+  m_keys[slot] = 0;
+  m_count--;
+}
+
+// Release the finished entries at the head
+void OfflineCacheClass::Trim()
+{
+  while( m_span > 0 && !m_keys[m_head] ) {
+    m_head = (m_head + 1) % m_slots;
+    m_span--;
+  }
+}
+
+BOOL OfflineCacheClass::Append(MyMessage &msg)
+{
+  if( !m_storage || m_slots == 0 ) return false;
+  UC cmd = msg.getCommand();
+  if( (cmd != C_SET && cmd != C_REQ) || msg.isAck() ) return false;
+
+  // Supersede the pending command with the same key
+  UL key = MakeKey(msg);
+  for( US i = 0; i < m_span; i++ ) {
+    US slot = (m_head + i) % m_slots;
+    if( m_keys[slot] == key ) {
+      MarkDone(slot);
+      m_coalesced++;
+    }
+  }
+  Trim();
+
+  // Full, the oldest one goes
+  if( m_span >= m_slots ) {
+    MarkDone(m_head);
+    m_dropped++;
+    Trim();
+  }
+
+  OfflineEntry_t entry;
+  entry.state = OFFLINE_ENT_VALID;
+  entry.len = HEADER_SIZE + msg.getLength();
+  if( entry.len > MAX_MESSAGE_LENGTH ) entry.len = MAX_MESSAGE_LENGTH;
+  entry.seq = m_seq++;
+  // The clock may not be set yet before the first Cloud sync, so the age
+  /// goes by millis(); the time only helps across a reset
+  entry.time = (Time.isValid() ? Time.now() : 0);
+  memset(entry.data, 0x00, sizeof(entry.data));
+  memcpy(entry.data, &msg.msg, entry.len);
+
+  // State byte last, so a torn write is never replayed
+  US slot = (m_head + m_span) % m_slots;
+  UL addr = SlotAddr(slot);
+  if( !m_storage->Write(addr + 1, (UC *)&entry + 1, sizeof(entry) - 1) ) return false;
+  if( !m_storage->Write(addr, &entry.state, 1) ) return false;
+
+  m_keys[slot] = key;
+  m_cachedAt[slot] = millis();
+  m_span++;
+  m_count++;
+  m_cached++;
+  return true;
+}
+
+BOOL OfflineCacheClass::Replay()
+{
+  if( !m_storage || m_count == 0 || m_inFlight != OFFLINE_NO_SLOT ) return false;
+  if( m_nextTry && (LONG)(millis() - m_nextTry) < 0 ) return false;
+
+  OfflineEntry_t entry;
+  MyMessage msg;
+  for( US i = 0; i < m_span; i++ ) {
+    US slot = (m_head + i) % m_slots;
+    if( !m_keys[slot] ) continue;
+    if( !m_storage->Read(SlotAddr(slot), &entry, sizeof(entry)) || entry.len > MAX_MESSAGE_LENGTH ) {
+      MarkDone(slot);
+      continue;
+    }
+
+    if( millis() - m_cachedAt[slot] > OFFLINE_MAX_AGE * 1000UL ) {
+      MarkDone(slot);
+      m_expired++;
+      continue;
+    }
+
+    memset(&msg.msg, 0x00, sizeof(msg.msg));
+    memcpy(&msg.msg, entry.data, entry.len);
+    m_replaying = true;
+    BOOL queued = theRadio.ProcessSend(&msg);
+    m_replaying = false;
+    if( queued ) {
+      m_inFlight = slot;
+      m_inFlightKey = m_keys[slot];
+    } else {
+      ReplayDone(false);
+    }
+    Trim();
+    return queued;
+  }
+  Trim();
+  return false;
+}
+
+void OfflineCacheClass::ReplayDone(BOOL sentOK)
+{
+  US slot = m_inFlight;
+  m_inFlight = OFFLINE_NO_SLOT;
+  if( !sentOK ) {
+    // Still down, keep the order and try again later
+    m_nextTry = millis() + OFFLINE_RETRY_INTERVAL;
+    if( !m_nextTry ) m_nextTry = 1;
+    return;
+  }
+
+  // Unless a newer command took its place meanwhile
+  if( slot != OFFLINE_NO_SLOT && m_keys[slot] == m_inFlightKey ) {
+    MarkDone(slot);
+    m_replayed++;
+    Trim();
+    SERIAL_LN("Offline cache: replayed 1, %d pending", m_count);
+  }
+}
+
+void OfflineCacheClass::print()
+{
+  SERIAL_LN("** Offline Cache: %d of %d pending **", m_count, m_slots);
+  SERIAL_LN("  cached:%lu replayed:%lu coalesced:%lu dropped:%lu expired:%lu",
+      m_cached, m_replayed, m_coalesced, m_dropped, m_expired);
+
+  if( !m_storage ) return;
+  OfflineEntry_t entry;
+  for( US i = 0; i < m_span; i++ ) {
+    US slot = (m_head + i) % m_slots;
+    if( !m_keys[slot] || !m_storage->Read(SlotAddr(slot), &entry, sizeof(entry)) ) continue;
+    SERIAL_LN("  #%d dest:%lu cmd:%lu ring:%lu type:%lu sensor:%lu age:%lus", entry.seq,
+        m_keys[slot] >> 24, (m_keys[slot] >> 20) & 0x0F, (m_keys[slot] >> 16) & 0x0F,
+        (m_keys[slot] >> 8) & 0xFF, m_keys[slot] & 0xFF,
+        (millis() - m_cachedAt[slot]) / 1000);
+  }
+  SERIAL_LN("");
+}
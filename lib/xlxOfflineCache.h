@@ -0,0 +1,126 @@
+//  xlxOfflineCache.h - Xlight outbound command cache for when the link is down
+
+#ifndef xlxOfflineCache_h
+#define xlxOfflineCache_h
+
+#include "xliCommon.h"
+#include "xliMemoryMap.h"
+#include "MyMessage.h"
+
+#define OFFLINE_MAX_ENTRIES       64          // bounds the RAM key table
+#define OFFLINE_RAM_SIZE          1280        // 32 entries with the RAM backend
+#define OFFLINE_NO_SLOT           0xFFFF
+#define OFFLINE_RETRY_INTERVAL    2000        // ms between replay attempts while the link is down
+#define OFFLINE_MAX_AGE           600         // seconds, older commands are not replayed
+
+// Entry state, only ever clears bits so a flash backend needs no erase per entry
+#define OFFLINE_ENT_VALID         0x5A
+#define OFFLINE_ENT_DONE          0x00
+
+//------------------------------------------------------------------
+// Offline Cache Structures
+//------------------------------------------------------------------
+typedef struct
+{
+  UC state;                                 // OFFLINE_ENT_*, written last
+  UC len;                                   // bytes of data used
+  US seq;                                   // append order, wraps
+  UL time;                                  // Time.now() when cached, 0 if the clock wasn't set
+  UC data[MAX_MESSAGE_LENGTH];              // MyMessage as sent over the air
+} OfflineEntry_t;
+
+//------------------------------------------------------------------
+// Storage Interface
+//------------------------------------------------------------------
+// Byte-addressed, addresses start at 0. The external flash at
+/// MEM_OFFLINE_DATA_OFFSET is meant to be one more implementation.
+class OfflineStorage
+{
+public:
+  virtual UL GetSize() = 0;
+  virtual BOOL Read(UL addr, void *buf, US len) = 0;
+  virtual BOOL Write(UL addr, const void *buf, US len) = 0;
+};
+
+// Caller-provided RAM buffer, does not survive a reset unless it is
+/// retained memory and isn't erased here (erase = false)
+class RamOfflineStorage : public OfflineStorage
+{
+private:
+  UC *m_buf;
+  UL m_size;
+
+public:
+  RamOfflineStorage(void *buf, UL size, BOOL erase = true);
+
+  virtual UL GetSize() { return m_size; }
+  virtual BOOL Read(UL addr, void *buf, US len);
+  virtual BOOL Write(UL addr, const void *buf, US len);
+};
+
+//------------------------------------------------------------------
+// Offline Cache Class
+//------------------------------------------------------------------
+// A ring of fixed-size entries in the storage. Append() supersedes any
+// pending entry with the same key (dest, command, type, sensor, and the
+// ring of a V_RGBW set), so a replay only sends the latest value of each. Replay() hands the oldest
+// entry to the RF worker, and the next one waits for ReplayDone(), so a
+// failure stops the replay with the order kept.
+class OfflineCacheClass
+{
+private:
+  OfflineStorage *m_storage;
+  US m_slots;                               // entries that fit, <= OFFLINE_MAX_ENTRIES
+  UL m_keys[OFFLINE_MAX_ENTRIES];           // key of each pending slot, 0 if none
+  UL m_cachedAt[OFFLINE_MAX_ENTRIES];       // millis() when cached, ages go by this
+  US m_head;                                // oldest slot in use
+  US m_span;                                // slots from head to tail, incl. done ones
+  US m_count;                               // pending entries
+  US m_seq;
+  BOOL m_replaying;
+  US m_inFlight;                            // slot handed to the RF worker
+  UL m_inFlightKey;
+  UL m_nextTry;                             // millis() of the next replay attempt
+
+  // Statistics
+  UL m_cached;
+  UL m_replayed;
+  UL m_coalesced;
+  UL m_dropped;
+  UL m_expired;
+
+  static UL MakeKey(MyMessage &msg);
+  UL SlotAddr(US slot) { return (UL)slot * sizeof(OfflineEntry_t); }
+  void MarkDone(US slot);
+  void Trim();
+
+public:
+  OfflineCacheClass();
+
+  // Scan the storage and resume whatever is still pending
+  BOOL Begin(OfflineStorage *storage);
+  void Clear();
+
+  // Keep a message that could not be sent, false if not cacheable
+  BOOL Append(MyMessage &msg);
+  // Queue the oldest pending message, unless one is still in flight
+  BOOL Replay();
+  // Outcome of the message queued by Replay()
+  void ReplayDone(BOOL sentOK);
+  // Link looks good again, replay on the next round
+  void LinkUp() { m_nextTry = 0; }
+
+  BOOL IsReplaying() { return m_replaying; }
+  US GetCount() { return m_count; }
+  US GetCapacity() { return m_slots; }
+
+  void print();
+};
+
+//------------------------------------------------------------------
+// Function & Class Helper
+//------------------------------------------------------------------
+extern OfflineCacheClass theOffline;
+extern RamOfflineStorage theOfflineRam;
+
+#endif /* xlxOfflineCache_h */
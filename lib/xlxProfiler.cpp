@@ -0,0 +1,127 @@
+/**
+ * xlxProfiler.cpp - Xlight main loop profiler, durations in log-scale histograms
+ *
+ * Created by Baoshi Sun <bs.sun@datatellit.com>
+ * Copyright (C) 2015-2016 DTIT
+ * Full contributor list:
+ *
+ * Documentation:
+ * Support Forum:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * REVISION HISTORY
+ * Version 1.0 - Created by Baoshi Sun <bs.sun@datatellit.com>
+ *
+ * DESCRIPTION
+ * 1. Each probe keeps count, min, max, sum and a histogram of micros()
+ *    durations with one bucket per power of two
+ * 2. 'show perf' prints min/p50/p99/max per probe and the boot phases,
+ *    'set perf reset' starts over
+ *
+ * ToDo:
+ *
+**/
+
+#include "xlxProfiler.h"
+#include "xlSmartRemote.h"
+
+//------------------------------------------------------------------
+// the one and only instance of ProfilerClass
+ProfilerClass theProfiler;
+
+static const char *perfNames[PERF_PROBES] = {
+  "loop", "rf-recv", "console", "asr", "rules", "checks", "cloud", "save", "rf-send"
+};
+
+//------------------------------------------------------------------
+// Xlight Profiler Class
+//------------------------------------------------------------------
+ProfilerClass::ProfilerClass()
+{
+  Reset();
+}
+
+void ProfilerClass::Reset()
+{
+  for( UC i = 0; i < PERF_PROBES; i++ ) Reset(m_probe[i]);
+  m_resetTime = millis();
+}
+
+void ProfilerClass::Record(UC probe, UL us)
+{
+  if( probe >= PERF_PROBES ) return;
+  Record(m_probe[probe], us);
+}
+
+UL ProfilerClass::Percentile(UC probe, UC pct)
+{
+  if( probe >= PERF_PROBES ) return 0;
+  return Percentile(m_probe[probe], pct);
+}
+
+void ProfilerClass::Reset(PerfProbe_t &p)
+{
+  memset(&p, 0x00, sizeof(p));
+  p.min = 0xFFFFFFFF;
+}
+
+void ProfilerClass::Record(PerfProbe_t &p, UL us)
+{
+  p.count++;
+  p.sum += us;
+  if( us < p.min ) p.min = us;
+  if( us > p.max ) p.max = us;
+  UC bucket = (us ? 31 - __builtin_clz(us) : 0);
+  if( bucket >= PERF_BUCKETS ) bucket = PERF_BUCKETS - 1;
+  p.bucket[bucket]++;
+}
+
+UL ProfilerClass::Percentile(const PerfProbe_t &p, UC pct)
+{
+  if( p.count == 0 ) return 0;
+
+  // Rank of the sample wanted, 1-based
+  UL rank = (UL)(((uint64_t)p.count * pct + 99) / 100);
+  if( rank == 0 ) rank = 1;
+  UL seen = 0;
+  for( UC b = 0; b < PERF_BUCKETS; b++ ) {
+    if( seen + p.bucket[b] < rank ) {
+      seen += p.bucket[b];
+      continue;
+    }
+    UL lo = (b ? 1UL << b : 0);
+    UL hi = (b < PERF_BUCKETS - 1 ? 1UL << (b + 1) : p.max);
+    UL value = lo + (UL)((uint64_t)(hi - lo) * (rank - seen) / p.bucket[b]);
+    if( value < p.min ) value = p.min;
+    if( value > p.max ) value = p.max;
+    return value;
+  }
+  return p.max;
+}
+
+const char *ProfilerClass::GetName(UC probe)
+{
+  return (probe < PERF_PROBES ? perfNames[probe] : "?");
+}
+
+void ProfilerClass::print()
+{
+  SERIAL_LN("** Profiler: %lu s since reset, durations in us **", (millis() - m_resetTime) / 1000);
+  SERIAL_LN("  %-9s %8s %8s %8s %8s %8s %8s", "probe", "count", "avg", "min", "p50", "p99", "max");
+  for( UC i = 0; i < PERF_PROBES; i++ ) {
+    const PerfProbe_t &p = m_probe[i];
+    if( p.count == 0 ) {
+      SERIAL_LN("  %-9s %8d", perfNames[i], 0);
+      continue;
+    }
+    SERIAL_LN("  %-9s %8lu %8lu %8lu %8lu %8lu %8lu", perfNames[i], p.count, (UL)(p.sum / p.count),
+        p.min, Percentile(i, 50), Percentile(i, 99), p.max);
+  }
+  SERIAL_LN("");
+  theSys.PrintBoot();
+}
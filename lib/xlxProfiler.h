@@ -0,0 +1,69 @@
+//  xlxProfiler.h - Xlight main loop profiler, durations in log-scale histograms
+
+#ifndef xlxProfiler_h
+#define xlxProfiler_h
+
+#include "xliCommon.h"
+
+// Probes
+#define PERF_LOOP                 0           // a pass over the tasks, without the sleep
+#define PERF_RF_RECEIVE           1
+#define PERF_CONSOLE              2
+#define PERF_ASR                  3
+#define PERF_RULES                4           // alarms and rule evaluation
+#define PERF_CHECKS               5           // boot, RF, network and time sync checks
+#define PERF_CLOUD                6           // Particle.process()
+#define PERF_SAVE_CONFIG          7           // EEPROM saves
+#define PERF_RF_SEND              8
+#define PERF_PROBES               9
+
+// Bucket i holds [2^i, 2^(i+1)) us, the last one everything above 8s
+#define PERF_BUCKETS              24
+
+//------------------------------------------------------------------
+// Profiler Structures
+//------------------------------------------------------------------
+typedef struct
+{
+  UL count;
+  UL min;
+  UL max;
+  uint64_t sum;
+  UL bucket[PERF_BUCKETS];
+} PerfProbe_t;
+
+//------------------------------------------------------------------
+// Profiler Class
+//------------------------------------------------------------------
+// Record() is a few adds and a count-leading-zeros, so the probes stay in
+// the release build. Percentiles are interpolated within the bucket that
+// holds them, and clamped to the observed min and max.
+class ProfilerClass
+{
+private:
+  PerfProbe_t m_probe[PERF_PROBES];
+  UL m_resetTime;                           // millis() of the last reset
+
+public:
+  ProfilerClass();
+
+  void Reset();
+  void Record(UC probe, UL us);
+  // Estimated pct-th percentile in us
+  UL Percentile(UC probe, UC pct);
+  const char *GetName(UC probe);
+
+  // The same histogram for other measurements, e.g. the RF flood test
+  static void Reset(PerfProbe_t &p);
+  static void Record(PerfProbe_t &p, UL us);
+  static UL Percentile(const PerfProbe_t &p, UC pct);
+
+  void print();
+};
+
+//------------------------------------------------------------------
+// Function & Class Helper
+//------------------------------------------------------------------
+extern ProfilerClass theProfiler;
+
+#endif /* xlxProfiler_h */
@@ -28,7 +28,8 @@
  * 2. Address algorithm
  * 3. PipePool (0 AdminPipe, Read & Write; 1-5 pipe pool, Read)
  * 4. Session manager, optional address shifting
- * 5.
+ * 5. Frames go out and come in through the RF worker (xlxRFWorker), this
+ *    class handles what it posts back on the main thread
  *
  * ToDo:
  * 1. Two pipes collaboration for security: divide a message into two parts
@@ -38,6 +39,13 @@
 
 #include "xlxRF24Client.h"
 #include "xlSmartRemote.h"
+#include "xlxNodeList.h"
+#include "xlxOfflineCache.h"
+#include "xlxRuleEngine.h"
+#include "xlxStatistics.h"
+#include "xlxProfiler.h"
+#include "xlxRFBench.h"
+#include "xlxLogger.h"
 #include "MyParserSerial.h"
 
 //------------------------------------------------------------------
@@ -92,15 +100,18 @@ bool RF24ClientClass::ChangeNodeID(const uint8_t bNodeID)
 	if( bNodeID == 0 ) {
 		return false;
 	} else {
+		RFWorkerLock lock;
+		if( !lock.IsParked() ) return false;
 		setAddress(bNodeID, RF24_BASE_RADIO_ID);
 	}
 
 	return true;
 }
 
-bool RF24ClientClass::ProcessSend(String &strMsg, MyMessage &my_msg)
+// Build msg from <NodeId:MessageId[:Payload]> or a serial message, and
+/// copy it to my_msg
+bool RF24ClientClass::BuildMessage(String &strMsg, MyMessage &my_msg)
 {
-	bool sentOK = false;
 	bool bMsgReady = false;
 	uint8_t bytValue;
 	int iValue;
@@ -138,7 +149,7 @@ bool RF24ClientClass::ProcessSend(String &strMsg, MyMessage &my_msg)
 		// Serail format to MySensors message structure
 		bMsgReady = msgParser.parse(msg, strBuffer);
 		if (bMsgReady) {
-			SERIAL("Now sending message...");
+			XLOG_INF(XLOG_MOD_RF, "Now sending message");
 		}
 		break;
 
@@ -152,7 +163,7 @@ bool RF24ClientClass::ProcessSend(String &strMsg, MyMessage &my_msg)
 			msg.build(AUTO, BASESERVICE_ADDRESS, deviceType, C_INTERNAL, I_ID_REQUEST, false);
 			msg.set(GetNetworkID(true));		// identity: could be MAC, serial id, etc
 			bMsgReady = true;
-			SERIAL("Now sending request node id message...");
+			XLOG_INF(XLOG_MOD_RF, "Now sending request node id message");
 		}
 		break;
 
@@ -162,7 +173,7 @@ bool RF24ClientClass::ProcessSend(String &strMsg, MyMessage &my_msg)
 			msg.build(getAddress(), lv_nNodeID, remoteType, C_PRESENTATION, S_DIMMER, true);
 			msg.set(GetNetworkID(true));
 			bMsgReady = true;
-			SERIAL("Now sending remote present message...");
+			XLOG_INF(XLOG_MOD_RF, "Now sending remote present message");
 		}
 		break;
 
@@ -170,7 +181,7 @@ bool RF24ClientClass::ProcessSend(String &strMsg, MyMessage &my_msg)
 		msg.build(getAddress(), lv_nNodeID, 1, C_PRESENTATION, S_TEMP, false);
 		msg.set("");
 		bMsgReady = true;
-		SERIAL("Now sending DHT11 present message...");
+		XLOG_INF(XLOG_MOD_RF, "Now sending DHT11 present message");
 		break;
 
 	case 4:   // Temperature set to 23.5, req no ack
@@ -178,7 +189,7 @@ bool RF24ClientClass::ProcessSend(String &strMsg, MyMessage &my_msg)
 		fValue = 23.5;
 		msg.set(fValue, 2);
 		bMsgReady = true;
-		SERIAL("Now sending set temperature message...");
+		XLOG_INF(XLOG_MOD_RF, "Now sending set temperature message");
 		break;
 
 	case 5:   // Humidity set to 45, req no ack
@@ -186,13 +197,13 @@ bool RF24ClientClass::ProcessSend(String &strMsg, MyMessage &my_msg)
 		iValue = 45;
 		msg.set(iValue);
 		bMsgReady = true;
-		SERIAL("Now sending set humidity message...");
+		XLOG_INF(XLOG_MOD_RF, "Now sending set humidity message");
 		break;
 
 	case 6:   // Get main lamp(ID:1) power(V_STATUS:2) on/off, ack
 		msg.build(getAddress(), lv_nNodeID, 1, C_REQ, V_STATUS, true);
 		bMsgReady = true;
-		SERIAL("Now sending get V_STATUS message...");
+		XLOG_INF(XLOG_MOD_RF, "Now sending get V_STATUS message");
 		break;
 
 	case 7:   // Set main lamp(ID:1) power(V_STATUS:2) on/off, ack
@@ -200,13 +211,13 @@ bool RF24ClientClass::ProcessSend(String &strMsg, MyMessage &my_msg)
 		bytValue = (lv_sPayload == "1" ? 1 : 0);
 		msg.set(bytValue);
 		bMsgReady = true;
-		SERIAL("Now sending set V_STATUS %s message...", (bytValue ? "on" : "off"));
+		XLOG_INF(XLOG_MOD_RF, "Now sending set V_STATUS %s message", (bytValue ? "on" : "off"));
 		break;
 
 	case 8:   // Get main lamp(ID:1) dimmer (V_PERCENTAGE:3), ack
 		msg.build(getAddress(), lv_nNodeID, 1, C_REQ, V_PERCENTAGE, true);
 		bMsgReady = true;
-		SERIAL("Now sending get V_PERCENTAGE message...");
+		XLOG_INF(XLOG_MOD_RF, "Now sending get V_PERCENTAGE message");
 		break;
 
 	case 9:   // Set main lamp(ID:1) dimmer (V_PERCENTAGE:3), ack
@@ -214,13 +225,13 @@ bool RF24ClientClass::ProcessSend(String &strMsg, MyMessage &my_msg)
 		bytValue = constrain(atoi(lv_sPayload), 0, 100);
 		msg.set((uint8_t)OPERATOR_SET, bytValue);
 		bMsgReady = true;
-		SERIAL("Now sending set V_PERCENTAGE:%d message...", bytValue);
+		XLOG_INF(XLOG_MOD_RF, "Now sending set V_PERCENTAGE:%d message", bytValue);
 		break;
 
 	case 10:  // Get main lamp(ID:1) color temperature (V_LEVEL), ack
 		msg.build(getAddress(), lv_nNodeID, 1, C_REQ, V_LEVEL, true);
 		bMsgReady = true;
-		SERIAL("Now sending get CCT V_LEVEL message...");
+		XLOG_INF(XLOG_MOD_RF, "Now sending get CCT V_LEVEL message");
 		break;
 
 	case 11:  // Set main lamp(ID:1) color temperature (V_LEVEL), ack
@@ -228,14 +239,14 @@ bool RF24ClientClass::ProcessSend(String &strMsg, MyMessage &my_msg)
 		iValue = constrain(atoi(lv_sPayload), CT_MIN_VALUE, CT_MAX_VALUE);
 		msg.set((uint8_t)OPERATOR_SET, (unsigned int)iValue);
 		bMsgReady = true;
-		SERIAL("Now sending set CCT V_LEVEL %d message...", iValue);
+		XLOG_INF(XLOG_MOD_RF, "Now sending set CCT V_LEVEL %d message", iValue);
 		break;
 
 	case 12:  // Request lamp status in one
 		msg.build(getAddress(), lv_nNodeID, 1, C_REQ, V_RGBW, true);
 		msg.set((uint8_t)RING_ID_ALL);		// RING_ID_1 is also workable currently
 		bMsgReady = true;
-		SERIAL("Now sending get dev-status (V_RGBW) message...");
+		XLOG_INF(XLOG_MOD_RF, "Now sending get dev-status (V_RGBW) message");
 		break;
 
 	case 13:  // Set main lamp(ID:1) status in one, ack
@@ -255,15 +266,21 @@ bool RF24ClientClass::ProcessSend(String &strMsg, MyMessage &my_msg)
 	  payload[3] = iValue / 256;
 		msg.set((void*)payload, 4);
 		bMsgReady = true;
-		SERIAL("Now sending set CCT V_RGBW (br=%d, cct=%d message...", bytValue, iValue);
+		XLOG_INF(XLOG_MOD_RF, "Now sending set CCT V_RGBW (br=%d, cct=%d message", bytValue, iValue);
 		break;
 	}
 
-	if (bMsgReady) {
-		SERIAL("to %d...", msg.getDestination());
+	if (bMsgReady) my_msg = msg;
+	return bMsgReady;
+}
+
+bool RF24ClientClass::ProcessSend(String &strMsg, MyMessage &my_msg)
+{
+	bool sentOK = false;
+	if (BuildMessage(strMsg, my_msg)) {
 		sentOK = ProcessSend();
 		my_msg = msg;
-		SERIAL_LN(sentOK ? "OK" : "failed");
+		XLOG_INF(XLOG_MOD_RF, "Message to %d %s", msg.getDestination(), (sentOK ? "queued" : "failed"));
 	}
 
 	return sentOK;
@@ -275,7 +292,7 @@ bool RF24ClientClass::ProcessSend(String &strMsg)
 	return ProcessSend(strMsg, tempMsg);
 }
 
-// ToDo: add message to queue instead of sending out directly
+// Queue the message for the RF worker, false if the queue is full
 bool RF24ClientClass::ProcessSend(MyMessage *pMsg)
 {
 	if( !pMsg ) { pMsg = &msg; }
@@ -289,40 +306,80 @@ bool RF24ClientClass::ProcessSend(MyMessage *pMsg)
 	} else { // Send to destination directly
 		replyTo = pMsg->getDestination();
 	}
-	if( send(replyTo, *pMsg) )
-	{
-		_succ++;
-		return true;
+	UC flags = (theOffline.IsReplaying() ? RFW_FLAG_REPLAY : 0);
+	if( theRFWorker.Post(*pMsg, replyTo, 255, flags) ) return true;
+
+	// No room, same as a failed send
+	theNodeList.NodeSent(replyTo, false);
+	// Keep the command for later, unless it is already a replay
+	if( !flags && theOffline.Append(*pMsg) ) {
+		XLOG_WRN(XLOG_MOD_RF, "Send failed, command cached (%d pending)", theOffline.GetCount());
 	}
-
 	return false;
 }
 
+// Outcome of a send from the RF worker
+void RF24ClientClass::SendCompleted(const RFFrame_t &frame)
+{
+	BOOL sentOK = (frame.type == RFW_SENT_OK);
+	theProfiler.Record(PERF_RF_SEND, frame.rttUs);
+	if( frame.flags & RFW_FLAG_BENCH ) {
+		theRFBench.SendDone(frame);
+		return;
+	}
+	theStat.Sent(sentOK, frame.rttUs);
+	if( sentOK ) _succ++;
+	if( frame.flags & RFW_FLAG_REPLY ) return;
+
+	theNodeList.NodeSent(frame.to, sentOK);
+	if( sentOK ) theOffline.LinkUp();
+	if( frame.flags & RFW_FLAG_REPLAY ) {
+		theOffline.ReplayDone(sentOK);
+		return;
+	}
+
+	if( !sentOK ) {
+		MyMessage lv_msg;
+		memset(&lv_msg.msg, 0x00, sizeof(lv_msg.msg));
+		memcpy(&lv_msg.msg, frame.data, frame.len);
+		if( theOffline.Append(lv_msg) ) {
+			XLOG_WRN(XLOG_MOD_RF, "Send failed, command cached (%d pending)", theOffline.GetCount());
+		}
+	}
+}
+
+// Handle what the RF worker has posted: send outcomes and received frames
 bool RF24ClientClass::ProcessReceive()
 {
-	if( !isValid() ) return false;
+	if( !theRFWorker.IsRunning() ) theRFWorker.Poll();
+
+	bool gotEvent = false;
+	RFFrame_t frame;
+	while( theRFWorker.GetEvent(frame) ) {
+		gotEvent = true;
+		if( frame.type == RFW_RECEIVED ) {
+			memset(msgData, 0x00, sizeof(msg.msg));
+			memcpy(msgData, frame.data, frame.len);
+			HandleReceived(frame.to, frame.pipe, frame.len);
+		} else {
+			SendCompleted(frame);
+		}
+	}
+	return gotEvent;
+}
 
+// The frame is in msg
+void RF24ClientClass::HandleReceived(uint8_t to, uint8_t pipe, uint8_t len)
+{
 	bool msgReady = false;
-  bool sentOK = false;
-  uint8_t to = theRadio.getAddress();
-  uint8_t pipe;
 	UC replyTo;
-  if (!available(&to, &pipe))
-    return false;
 
-  uint8_t len = receive(msgData);
-  if( len < HEADER_SIZE )
-  {
-    SERIAL_LN("got corrupt dynamic payload!");
-    return false;
-  } else if( len > MAX_MESSAGE_LENGTH )
-  {
-    SERIAL_LN("message length exceeded: %d", len);
-    return false;
-  }
+  // Acks to the flood test stay out of everything else
+  if( theRFBench.AckReceived(msg) ) return;
 
   char strDisplay[SENSORDATA_JSON_SIZE];
   _received++;
+  theStat.Received();
 	uint8_t _cmd = msg.getCommand();
 	uint8_t _type = msg.getType();
   uint8_t _sender = msg.getSender();  // The original sender
@@ -331,8 +388,10 @@ bool RF24ClientClass::ProcessReceive()
   bool _needAck = msg.isReqAck();
   bool _isAck = msg.isAck();
 	uint8_t *payload = (uint8_t *)msg.getCustom();
-  SERIAL_LN("Received from pipe %d msg-len=%d, from:%d to:%d dest:%d cmd:%d type:%d sensor:%d payl-len:%d",
+  XLOG_INF(XLOG_MOD_RF, "Received from pipe %d msg-len=%d, from:%d to:%d dest:%d cmd:%d type:%d sensor:%d payl-len:%d",
         pipe, len, _sender, to, _destination, _cmd, _type, _sensor, msg.getLength());
+  theNodeList.NodeSeen(_sender);
+  theOffline.LinkUp();
 
   switch( _cmd )
   {
@@ -345,9 +404,15 @@ bool RF24ClientClass::ProcessReceive()
         } else {
 					uint64_t lv_networkID = msg.getUInt64();
           SERIAL_LN("Get NodeId: %d, networkId: %s", lv_nodeID, PrintUint64(strDisplay, lv_networkID));
-          setAddress(lv_nodeID, lv_networkID);
+          {
+            // Dropped if the radio can't be had, the ID stays unset until the next register
+            RFWorkerLock lock;
+            if( !lock.IsParked() ) break;
+            setAddress(lv_nodeID, lv_networkID);
+          }
 					theConfig.SetNodeID(lv_nodeID);
 					theConfig.SetNetworkID(lv_networkID);
+					theNodeList.SetIdentity(NODEID_GATEWAY, lv_networkID);
 					theSys.SendDevicePresentation();
         }
       }
@@ -368,25 +433,26 @@ bool RF24ClientClass::ProcessReceive()
 
 		case C_REQ:
 			if( _isAck && _type == V_RGBW ) {
-				SERIAL_LN("Ack msg from %d - V_RGBW", _sender);
+				XLOG_INF(XLOG_MOD_RF, "Ack msg from %d - V_RGBW", _sender);
 				if( payload[0] ) {	// Succeed or not
 					UC _devType = payload[1];	// payload[2] is present status
 					UC _ringID = payload[3];
-					theConfig.SetDevType(_devType);
-					theConfig.SetDevPresent(payload[2]);
-					theConfig.SetDevStatus(payload[4]);
-					theConfig.SetDevBrightness(payload[5]);
+					theConfig.SetDevType(_devType, _sender);
+					theNodeList.SetDevType(_sender, _devType);
+					theConfig.SetDevPresent(payload[2], _sender);
+					theConfig.SetDevStatus(payload[4], _sender, _ringID);
+					theConfig.SetDevBrightness(payload[5], _sender, _ringID);
 					if( IS_SUNNY(_devType) ) {
 						// Sunny
 						US _CCTValue = payload[7] * 256 + payload[6];
-						theConfig.SetDevCCT(_CCTValue);
+						theConfig.SetDevCCT(_CCTValue, _sender, _ringID);
 					} else if( IS_RAINBOW(_devType) || IS_MIRAGE(_devType) ) {
 						// Rainbow or Mirage
 						// ToDo: set RWB
 					}
 				} else {
-					theConfig.SetDevPresent(false);
-					theConfig.SetDevStatus(false);
+					theConfig.SetDevPresent(false, _sender);
+					theConfig.SetDevStatus(false, _sender);
 				}
 			}  // Note: no break
 		case C_SET:
@@ -394,22 +460,26 @@ bool RF24ClientClass::ProcessReceive()
 				UC _OnOff, _Brightness;
 		    if( _type == V_STATUS ) {
 					_OnOff = msg.getByte();
-					SERIAL_LN("Ack msg from %d - lights %s", _sender, _OnOff ? "on" : "off");
-					theConfig.SetDevPresent(true);
-					theConfig.SetDevStatus(_OnOff);
+					XLOG_INF(XLOG_MOD_RF, "Ack msg from %d - lights %s", _sender, _OnOff ? "on" : "off");
+					theConfig.SetDevPresent(true, _sender);
+					theConfig.SetDevStatus(_OnOff, _sender);
 				} else if( _type == V_PERCENTAGE ) {
 					_OnOff = payload[0];
 					_Brightness = payload[1];
-					SERIAL_LN("Ack msg from %d - lights %s brightness %d", _sender, (_OnOff ? "on" : "off"), _Brightness);
-					theConfig.SetDevPresent(true);
-					theConfig.SetDevStatus(_OnOff);
-					theConfig.SetDevBrightness(_Brightness);
+					XLOG_INF(XLOG_MOD_RF, "Ack msg from %d - lights %s brightness %d", _sender, (_OnOff ? "on" : "off"), _Brightness);
+					theConfig.SetDevPresent(true, _sender);
+					theConfig.SetDevStatus(_OnOff, _sender);
+					theConfig.SetDevBrightness(_Brightness, _sender);
 				} else if( _type == V_LEVEL ) {
 					US _CCTValue = (US)msg.getUInt();
-					SERIAL_LN("Ack msg from %d - CCT level %d", _sender, _CCTValue);
-					theConfig.SetDevPresent(true);
-					theConfig.SetDevCCT(_CCTValue);
+					XLOG_INF(XLOG_MOD_RF, "Ack msg from %d - CCT level %d", _sender, _CCTValue);
+					theConfig.SetDevPresent(true, _sender);
+					theConfig.SetDevCCT(_CCTValue, _sender);
 				}
+			} else if( _cmd == C_SET ) {
+				// Sensor report, feeds the rules. Not a C_REQ falling through, its payload isn't a reading
+				SHORT _sensorID = RuleEngineClass::SensorFromType(_type);
+				if( _sensorID >= 0 ) theRules.SetInput(_sensorID, (SHORT)msg.getInt());
 			}
 			break;
 
@@ -426,9 +496,6 @@ bool RF24ClientClass::ProcessReceive()
 		} else { // Send to destination directly
 			replyTo = msg.getDestination();
 		}
-		sentOK = send(replyTo, msg, pipe);
-		if( sentOK ) _succ++;
+		theRFWorker.Post(msg, replyTo, pipe, RFW_FLAG_REPLY);
 	}
-
-  return true;
 }
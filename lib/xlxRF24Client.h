@@ -4,6 +4,7 @@
 #define xlxRF24Client_h
 
 #include "MyTransportNRF24.h"
+#include "xlxRFWorker.h"
 
 // RF24 Server class
 class RF24ClientClass : public MyTransportNRF24
@@ -14,11 +15,17 @@ public:
   bool ClientBegin(const uint8_t bNodeID = AUTO);
   uint64_t GetNetworkID(bool _full = false);
   bool ChangeNodeID(const uint8_t bNodeID);
+  bool BuildMessage(String &strMsg, MyMessage &my_msg);
   bool ProcessSend(String &strMsg, MyMessage &my_msg);
   bool ProcessSend(String &strMsg); //overloaded
   bool ProcessSend(MyMessage *pMsg = NULL);
   bool ProcessReceive();
 
+private:
+  void SendCompleted(const RFFrame_t &frame);
+  void HandleReceived(uint8_t to, uint8_t pipe, uint8_t len);
+
+public:
   unsigned long _times;
   unsigned long _succ;
   unsigned long _received;
@@ -0,0 +1,319 @@
+/**
+ * xlxRFBench.cpp - Xlight RF flood test, load generator and throughput report
+ *
+ * Created by Baoshi Sun <bs.sun@datatellit.com>
+ * Copyright (C) 2015-2016 DTIT
+ * Full contributor list:
+ *
+ * Documentation:
+ * Support Forum:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * REVISION HISTORY
+ * Version 1.0 - Created by Baoshi Sun <bs.sun@datatellit.com>
+ *
+ * DESCRIPTION
+ * 1. 'test flood' sends a number of copies of one message to a set of
+ *    nodes, at a given rate, and reports the rate achieved, how many got
+ *    through, after how many retries, and the round trip percentiles
+ * 2. Ack modes: radio counts a send the radio got an auto-ack for, app
+ *    waits for the node's own ack message
+ * 3. A failed attempt, or an ack not in RFB_ACK_TIMEOUT, is retried up to
+ *    the number of retries asked for
+ * 4. Runs from the rf task, the console stays usable meanwhile
+ * 5. With loopback the RF worker stands in for the radio and the nodes
+ *    (RFWorkerClass::SetLoopback), optionally failing some sends
+ *
+ * ToDo:
+ * 1. The radio's own retransmissions (ARC) aren't exposed by the RF24
+ *    library, so the retry counts are the test's only
+ *
+**/
+
+#include "xlxRFBench.h"
+#include "xlxRF24Client.h"
+
+//------------------------------------------------------------------
+// the one and only instance of RFBenchClass
+RFBenchClass theRFBench;
+
+//------------------------------------------------------------------
+// Xlight RF Bench Class
+//------------------------------------------------------------------
+RFBenchClass::RFBenchClass()
+{
+  m_running = false;
+  m_loopback = false;
+  m_ackMode = RFB_ACK_RADIO;
+  m_maxRetries = 0;
+  m_count = 0;
+  m_rate = 0;
+  m_destCount = 0;
+  m_nextDest = 0;
+  m_started = 0;
+  m_done = 0;
+  m_succ = 0;
+  m_attempts = 0;
+  m_timeouts = 0;
+  m_lateAcks = 0;
+  m_queueFull = 0;
+  memset(m_retryHist, 0x00, sizeof(m_retryHist));
+  ProfilerClass::Reset(m_rtt);
+  m_startUs = 0;
+  m_startMs = 0;
+  m_endMs = 0;
+  m_lastReport = 0;
+}
+
+// "1,2,5" or "1-4", or a mix
+BOOL RFBenchClass::ParseDests(const char *sDests)
+{
+  m_destCount = 0;
+  const char *p = sDests;
+  while( *p ) {
+    int from = atoi(p);
+    while( *p >= '0' && *p <= '9' ) p++;
+    int to = from;
+    if( *p == '-' ) {
+      to = atoi(++p);
+      while( *p >= '0' && *p <= '9' ) p++;
+    }
+    if( *p == ',' ) p++;
+    else if( *p ) return false;
+
+    for( int node = from; node <= to; node++ ) {
+      if( node <= 0 || node >= BROADCAST_ADDRESS || node == theRadio.getAddress() ) return false;
+      BOOL dup = false;
+      for( UC i = 0; i < m_destCount; i++ ) {
+        if( m_dests[i].node == node ) dup = true;
+      }
+      if( dup ) continue;
+      if( m_destCount >= RFB_MAX_DESTS ) return false;
+      memset(&m_dests[m_destCount], 0x00, sizeof(RFBenchDest_t));
+      m_dests[m_destCount++].node = node;
+    }
+  }
+  return (m_destCount > 0);
+}
+
+BOOL RFBenchClass::Start(UL count, UL rate, const char *sDests, UC ackMode, UC retries, const char *sTemplate,
+    BOOL loopback, UC lossPct)
+{
+  if( m_running ) {
+    SERIAL_LN("Flood test already running, 'test flood stop' first");
+    return false;
+  }
+  if( !ParseDests(sDests) ) {
+    SERIAL_LN("Bad destinations '%s', up to %d nodes e.g. 1,2 or 1-4", sDests, RFB_MAX_DESTS);
+    return false;
+  }
+
+  // Build the template for the first node, with the same parser as 'send'
+  int msgID = atoi(sTemplate);
+  if( msgID < 2 ) {
+    SERIAL_LN("Message id %d can't be flooded, use <MessageId[:Payload]> from 2 up", msgID);
+    return false;
+  }
+  char strBuf[32];
+  snprintf(strBuf, sizeof(strBuf), "%d:%s", m_dests[0].node, sTemplate);
+  String strMsg = strBuf;
+  if( !theRadio.BuildMessage(strMsg, m_msg) ) {
+    SERIAL_LN("Bad message template '%s'", sTemplate);
+    return false;
+  }
+
+  m_count = count;
+  m_rate = rate;
+  m_ackMode = ackMode;
+  m_maxRetries = (retries > RFB_MAX_RETRIES ? RFB_MAX_RETRIES : retries);
+  m_nextDest = 0;
+  m_started = 0;
+  m_done = 0;
+  m_succ = 0;
+  m_attempts = 0;
+  m_timeouts = 0;
+  m_lateAcks = 0;
+  m_queueFull = 0;
+  memset(m_retryHist, 0x00, sizeof(m_retryHist));
+  ProfilerClass::Reset(m_rtt);
+
+  m_loopback = loopback;
+  theRFWorker.SetLoopback(loopback, lossPct);
+  m_startUs = micros();
+  m_startMs = millis();
+  m_endMs = 0;
+  m_lastReport = m_startMs;
+  m_running = true;
+  print();
+  return true;
+}
+
+void RFBenchClass::Stop()
+{
+  if( !m_running ) return;
+  SERIAL_LN("Flood test stopped");
+  Finish();
+}
+
+void RFBenchClass::Finish()
+{
+  m_running = false;
+  m_endMs = millis();
+  theRFWorker.SetLoopback(false);
+  print();
+}
+
+// A new message may go out
+BOOL RFBenchClass::IsDue()
+{
+  if( !m_running || m_started >= m_count ) return false;
+  if( m_rate == 0 ) return true;
+  UL due = m_startUs + (UL)((uint64_t)m_started * 1000000 / m_rate);
+  return ((LONG)(micros() - due) >= 0);
+}
+
+BOOL RFBenchClass::Post(RFBenchDest_t &dest)
+{
+  m_msg.build(theRadio.getAddress(), dest.node, m_msg.getSensor(), m_msg.getCommand(), m_msg.getType(),
+      (m_ackMode == RFB_ACK_APP), false, true);
+  if( !theRFWorker.Post(m_msg, dest.node, 255, RFW_FLAG_BENCH) ) {
+    m_queueFull++;
+    return false;
+  }
+  if( dest.attempts == 0 ) dest.firstUs = micros();
+  dest.attempts++;
+  dest.postMs = millis();
+  dest.state = RFB_DEST_SENDING;
+  m_attempts++;
+  return true;
+}
+
+void RFBenchClass::AttemptDone(RFBenchDest_t &dest, BOOL ok)
+{
+  if( ok ) {
+    m_succ++;
+    m_retryHist[dest.attempts - 1]++;
+    ProfilerClass::Record(m_rtt, micros() - dest.firstUs);
+  } else if( dest.attempts <= m_maxRetries ) {
+    dest.state = RFB_DEST_RETRY;
+    return;
+  }
+  m_done++;
+  dest.attempts = 0;
+  dest.state = RFB_DEST_IDLE;
+}
+
+RFBenchDest_t *RFBenchClass::FindDest(UC node, UC state)
+{
+  for( UC i = 0; i < m_destCount; i++ ) {
+    if( m_dests[i].node == node && m_dests[i].state == state ) return &m_dests[i];
+  }
+  return NULL;
+}
+
+void RFBenchClass::Tick()
+{
+  if( !m_running ) return;
+
+  // Acks overdue, and retries first
+  UL now = millis();
+  for( UC i = 0; i < m_destCount; i++ ) {
+    RFBenchDest_t &dest = m_dests[i];
+    if( dest.state == RFB_DEST_WAIT_ACK && now - dest.postMs > RFB_ACK_TIMEOUT ) {
+      m_timeouts++;
+      AttemptDone(dest, false);
+    }
+    if( dest.state == RFB_DEST_RETRY ) Post(dest);
+  }
+
+  // New messages when due, to the next idle node
+  while( IsDue() ) {
+    UC i;
+    for( i = 0; i < m_destCount; i++ ) {
+      if( m_dests[(m_nextDest + i) % m_destCount].state == RFB_DEST_IDLE ) break;
+    }
+    if( i >= m_destCount ) break;
+    RFBenchDest_t &dest = m_dests[(m_nextDest + i) % m_destCount];
+    if( !Post(dest) ) break;
+    m_nextDest = (m_nextDest + i + 1) % m_destCount;
+    m_started++;
+  }
+
+  if( m_done >= m_count ) {
+    Finish();
+  } else if( now - m_lastReport >= RFB_REPORT_INTERVAL ) {
+    m_lastReport = now;
+    SERIAL_LN("Flood: %lu of %lu done, %lu ok", m_done, m_count, m_succ);
+  }
+}
+
+void RFBenchClass::SendDone(const RFFrame_t &frame)
+{
+  // Outcomes for a test that was stopped are dropped here
+  if( !m_running ) return;
+  RFBenchDest_t *dest = FindDest(frame.to, RFB_DEST_SENDING);
+  if( !dest ) return;
+
+  BOOL sentOK = (frame.type == RFW_SENT_OK);
+  if( sentOK && m_ackMode == RFB_ACK_APP ) {
+    dest->state = RFB_DEST_WAIT_ACK;
+    return;
+  }
+  AttemptDone(*dest, sentOK);
+}
+
+// True if the ack belongs to the test, so nothing else acts on it
+BOOL RFBenchClass::AckReceived(MyMessage &ack)
+{
+  if( !m_running || m_ackMode != RFB_ACK_APP || !ack.isAck() ) return false;
+
+  UC sender = ack.getSender();
+  RFBenchDest_t *dest = FindDest(sender, RFB_DEST_WAIT_ACK);
+  if( dest ) {
+    AttemptDone(*dest, true);
+    return true;
+  }
+  // Late, or came before the send outcome was taken in
+  for( UC i = 0; i < m_destCount; i++ ) {
+    if( m_dests[i].node == sender ) {
+      m_lateAcks++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void RFBenchClass::print()
+{
+  char strDests[RFB_MAX_DESTS * 4 + 1] = "";
+  for( UC i = 0; i < m_destCount; i++ ) {
+    sprintf(strDests + strlen(strDests), "%s%d", (i ? "," : ""), m_dests[i].node);
+  }
+  SERIAL_LN("** RF Flood: %s, %lu to %s at %lu/s, ack %s, %d retries%s **",
+      (m_running ? "running" : (m_endMs ? "done" : "not run")), m_count, strDests, m_rate,
+      (m_ackMode == RFB_ACK_APP ? "app" : "radio"), m_maxRetries, (m_loopback ? ", loopback" : ""));
+  if( !m_attempts ) {
+    SERIAL_LN("");
+    return;
+  }
+
+  UL elapsed = (m_running ? millis() : m_endMs) - m_startMs;
+  UL rate10 = (elapsed ? (UL)((uint64_t)m_done * 10000 / elapsed) : 0);
+  UL ok10 = (m_done ? (UL)((uint64_t)m_succ * 1000 / m_done) : 0);
+  SERIAL_LN("  %lu done in %lu ms: %lu.%lu msg/s, %lu ok (%lu.%lu%%), %lu failed, %lu attempts",
+      m_done, elapsed, rate10 / 10, rate10 % 10, m_succ, ok10 / 10, ok10 % 10, m_done - m_succ, m_attempts);
+  SERIAL("  retries:");
+  for( UC i = 0; i <= m_maxRetries; i++ ) SERIAL(" %d:%lu", i, m_retryHist[i]);
+  SERIAL_LN("  timeouts:%lu late acks:%lu queue full:%lu", m_timeouts, m_lateAcks, m_queueFull);
+  if( m_rtt.count ) {
+    SERIAL_LN("  rtt us: min %lu, p50 %lu, p90 %lu, p99 %lu, max %lu", m_rtt.min,
+        ProfilerClass::Percentile(m_rtt, 50), ProfilerClass::Percentile(m_rtt, 90),
+        ProfilerClass::Percentile(m_rtt, 99), m_rtt.max);
+  }
+  SERIAL_LN("");
+}
@@ -0,0 +1,105 @@
+//  xlxRFBench.h - Xlight RF flood test, load generator and throughput report
+
+#ifndef xlxRFBench_h
+#define xlxRFBench_h
+
+#include "xliCommon.h"
+#include "xlxProfiler.h"
+#include "xlxRFWorker.h"
+
+#define RFB_MAX_DESTS             8
+#define RFB_MAX_RETRIES           7
+#define RFB_ACK_TIMEOUT           500         // ms to wait for the node's ack
+#define RFB_REPORT_INTERVAL       5000        // ms between progress lines
+#define RFB_DEFAULT_TEMPLATE      "7:1"       // <MessageId:Payload>, set V_STATUS on
+
+// Ack modes
+#define RFB_ACK_RADIO             0           // the radio's auto-ack, i.e. the send outcome
+#define RFB_ACK_APP               1           // the node's ack message
+
+// Destination states
+#define RFB_DEST_IDLE             0
+#define RFB_DEST_SENDING          1           // posted, waiting for the send outcome
+#define RFB_DEST_WAIT_ACK         2           // sent, waiting for the node's ack
+#define RFB_DEST_RETRY            3           // failed, to be sent again
+
+//------------------------------------------------------------------
+// RF Bench Structures
+//------------------------------------------------------------------
+typedef struct
+{
+  UC node;
+  UC state;                                 // RFB_DEST_*
+  UC attempts;                              // for the message in flight
+  UL firstUs;                               // micros() of its first attempt
+  UL postMs;                                // millis() of the last attempt
+} RFBenchDest_t;
+
+//------------------------------------------------------------------
+// RF Bench Class
+//------------------------------------------------------------------
+// Start() sets the test up and Tick(), from the rf task, keeps it going:
+// new messages go out at the rate asked for, round robin over the
+// destinations, one in flight per destination. The outcomes come back
+// through RF24ClientClass, which hands the test's frames and acks here
+// instead of to the offline cache and the node list.
+/// RTT is from the first attempt to success, so it includes the retries.
+class RFBenchClass
+{
+private:
+  BOOL m_running;
+  BOOL m_loopback;
+  MyMessage m_msg;                          // template, the header is set per send
+  UC m_ackMode;
+  UC m_maxRetries;
+  UL m_count;                               // messages to send
+  UL m_rate;                                // per second, 0 for as fast as they go
+  RFBenchDest_t m_dests[RFB_MAX_DESTS];
+  UC m_destCount;
+  UC m_nextDest;                            // round robin
+
+  // Results
+  UL m_started;
+  UL m_done;
+  UL m_succ;
+  UL m_attempts;
+  UL m_timeouts;                            // acks not in time
+  UL m_lateAcks;                            // acks after the timeout
+  UL m_queueFull;                           // posts refused by the RF worker
+  UL m_retryHist[RFB_MAX_RETRIES + 1];      // successes by retries needed
+  PerfProbe_t m_rtt;
+  UL m_startUs;
+  UL m_startMs;
+  UL m_endMs;
+  UL m_lastReport;
+
+  BOOL ParseDests(const char *sDests);
+  BOOL Post(RFBenchDest_t &dest);
+  void AttemptDone(RFBenchDest_t &dest, BOOL ok);
+  RFBenchDest_t *FindDest(UC node, UC state);
+  void Finish();
+
+public:
+  RFBenchClass();
+
+  // sTemplate is <MessageId[:Payload]> as in 'send', sDests like "1,2" or "1-4"
+  BOOL Start(UL count, UL rate, const char *sDests, UC ackMode, UC retries, const char *sTemplate,
+      BOOL loopback, UC lossPct);
+  void Stop();
+  BOOL IsRunning() { return m_running; }
+  BOOL IsDue();
+  void Tick();
+
+  // From RF24ClientClass
+  void SendDone(const RFFrame_t &frame);
+  BOOL AckReceived(MyMessage &ack);
+
+  void print();
+};
+
+//------------------------------------------------------------------
+// Function & Class Helper
+//------------------------------------------------------------------
+extern RFBenchClass theRFBench;
+
+#endif /* xlxRFBench_h */
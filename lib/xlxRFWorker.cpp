@@ -0,0 +1,298 @@
+/**
+ * xlxRFWorker.cpp - Xlight RF worker thread, owns the radio
+ *
+ * Created by Baoshi Sun <bs.sun@datatellit.com>
+ * Copyright (C) 2015-2016 DTIT
+ * Full contributor list:
+ *
+ * Documentation:
+ * Support Forum:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * REVISION HISTORY
+ * Version 1.0 - Created by Baoshi Sun <bs.sun@datatellit.com>
+ *
+ * DESCRIPTION
+ * 1. A thread one priority above the application thread sends the queued
+ *    frames and reads incoming ones, sleeping 1 ms when there is neither
+ * 2. Two SPSC queues connect it to the main loop: frames to send, and send
+ *    outcomes plus received frames back. No locks, no SPI outside the thread
+ * 3. Radio setup from the main thread (node ID, PA level, network switch)
+ *    asks the worker to park first, and waits for it to say so
+ * 4. Without the thread, e.g. if it can't be created, the main loop's rf
+ *    task calls Poll() itself and nothing else changes
+ * 5. 'test rfq <n>' pushes n numbers from the worker thread to the main
+ *    thread through a queue and checks none is lost or out of order
+ * 6. Loopback mode stands in for the radio and the nodes, for the RF flood
+ *    test on a remote without a lamp around
+ *
+ * ToDo:
+ * 1. Wait on the RF24 IRQ pin instead of the 1 ms sleep
+ *
+**/
+
+#include "xlxRFWorker.h"
+#include "xlxRF24Client.h"
+
+//------------------------------------------------------------------
+// the one and only instance of RFWorkerClass
+RFWorkerClass theRFWorker;
+
+//------------------------------------------------------------------
+// Xlight RF Worker Class
+//------------------------------------------------------------------
+RFWorkerClass::RFWorkerClass()
+{
+  m_running = false;
+  m_pauseDepth = 0;
+  m_parked = true;
+  m_pauseSeq = 0;
+  m_pauseReq = 0;
+  m_pauseAck = 0;
+  m_polls = 0;
+  m_sent = 0;
+  m_received = 0;
+  m_corrupt = 0;
+  m_loopback = false;
+  m_loopLoss = 0;
+  m_loopAcks = 0;
+  m_testLeft = 0;
+  m_testNext = 0;
+  m_testStop = true;
+}
+
+void RFWorkerClass::ThreadMain(void *param)
+{
+  RFWorkerClass *worker = (RFWorkerClass *)param;
+  while( true ) {
+    if( !worker->Poll() ) delay(RFW_IDLE_MS);
+  }
+}
+
+BOOL RFWorkerClass::Begin()
+{
+  if( m_running ) return true;
+
+  Thread *thread = new Thread("rf", ThreadMain, this, OS_THREAD_PRIORITY_DEFAULT + 1, RFW_STACK_SIZE);
+  m_running = (thread && thread->isValid());
+  if( !m_running ) SERIAL_LN("RF worker thread not started, polling from the main loop");
+  return m_running;
+}
+
+BOOL RFWorkerClass::Poll()
+{
+  // Parked while the main thread has the radio
+  UL req = __atomic_load_n(&m_pauseReq, __ATOMIC_ACQUIRE);
+  if( req ) {
+    __atomic_store_n(&m_pauseAck, req, __ATOMIC_RELEASE);
+    return false;
+  }
+  m_polls++;
+  if( !__atomic_load_n(&m_testStop, __ATOMIC_ACQUIRE) && __atomic_load_n(&m_testLeft, __ATOMIC_ACQUIRE) ) {
+    return PollTest();
+  }
+
+  BOOL busy = false;
+  RFFrame_t frame;
+
+  // Sends, as long as there is room for the outcome, and the ack in loopback
+  BOOL loopback = __atomic_load_n(&m_loopback, __ATOMIC_ACQUIRE);
+  while( m_rxQueue.GetCount() + (loopback ? 1 : 0) < m_rxQueue.GetCapacity() && m_txQueue.Pop(frame) ) {
+    UL sendStart = micros();
+    BOOL sentOK;
+    if( loopback ) {
+      sentOK = (random(100) >= m_loopLoss);
+    } else {
+      sentOK = (theRadio.isValid() && theRadio.send(frame.to, frame.data, frame.len, frame.pipe));
+    }
+    frame.rttUs = micros() - sendStart;
+    frame.type = (sentOK ? RFW_SENT_OK : RFW_SENT_FAIL);
+    m_rxQueue.Push(frame);
+    if( sentOK && loopback ) LoopbackAck(frame);
+    m_sent++;
+    busy = true;
+  }
+
+  // Then whatever came in, the radio holds 3 more frames if we're full
+  while( !loopback && m_rxQueue.GetCount() < m_rxQueue.GetCapacity() && theRadio.isValid() ) {
+    UC to = theRadio.getAddress();
+    UC pipe;
+    if( !theRadio.available(&to, &pipe) ) break;
+
+    busy = true;
+    memset(frame.data, 0x00, sizeof(frame.data));
+    frame.len = theRadio.receive(frame.data);
+    if( frame.len < HEADER_SIZE || frame.len > MAX_MESSAGE_LENGTH ) {
+      m_corrupt++;
+      continue;
+    }
+    frame.type = RFW_RECEIVED;
+    frame.flags = 0;
+    frame.to = to;
+    frame.pipe = pipe;
+    frame.rttUs = 0;
+    m_rxQueue.Push(frame);
+    m_received++;
+  }
+
+  return busy;
+}
+
+BOOL RFWorkerClass::Post(MyMessage &msg, UC to, UC pipe, UC flags)
+{
+  // Same framing as MyTransportNRF24::send()
+  msg.setVersion(PROTOCOL_VERSION);
+  msg.setLast(theRadio.getAddress());
+  UC length = (msg.getSigned() ? MAX_MESSAGE_LENGTH : msg.getLength());
+
+  RFFrame_t frame;
+  frame.type = RFW_SEND;
+  frame.flags = flags;
+  frame.to = to;
+  frame.pipe = pipe;
+  frame.len = min(MAX_MESSAGE_LENGTH, HEADER_SIZE + length);
+  frame.rttUs = 0;
+  memcpy(frame.data, &msg.msg, frame.len);
+  return m_txQueue.Push(frame);
+}
+
+// The node's ack to a frame that asked for one, as if it came over the air
+void RFWorkerClass::LoopbackAck(const RFFrame_t &frame)
+{
+  MyMessage lv_msg;
+  memset(&lv_msg.msg, 0x00, sizeof(lv_msg.msg));
+  memcpy(&lv_msg.msg, frame.data, frame.len);
+  if( !lv_msg.isReqAck() || frame.to == BROADCAST_ADDRESS ) return;
+
+  lv_msg.build(lv_msg.getDestination(), lv_msg.getSender(), lv_msg.getSensor(), lv_msg.getCommand(),
+      lv_msg.getType(), false, true, true);
+  lv_msg.setLast(frame.to);
+  RFFrame_t ack;
+  ack.type = RFW_RECEIVED;
+  ack.flags = 0;
+  ack.to = lv_msg.getDestination();
+  ack.pipe = 0;
+  ack.len = frame.len;
+  ack.rttUs = 0;
+  memcpy(ack.data, &lv_msg.msg, ack.len);
+  if( m_rxQueue.Push(ack) ) m_loopAcks++;
+}
+
+void RFWorkerClass::SetLoopback(BOOL on, UC lossPct)
+{
+  m_loopLoss = lossPct;
+  __atomic_store_n(&m_loopback, on, __ATOMIC_RELEASE);
+}
+
+BOOL RFWorkerClass::Pause()
+{
+  if( m_pauseDepth++ > 0 ) return m_parked;
+  m_parked = true;
+  if( !m_running ) return true;
+
+  // A fresh sequence, so an old acknowledgement is never taken for this one
+  UL seq = ++m_pauseSeq;
+  if( !seq ) seq = ++m_pauseSeq;
+  __atomic_store_n(&m_pauseReq, seq, __ATOMIC_RELEASE);
+  UL start = millis();
+  while( __atomic_load_n(&m_pauseAck, __ATOMIC_ACQUIRE) != seq ) {
+    if( millis() - start > RFW_PAUSE_TIMEOUT ) {
+      SERIAL_LN("RF worker did not park in %d ms", RFW_PAUSE_TIMEOUT);
+      m_parked = false;
+      break;
+    }
+    delay(1);
+  }
+  return m_parked;
+}
+
+void RFWorkerClass::Resume()
+{
+  if( m_pauseDepth == 0 ) return;
+  if( --m_pauseDepth == 0 ) __atomic_store_n(&m_pauseReq, 0, __ATOMIC_RELEASE);
+}
+
+// Worker side of the self test
+BOOL RFWorkerClass::PollTest()
+{
+  BOOL busy = false;
+  while( !__atomic_load_n(&m_testStop, __ATOMIC_ACQUIRE) && __atomic_load_n(&m_testLeft, __ATOMIC_ACQUIRE)
+      && m_testQueue.Push(m_testNext) ) {
+    m_testNext++;
+    __atomic_fetch_sub(&m_testLeft, 1, __ATOMIC_ACQ_REL);
+    busy = true;
+  }
+  return busy;
+}
+
+UL RFWorkerClass::SelfTest(UL n)
+{
+  // Set up with the worker parked, so it is not in PollTest() meanwhile
+  UL value;
+  if( !Pause() ) {
+    Resume();
+    SERIAL_LN("  RF worker busy, self test not run");
+    return n;
+  }
+  while( m_testQueue.Pop(value) );
+  m_testNext = 1;
+  __atomic_store_n(&m_testLeft, n, __ATOMIC_RELEASE);
+  __atomic_store_n(&m_testStop, false, __ATOMIC_RELEASE);
+  Resume();
+
+  UL errors = 0;
+  UL expected = 1;
+  UL full = 0;
+  UL start = millis();
+  while( expected <= n ) {
+    if( m_testQueue.GetCount() == m_testQueue.GetCapacity() ) full++;
+    if( !m_testQueue.Pop(value) ) {
+      if( !m_running ) Poll();
+      if( millis() - start > 5000 ) {
+        SERIAL_LN("  timeout at %lu of %lu", expected - 1, n);
+        errors += n - expected + 1;
+        break;
+      }
+      continue;
+    }
+    if( value != expected ) {
+      if( errors < 5 ) SERIAL_LN("  got %lu, expected %lu", value, expected);
+      errors++;
+    }
+    expected = value + 1;
+  }
+  __atomic_store_n(&m_testStop, true, __ATOMIC_RELEASE);
+
+  SERIAL_LN("  %lu numbers in %lu ms from the %s, queue found full %lu times, %lu error(s)",
+      n, millis() - start, (m_running ? "worker thread" : "main thread"), full, errors);
+  return errors;
+}
+
+void RFWorkerClass::print()
+{
+  SERIAL_LN("** RF Worker: %s **", (m_running ? "thread" : "polled from the main loop"));
+  SERIAL_LN("  polls:%lu sent:%lu received:%lu corrupt:%lu", m_polls, m_sent, m_received, m_corrupt);
+  if( m_loopback ) SERIAL_LN("  loopback: %d%% loss, %lu acks", m_loopLoss, m_loopAcks);
+  SERIAL_LN("  tx queue:%d of %d dropped:%lu, rx queue:%d of %d dropped:%lu",
+      m_txQueue.GetCount(), m_txQueue.GetCapacity(), m_txQueue.GetDropped(),
+      m_rxQueue.GetCount(), m_rxQueue.GetCapacity(), m_rxQueue.GetDropped());
+  SERIAL_LN("");
+}
+
+//------------------------------------------------------------------
+// RF Worker Lock
+//------------------------------------------------------------------
+RFWorkerLock::RFWorkerLock()
+{
+  m_parked = theRFWorker.Pause();
+}
+
+RFWorkerLock::~RFWorkerLock()
+{
+  theRFWorker.Resume();
+}
@@ -0,0 +1,132 @@
+//  xlxRFWorker.h - Xlight RF worker thread, owns the radio
+
+#ifndef xlxRFWorker_h
+#define xlxRFWorker_h
+
+#include "xliCommon.h"
+#include "xlxSPSCQueue.h"
+#include "MyMessage.h"
+
+#define RFW_TX_QUEUE_LEN          16          // slots, power of 2, holds a full scene recall
+#define RFW_RX_QUEUE_LEN          16
+#define RFW_STACK_SIZE            2048
+#define RFW_IDLE_MS               1           // sleep when there is nothing to do
+#define RFW_PAUSE_TIMEOUT         200         // ms to wait for the worker to park
+
+// Frame types
+#define RFW_SEND                  0           // app -> worker
+#define RFW_SENT_OK               1           // worker -> app, send completed
+#define RFW_SENT_FAIL             2
+#define RFW_RECEIVED              3
+
+// Frame flags
+#define RFW_FLAG_REPLY            0x01        // a reply, never cached
+#define RFW_FLAG_REPLAY           0x02        // from the offline cache
+#define RFW_FLAG_BENCH            0x04        // from the RF flood test (xlxRFBench)
+
+//------------------------------------------------------------------
+// RF Worker Structures
+//------------------------------------------------------------------
+typedef struct
+{
+  UC type;
+  UC flags;
+  UC to;                                    // destination, or our address on receive
+  UC pipe;
+  UC len;
+  UL rttUs;                                 // send time, on RFW_SENT_*
+  UC data[MAX_MESSAGE_LENGTH];
+} RFFrame_t;
+
+//------------------------------------------------------------------
+// RF Worker Class
+//------------------------------------------------------------------
+// The worker thread is the only one that talks to the radio on the hot
+// path: it drains txQueue into send() and posts the outcome, and every
+// frame it reads, to rxQueue. The main loop posts and polls only, so a
+// blocking network call no longer holds up the radio.
+/// The few setup calls that still touch the radio from the main thread,
+/// e.g. setAddress(), run inside Pause()/Resume() (see RFWorkerLock).
+class RFWorkerClass
+{
+private:
+  SPSCQueueClass<RFFrame_t, RFW_TX_QUEUE_LEN> m_txQueue;
+  SPSCQueueClass<RFFrame_t, RFW_RX_QUEUE_LEN> m_rxQueue;
+  BOOL m_running;                           // thread started
+  UC m_pauseDepth;                          // main thread only
+  BOOL m_parked;                            // the outermost Pause() got the worker parked
+  UL m_pauseSeq;                            // main thread only
+  UL m_pauseReq;                            // pause sequence asked for, 0 if none
+  UL m_pauseAck;                            // last pause sequence the worker parked for
+
+  // Worker side statistics
+  UL m_polls;
+  UL m_sent;
+  UL m_received;
+  UL m_corrupt;
+
+  // Loopback: sends complete without the radio, and a frame asking
+  /// for an ack gets one back from the node it was sent to
+  BOOL m_loopback;
+  UC m_loopLoss;                            // % of sends failed on purpose
+  UL m_loopAcks;
+
+  // Queue self test, the worker produces m_testLeft numbers. Only the
+  /// worker counts down, and the main thread sets it only while the worker
+  /// is parked; m_testStop is the main thread's alone
+  SPSCQueueClass<UL, 16> m_testQueue;
+  UL m_testLeft;
+  UL m_testNext;
+  BOOL m_testStop;
+
+  static void ThreadMain(void *param);
+  BOOL PollTest();
+  void LoopbackAck(const RFFrame_t &frame);
+
+public:
+  RFWorkerClass();
+
+  // Start the thread, Poll() from the main loop if it can't be started
+  BOOL Begin();
+  BOOL IsRunning() { return m_running; }
+
+  // One worker pass: sends, then receives. True if it did anything
+  BOOL Poll();
+
+  // Main thread side
+  BOOL Post(MyMessage &msg, UC to, UC pipe = 255, UC flags = 0);
+  BOOL GetEvent(RFFrame_t &frame) { return m_rxQueue.Pop(frame); }
+  BOOL HasEvent() { return !m_rxQueue.IsEmpty(); }
+  // False if the worker didn't park in RFW_PAUSE_TIMEOUT, then the radio
+  /// may be in use and must be left alone; Resume() is still due
+  BOOL Pause();
+  void Resume();
+
+  // Take the radio out, e.g. to run the flood test without a lamp
+  void SetLoopback(BOOL on, UC lossPct = 0);
+  BOOL IsLoopback() { return m_loopback; }
+
+  // Push n numbers through a queue from the worker thread, returns errors
+  UL SelfTest(UL n);
+
+  void print();
+};
+
+// Park the worker while in scope, touch the radio only if IsParked()
+class RFWorkerLock
+{
+private:
+  BOOL m_parked;
+
+public:
+  RFWorkerLock();
+  ~RFWorkerLock();
+  BOOL IsParked() { return m_parked; }
+};
+
+//------------------------------------------------------------------
+// Function & Class Helper
+//------------------------------------------------------------------
+extern RFWorkerClass theRFWorker;
+
+#endif /* xlxRFWorker_h */
@@ -0,0 +1,254 @@
+/**
+ * xlxRecordLog.cpp - Xlight append-only record log in the emulated EEPROM
+ *
+ * Created by Baoshi Sun <bs.sun@datatellit.com>
+ * Copyright (C) 2015-2016 DTIT
+ * Full contributor list:
+ *
+ * Documentation:
+ * Support Forum:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * REVISION HISTORY
+ * Version 1.0 - Created by Baoshi Sun <bs.sun@datatellit.com>
+ *
+ * DESCRIPTION
+ * 1. Every byte written to the emulated EEPROM costs a slow page operation,
+ *    so a save only writes the fields that changed, as small records
+ * 2. Consecutive changes closer than a record header are merged into one
+ *    record, e.g. BR & CCT of all rings
+ * 3. Two slots (A/B) hold the base image with a generation and a CRC32;
+ *    compaction writes the other slot, only the bytes that differ from it
+ * 4. Boot takes the newest slot with a good CRC, no range checks needed
+ *
+ * ToDo:
+ * 1.
+ *
+**/
+
+#include "xlxRecordLog.h"
+
+//------------------------------------------------------------------
+// CRC-8 (poly 0x07) over a record
+//------------------------------------------------------------------
+static UC rlogCrc8(UC crc, UC data)
+{
+  crc ^= data;
+  for( UC i = 0; i < 8; i++ )
+    crc = (crc & 0x80) ? (UC)((crc << 1) ^ 0x07) : (UC)(crc << 1);
+  return crc;
+}
+
+//------------------------------------------------------------------
+// Xlight Record Log Class
+//------------------------------------------------------------------
+RecordLogClass::RecordLogClass(US offset, US len, void *saved, US imgLen)
+{
+  m_offset = offset;
+  m_len = len;
+  m_saved = (UC *)saved;
+  m_imgLen = imgLen;
+  m_slot = 1;               // so the first Format() goes to slot 0
+  m_gen = 0;
+  m_tail = RecordStart();
+  m_isValid = false;
+  m_bytesWritten = 0;
+  m_compactions = 0;
+}
+
+void RecordLogClass::WriteByte(US addr, UC value)
+{
+  EEPROM.write(addr, value);
+  m_bytesWritten++;
+}
+
+// Write only the bytes that differ
+void RecordLogClass::WriteBlock(US addr, const UC *data, US len)
+{
+  for( US i = 0; i < len; i++ ) {
+    if( EEPROM.read(addr + i) != data[i] ) WriteByte(addr + i, data[i]);
+  }
+}
+
+BOOL RecordLogClass::ReadSlot(UC slot, RecordLogHeader_t &hdr)
+{
+  US addr = SlotBase(slot);
+  EEPROM.get(addr, hdr);
+  if( hdr.magic != RLOG_MAGIC || hdr.imgLen != m_imgLen ) return false;
+
+  UL crc = CalcCRC32(&hdr.gen, sizeof(hdr.gen));
+  addr += sizeof(RecordLogHeader_t);
+  for( US i = 0; i < m_imgLen; i++ ) crc = UpdateCRC32(crc, EEPROM.read(addr + i));
+  return (crc == hdr.crc);
+}
+
+BOOL RecordLogClass::Load(void *image)
+{
+  m_isValid = false;
+  if( RecordStart() > RecordEnd() ) return false;
+
+  // Newest slot with a good CRC
+  RecordLogHeader_t hdr[2];
+  BOOL isGood[2];
+  for( UC slot = 0; slot < 2; slot++ ) isGood[slot] = ReadSlot(slot, hdr[slot]);
+  if( !isGood[0] && !isGood[1] ) return false;
+  if( isGood[0] && isGood[1] ) {
+    m_slot = ((LONG)(hdr[1].gen - hdr[0].gen) > 0 ? 1 : 0);
+  } else {
+    m_slot = (isGood[1] ? 1 : 0);
+  }
+  m_gen = hdr[m_slot].gen;
+
+  // Base image
+  US base = SlotBase(m_slot) + sizeof(RecordLogHeader_t);
+  for( US i = 0; i < m_imgLen; i++ ) m_saved[i] = EEPROM.read(base + i);
+
+  // Replay the records of this generation
+  UC tag = RecordTag();
+  US at = RecordStart();
+  while( at + RLOG_REC_OVERHEAD <= RecordEnd() ) {
+    if( EEPROM.read(at) != tag ) break;
+    UC len = EEPROM.read(at + 1);
+    US off = EEPROM.read(at + 2) | (EEPROM.read(at + 3) << 8);
+    if( len == 0 || off + len > m_imgLen || at + RLOG_REC_OVERHEAD + len > RecordEnd() ) break;
+
+    UC crc = 0;
+    for( UC i = 0; i < 4; i++ ) crc = rlogCrc8(crc, EEPROM.read(at + i));
+    for( UC i = 0; i < len; i++ ) crc = rlogCrc8(crc, EEPROM.read(at + 4 + i));
+    if( crc != EEPROM.read(at + 4 + len) ) break;
+
+    for( UC i = 0; i < len; i++ ) m_saved[off + i] = EEPROM.read(at + 4 + i);
+    at += RLOG_REC_OVERHEAD + len;
+  }
+
+  // Whatever stopped the replay must read as an end marker from now on
+  m_tail = at;
+  if( m_tail < RecordEnd() && EEPROM.read(m_tail) != RLOG_TAG_ERASED )
+    WriteByte(m_tail, RLOG_TAG_ERASED);
+
+  memcpy(image, m_saved, m_imgLen);
+  m_isValid = true;
+  return true;
+}
+
+void RecordLogClass::Format(const void *image)
+{
+  memcpy(m_saved, image, m_imgLen);
+  Compact();
+  m_isValid = true;
+}
+
+// Find the next run of changed bytes in [from, to), returns its offset
+/// or m_imgLen if there is none. Runs separated by fewer unchanged bytes
+/// than a record header are merged.
+US RecordLogClass::NextDelta(const UC *image, US from, US to, US *len)
+{
+  US start = from;
+  while( start < to && image[start] == m_saved[start] ) start++;
+  if( start >= to ) return m_imgLen;
+
+  US last = start;
+  for( US i = start + 1; i < to && i - start < RLOG_REC_MAX_DATA; i++ ) {
+    if( image[i] != m_saved[i] ) last = i;
+    else if( i - last > RLOG_REC_OVERHEAD ) break;
+  }
+  *len = last - start + 1;
+  return start;
+}
+
+// Write m_saved to the other slot with the next generation
+void RecordLogClass::Compact()
+{
+  UC slot = m_slot ^ 1;
+  RecordLogHeader_t hdr;
+  hdr.magic = RLOG_MAGIC;
+  hdr.imgLen = m_imgLen;
+  hdr.gen = m_gen + 1;
+  hdr.crc = CalcCRC32(m_saved, m_imgLen, CalcCRC32(&hdr.gen, sizeof(hdr.gen)));
+
+  // Records of the current generation have another tag and are ignored
+  /// by the next one; only a leftover from 255 generations ago could match
+  UC tag = (UC)(hdr.gen % RLOG_TAG_ERASED);
+  if( RecordStart() < RecordEnd() && EEPROM.read(RecordStart()) == tag )
+    WriteByte(RecordStart(), RLOG_TAG_ERASED);
+
+  // The slot's CRC fails until its header is complete, so a torn write
+  /// leaves the active slot in charge
+  WriteBlock(SlotBase(slot) + sizeof(RecordLogHeader_t), m_saved, m_imgLen);
+  WriteBlock(SlotBase(slot), (const UC *)&hdr, sizeof(hdr));
+
+  m_slot = slot;
+  m_gen = hdr.gen;
+  m_tail = RecordStart();
+  m_compactions++;
+}
+
+US RecordLogClass::Save(const void *image)
+{
+  return Save(image, 0, m_imgLen);
+}
+
+US RecordLogClass::Save(const void *image, US from, US size)
+{
+  const UC *img = (const UC *)image;
+  US to = (from + size < m_imgLen ? from + size : m_imgLen);
+  UL written = m_bytesWritten;
+
+  if( !m_isValid ) {
+    Format(image);
+    return (US)(m_bytesWritten - written);
+  }
+
+  // Size of the records needed
+  US need = 0;
+  US pos = from, len;
+  while( (pos = NextDelta(img, pos, to, &len)) < m_imgLen ) {
+    need += RLOG_REC_OVERHEAD + len;
+    pos += len;
+  }
+  if( need == 0 ) return 0;
+
+  if( m_tail + need > RecordEnd() ) {
+    if( RecordStart() + need > RecordEnd() ) {
+      // More changes than the whole record area, new base straight away
+      Format(image);
+      return (US)(m_bytesWritten - written);
+    }
+    Compact();
+  }
+
+  // End marker first, then the records, then the tag byte that makes
+  /// them visible
+  UC tag = RecordTag();
+  US start = m_tail;
+  US at = start;
+  if( start + need < RecordEnd() ) WriteByte(start + need, RLOG_TAG_ERASED);
+
+  pos = from;
+  while( (pos = NextDelta(img, pos, to, &len)) < m_imgLen ) {
+    UC header[4] = { tag, (UC)len, (UC)(pos & 0xFF), (UC)(pos >> 8) };
+    UC crc = 0;
+    for( UC i = 0; i < 4; i++ ) {
+      crc = rlogCrc8(crc, header[i]);
+      if( i > 0 || at != start ) WriteByte(at + i, header[i]);
+    }
+    for( US i = 0; i < len; i++ ) {
+      crc = rlogCrc8(crc, img[pos + i]);
+      WriteByte(at + 4 + i, img[pos + i]);
+    }
+    WriteByte(at + 4 + len, crc);
+
+    memcpy(m_saved + pos, img + pos, len);
+    at += RLOG_REC_OVERHEAD + len;
+    pos += len;
+  }
+  WriteByte(start, tag);
+  m_tail = at;
+
+  return (US)(m_bytesWritten - written);
+}
@@ -0,0 +1,89 @@
+//  xlxRecordLog.h - Xlight append-only record log in the emulated EEPROM
+
+#ifndef xlxRecordLog_h
+#define xlxRecordLog_h
+
+#include "xliCommon.h"
+
+#define RLOG_MAGIC                0x4C52      // "RL"
+#define RLOG_TAG_ERASED           0xFF        // never used as a record tag
+
+// Record: [tag][len][offset lo][offset hi][data...][crc8]
+#define RLOG_REC_OVERHEAD         5
+#define RLOG_REC_MAX_DATA         0xFF
+
+//------------------------------------------------------------------
+// Record Log Structures
+//------------------------------------------------------------------
+typedef struct
+{
+  US magic;                                 // RLOG_MAGIC when formatted
+  US imgLen;                                // size of the image
+  UL gen;                                   // generation, newest valid slot wins
+  UL crc;                                   // CRC32 over gen and the base image
+} RecordLogHeader_t;
+
+//------------------------------------------------------------------
+// Record Log Class
+//------------------------------------------------------------------
+// A region holds two slots [header][base image] (A/B) and a record area.
+// Save() appends only the byte ranges that differ from the last saved
+// image; Load() takes the newest slot whose CRC32 matches and replays the
+// records tagged with its generation. When the record area is full, the
+// image is written to the other slot with the next generation, which
+// retires all old records at once.
+//
+// Crash safety: a save becomes visible by writing the tag byte of its first
+// record last, and the byte after the tail is always an end marker, so a
+// torn save is ignored as a whole. A torn slot write fails its CRC and the
+// previous slot is used.
+class RecordLogClass
+{
+private:
+  US m_offset;
+  US m_len;
+  UC *m_saved;              // image as persisted, provided by the owner
+  US m_imgLen;
+  UC m_slot;                // active slot, 0 or 1
+  UL m_gen;
+  US m_tail;                // where the next record goes
+  BOOL m_isValid;
+
+  // Statistics
+  UL m_bytesWritten;
+  US m_compactions;
+
+  US SlotSize() { return sizeof(RecordLogHeader_t) + m_imgLen; }
+  US SlotBase(UC slot) { return m_offset + slot * SlotSize(); }
+  US RecordStart() { return m_offset + 2 * SlotSize(); }
+  US RecordEnd() { return m_offset + m_len; }
+  UC RecordTag() { return (UC)(m_gen % RLOG_TAG_ERASED); }
+
+  void WriteByte(US addr, UC value);
+  void WriteBlock(US addr, const UC *data, US len);
+  BOOL ReadSlot(UC slot, RecordLogHeader_t &hdr);
+  US NextDelta(const UC *image, US from, US to, US *len);
+  void Compact();
+
+public:
+  RecordLogClass(US offset, US len, void *saved, US imgLen);
+
+  // Replay the newest valid slot + records into image, false if none
+  BOOL Load(void *image);
+  // Write image to the other slot as the new base and drop all records
+  void Format(const void *image);
+  // Append the changes since the last Load/Save/Format, returns bytes written
+  US Save(const void *image);
+  // Same, but only look for changes in [from, from + size)
+  US Save(const void *image, US from, US size);
+
+  BOOL IsValid() { return m_isValid; }
+  UC GetSlot() { return m_slot; }
+  UL GetGeneration() { return m_gen; }
+  US GetUsedBytes() { return m_tail - RecordStart(); }
+  US GetFreeBytes() { return RecordEnd() - m_tail; }
+  UL GetBytesWritten() { return m_bytesWritten; }
+  US GetCompactions() { return m_compactions; }
+};
+
+#endif /* xlxRecordLog_h */
@@ -0,0 +1,416 @@
+/**
+ * xlxRuleEngine.cpp - Xlight rule engine, compiled conditions evaluated on change
+ *
+ * Created by Baoshi Sun <bs.sun@datatellit.com>
+ * Copyright (C) 2015-2016 DTIT
+ * Full contributor list:
+ *
+ * Documentation:
+ * Support Forum:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * REVISION HISTORY
+ * Version 1.0 - Created by Baoshi Sun <bs.sun@datatellit.com>
+ *
+ * DESCRIPTION
+ * 1. Conditions are compiled once into postfix bytecode, checked for stack
+ *    depth and input range when added, so Run() needs no checks
+ * 2. Inputs are the sensors (sensors_t), the minute of the day and the last
+ *    event; every rule knows the inputs it reads (dependency bitmap)
+ * 3. A change of input only marks the rules in that input's list, evaluation
+ *    runs through the marked rules and stops when the time budget is used up
+ * 4. Actions: switch a lamp, set BR & CCT, or recall a scene
+ *
+ * ToDo:
+ * 1. Keep compiled rules in MEM_RULES on the P1 external flash
+ *
+**/
+
+#include "xlxRuleEngine.h"
+#include "xlSmartRemote.h"
+#include "xlxScenario.h"
+#include "xlxStatistics.h"
+
+//------------------------------------------------------------------
+// the one and only instance of RuleEngineClass
+RuleEngineClass theRules;
+
+//------------------------------------------------------------------
+// Xlight Rule Engine Class
+//------------------------------------------------------------------
+RuleEngineClass::RuleEngineClass(US maxRules, US codeSize)
+{
+  // Widest members first, so every table is aligned
+  US nWords = (maxRules + 31) / 32;
+  UL maxDeps = (UL)maxRules * RULE_DEPS_PER_RULE;
+  if( maxDeps > 0xFFFF ) maxDeps = 0xFFFF;
+  m_mem = malloc(3 * nWords * sizeof(UL) + maxRules * sizeof(Rule_t) + maxDeps * sizeof(US) + codeSize);
+  if( !m_mem ) maxRules = codeSize = maxDeps = nWords = 0;
+  m_maxRules = maxRules;
+  m_codeSize = codeSize;
+  m_maxDeps = maxDeps;
+  m_pending = (UL *)m_mem;
+  m_state = m_pending + nWords;
+  m_evented = m_state + nWords;
+  m_rules = (Rule_t *)(m_evented + nWords);
+  m_depRules = (US *)(m_rules + maxRules);
+  m_code = (UC *)(m_depRules + maxDeps);
+
+  m_dryRun = false;
+  m_evaluated = 0;
+  m_fired = 0;
+  memset(m_input, 0x00, sizeof(m_input));
+  Clear();
+}
+
+RuleEngineClass::~RuleEngineClass()
+{
+  free(m_mem);
+}
+
+void RuleEngineClass::Clear()
+{
+  m_nRules = 0;
+  m_codeUsed = 0;
+  m_nDeps = 0;
+  US nWords = (m_maxRules + 31) / 32;
+  memset(m_pending, 0x00, nWords * sizeof(UL));
+  memset(m_state, 0x00, nWords * sizeof(UL));
+  memset(m_evented, 0x00, nWords * sizeof(UL));
+  m_nPending = 0;
+  m_indexStale = true;
+}
+
+void RuleEngineClass::SetBit(UL *bits, US i, BOOL on)
+{
+  if( on ) bits[i >> 5] |= (1UL << (i & 31));
+  else bits[i >> 5] &= ~(1UL << (i & 31));
+}
+
+// Check the bytecode can run without checks and collect its inputs
+BOOL RuleEngineClass::Verify(const UC *code, UC len, UL *deps)
+{
+  UC depth = 0;
+  UC pc = 0;
+  *deps = 0;
+  while( pc < len ) {
+    UC op = code[pc++];
+    switch( op ) {
+    case RULE_OP_END:
+      return (depth == 1 && pc == len);
+
+    case RULE_OP_PUSH8:
+    case RULE_OP_INPUT:
+      if( pc + 1 > len || depth >= RULE_STACK_DEPTH ) return false;
+      if( op == RULE_OP_INPUT ) {
+        if( code[pc] >= RULE_INPUTS ) return false;
+        *deps |= (1UL << code[pc]);
+      }
+      pc++;
+      depth++;
+      break;
+
+    case RULE_OP_PUSH16:
+      if( pc + 2 > len || depth >= RULE_STACK_DEPTH ) return false;
+      pc += 2;
+      depth++;
+      break;
+
+    case RULE_OP_NOT:
+      if( depth < 1 ) return false;
+      break;
+
+    default:
+      if( op < RULE_OP_EQ || op > RULE_OP_OR || depth < 2 ) return false;
+      depth--;
+      break;
+    }
+  }
+  return false;
+}
+
+BOOL RuleEngineClass::Run(const UC *code)
+{
+  SHORT stack[RULE_STACK_DEPTH];
+  SHORT *sp = stack;            // next free
+  for( ;; ) {
+    switch( *code++ ) {
+    case RULE_OP_END:     return (sp[-1] != 0);
+    case RULE_OP_PUSH8:   *sp++ = *code++; break;
+    case RULE_OP_PUSH16:  *sp++ = (SHORT)(code[0] | (code[1] << 8)); code += 2; break;
+    case RULE_OP_INPUT:   *sp++ = m_input[*code++]; break;
+    case RULE_OP_EQ:      sp--; sp[-1] = (sp[-1] == sp[0]); break;
+    case RULE_OP_NE:      sp--; sp[-1] = (sp[-1] != sp[0]); break;
+    case RULE_OP_LT:      sp--; sp[-1] = (sp[-1] < sp[0]); break;
+    case RULE_OP_GT:      sp--; sp[-1] = (sp[-1] > sp[0]); break;
+    case RULE_OP_LE:      sp--; sp[-1] = (sp[-1] <= sp[0]); break;
+    case RULE_OP_GE:      sp--; sp[-1] = (sp[-1] >= sp[0]); break;
+    case RULE_OP_AND:     sp--; sp[-1] = (sp[-1] && sp[0]); break;
+    case RULE_OP_OR:      sp--; sp[-1] = (sp[-1] || sp[0]); break;
+    case RULE_OP_NOT:     sp[-1] = !sp[-1]; break;
+    }
+  }
+}
+
+SHORT RuleEngineClass::FindRule(US ruleID)
+{
+  for( US i = 0; i < m_nRules; i++ ) {
+    if( m_rules[i].ruleID == ruleID ) return i;
+  }
+  return -1;
+}
+
+// Counting sort of (input, rule) pairs
+void RuleEngineClass::BuildIndex()
+{
+  memset(m_depStart, 0x00, sizeof(m_depStart));
+  for( US r = 0; r < m_nRules; r++ ) {
+    for( UC i = 0; i < RULE_INPUTS; i++ ) {
+      if( m_rules[r].deps & (1UL << i) ) m_depStart[i + 1]++;
+    }
+  }
+  for( UC i = 0; i < RULE_INPUTS; i++ ) m_depStart[i + 1] += m_depStart[i];
+
+  US fill[RULE_INPUTS];
+  memcpy(fill, m_depStart, sizeof(fill));
+  for( US r = 0; r < m_nRules; r++ ) {
+    for( UC i = 0; i < RULE_INPUTS; i++ ) {
+      if( m_rules[r].deps & (1UL << i) ) m_depRules[fill[i]++] = r;
+    }
+  }
+  m_indexStale = false;
+}
+
+BOOL RuleEngineClass::AddRule(US ruleID, const UC *code, UC len, const RuleAction_t &action)
+{
+  UL deps;
+  if( len > RULE_MAX_CODE_LEN || !Verify(code, len, &deps) ) return false;
+  RemoveRule(ruleID);
+  if( m_nRules >= m_maxRules || (UL)m_codeUsed + len > m_codeSize ) return false;
+
+  // Room in the dependency lists
+  UC nDeps = __builtin_popcountl(deps);
+  if( (UL)m_nDeps + nDeps > m_maxDeps ) return false;
+
+  Rule_t &rule = m_rules[m_nRules];
+  rule.ruleID = ruleID;
+  rule.codeLen = len;
+  rule.codeOffset = m_codeUsed;
+  rule.deps = deps;
+  rule.action = action;
+  memcpy(m_code + m_codeUsed, code, len);
+  m_codeUsed += len;
+  m_nDeps += nDeps;
+
+  // Evaluated once as it is, from then on when its inputs change
+  SetBit(m_state, m_nRules, false);
+  SetBit(m_evented, m_nRules, false);
+  SetBit(m_pending, m_nRules, true);
+  m_nPending++;
+  m_nRules++;
+  m_indexStale = true;
+  return true;
+}
+
+BOOL RuleEngineClass::RemoveRule(US ruleID)
+{
+  SHORT idx = FindRule(ruleID);
+  if( idx < 0 ) return false;
+
+  // Close the gap in the code pool
+  Rule_t &rule = m_rules[idx];
+  US codeEnd = rule.codeOffset + rule.codeLen;
+  memmove(m_code + rule.codeOffset, m_code + codeEnd, m_codeUsed - codeEnd);
+  m_codeUsed -= rule.codeLen;
+  m_nDeps -= __builtin_popcountl(rule.deps);
+  for( US r = 0; r < m_nRules; r++ ) {
+    if( m_rules[r].codeOffset > rule.codeOffset ) m_rules[r].codeOffset -= rule.codeLen;
+  }
+
+  // and in the rule table, bits move along
+  if( GetBit(m_pending, idx) ) m_nPending--;
+  for( US r = idx; r + 1 < m_nRules; r++ ) {
+    m_rules[r] = m_rules[r + 1];
+    SetBit(m_pending, r, GetBit(m_pending, r + 1));
+    SetBit(m_state, r, GetBit(m_state, r + 1));
+    SetBit(m_evented, r, GetBit(m_evented, r + 1));
+  }
+  m_nRules--;
+  SetBit(m_pending, m_nRules, false);
+  SetBit(m_state, m_nRules, false);
+  SetBit(m_evented, m_nRules, false);
+  m_indexStale = true;
+  return true;
+}
+
+void RuleEngineClass::MarkDeps(UC input)
+{
+  if( m_indexStale ) BuildIndex();
+  for( US i = m_depStart[input]; i < m_depStart[input + 1]; i++ ) {
+    US r = m_depRules[i];
+    if( !GetBit(m_pending, r) ) {
+      SetBit(m_pending, r, true);
+      m_nPending++;
+    }
+  }
+}
+
+void RuleEngineClass::SetInput(UC input, SHORT value)
+{
+  if( input >= RULE_INPUTS || m_input[input] == value ) return;
+  m_input[input] = value;
+  MarkDeps(input);
+}
+
+// Every event counts, even the same one again. The event code stays as
+/// an input, but only the rules marked here fire while already true.
+void RuleEngineClass::SetEvent(SHORT code)
+{
+  m_input[RULE_INPUT_EVENT] = code;
+  MarkDeps(RULE_INPUT_EVENT);
+  for( US i = m_depStart[RULE_INPUT_EVENT]; i < m_depStart[RULE_INPUT_EVENT + 1]; i++ ) {
+    SetBit(m_evented, m_depRules[i], true);
+  }
+}
+
+US RuleEngineClass::Evaluate(UL budgetUs)
+{
+  if( m_nPending == 0 ) return 0;
+
+  UL startTime = micros();
+  US nEval = 0;
+  BOOL inBudget = true;
+  for( US w = 0; w < (m_nRules + 31) / 32 && m_nPending && inBudget; w++ ) {
+    while( m_pending[w] ) {
+      // The rest waits for the next round
+      if( nEval > 0 && micros() - startTime >= budgetUs ) {
+        inBudget = false;
+        break;
+      }
+
+      US r = (w << 5) + __builtin_ctzl(m_pending[w]);
+      m_pending[w] &= m_pending[w] - 1;
+      m_nPending--;
+      nEval++;
+
+      const Rule_t &rule = m_rules[r];
+      BOOL result = Run(m_code + rule.codeOffset);
+      BOOL wasTrue = GetBit(m_state, r);
+      BOOL evented = GetBit(m_evented, r);
+      SetBit(m_state, r, result);
+      SetBit(m_evented, r, false);
+      if( result && (!wasTrue || evented) ) {
+        m_fired++;
+        if( !m_dryRun ) Execute(rule.action);
+      }
+    }
+  }
+  m_evaluated += nEval;
+  return nEval;
+}
+
+void RuleEngineClass::Execute(const RuleAction_t &action)
+{
+  theStat.Command(STAT_SRC_AUTO);
+  switch( action.type ) {
+  case RULE_ACT_ON:
+    theSys.DevSoftSwitch(true, action.target);
+    break;
+  case RULE_ACT_OFF:
+    theSys.DevSoftSwitch(false, action.target);
+    break;
+  case RULE_ACT_BR_CCT:
+    theSys.SendChangeBR_CCT(action.param1, action.param2, action.target);
+    break;
+  case RULE_ACT_SCENE:
+    theScenario.Recall(action.target);
+    break;
+  }
+}
+
+UC RuleEngineClass::Compile(const char *expr, UC *code, UC maxLen)
+{
+  static const char *strOps[] = { "==", "!=", "<", ">", "<=", ">=", "&&", "||", "!" };
+  UC len = 0;
+  char token[12];
+
+  while( expr && *expr ) {
+    // Next token
+    while( *expr == ' ' || *expr == ',' ) expr++;
+    if( !*expr ) break;
+    UC n = 0;
+    while( *expr && *expr != ' ' && *expr != ',' ) {
+      if( n >= sizeof(token) - 1 ) return 0;
+      token[n++] = *expr++;
+    }
+    token[n] = '\0';
+    if( len + 3 >= maxLen ) return 0;    // keep room for END
+
+    SHORT op = -1;
+    for( UC i = 0; i < sizeof(strOps) / sizeof(strOps[0]); i++ ) {
+      if( strcmp(token, strOps[i]) == 0 ) op = RULE_OP_EQ + i;
+    }
+    if( op >= 0 ) {
+      code[len++] = (UC)op;
+    } else if( (token[0] == 's' || token[0] == 'S') && isdigit(token[1]) ) {
+      UC sensor = atoi(token + 1);
+      if( sensor >= RULE_INPUT_TIME ) return 0;
+      code[len++] = RULE_OP_INPUT;
+      code[len++] = sensor;
+    } else if( strcasecmp(token, "time") == 0 ) {
+      code[len++] = RULE_OP_INPUT;
+      code[len++] = RULE_INPUT_TIME;
+    } else if( strcasecmp(token, "event") == 0 ) {
+      code[len++] = RULE_OP_INPUT;
+      code[len++] = RULE_INPUT_EVENT;
+    } else if( isdigit(token[0]) || (token[0] == '-' && isdigit(token[1])) ) {
+      // Number, or hh:mm as minute of the day
+      LONG value = atol(token);
+      char *colon = strchr(token, ':');
+      if( colon ) value = value * 60 + atol(colon + 1);
+      if( value >= 0 && value <= 0xFF ) {
+        code[len++] = RULE_OP_PUSH8;
+        code[len++] = (UC)value;
+      } else {
+        code[len++] = RULE_OP_PUSH16;
+        code[len++] = (UC)(value & 0xFF);
+        code[len++] = (UC)((value >> 8) & 0xFF);
+      }
+    } else {
+      return 0;
+    }
+  }
+
+  code[len++] = RULE_OP_END;
+  UL deps;
+  return (Verify(code, len, &deps) ? len : 0);
+}
+
+SHORT RuleEngineClass::SensorFromType(UC type)
+{
+  switch( type ) {
+  case V_TEMP:          return sensorDHT;
+  case V_LIGHT_LEVEL:   return sensorALS;
+  case V_TRIPPED:       return sensorPIR;
+  }
+  return -1;
+}
+
+void RuleEngineClass::print()
+{
+  SERIAL_LN("** Rules: %d of %d, code %d of %d bytes, %d pending **", m_nRules, m_maxRules, m_codeUsed, m_codeSize, m_nPending);
+  SERIAL_LN("  evaluated:%lu fired:%lu time:%d event:%d", m_evaluated, m_fired,
+      m_input[RULE_INPUT_TIME], m_input[RULE_INPUT_EVENT]);
+  for( US r = 0; r < m_nRules; r++ ) {
+    const Rule_t &rule = m_rules[r];
+    SERIAL_LN("  Rule %d: inputs 0x%05lX, %d bytes, action %d(%d,%d,%d), %s", rule.ruleID, rule.deps,
+        rule.codeLen, rule.action.type, rule.action.target, rule.action.param1, rule.action.param2,
+        GetBit(m_state, r) ? "true" : "false");
+  }
+  SERIAL_LN("");
+}
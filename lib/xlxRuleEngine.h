@@ -0,0 +1,155 @@
+//  xlxRuleEngine.h - Xlight rule engine, compiled conditions evaluated on change
+
+#ifndef xlxRuleEngine_h
+#define xlxRuleEngine_h
+
+#include "xliCommon.h"
+#include "xliMemoryMap.h"
+
+// Sizes of theRules, another engine may be made with its own
+#define RULE_MAX_RULES            64
+#define RULE_CODE_SIZE            1024        // bytecode pool
+#define RULE_DEPS_PER_RULE        4           // dependency list entries per rule, on average
+#define RULE_BENCH_RULES          1000        // 'test rules' default, on its own engine
+#define RULE_BENCH_MAX_RULES      4000
+#define RULE_MAX_CODE_LEN         64          // one rule
+#define RULE_STACK_DEPTH          8
+#define RULE_EVAL_BUDGET_US       2000        // per Evaluate() call
+
+// Inputs: the sensors_t values, then time and event
+#define RULE_INPUT_TIME           16          // minute of the day
+#define RULE_INPUT_EVENT          17          // last event code
+#define RULE_INPUTS               18
+
+// Bytecode, postfix: operands are pushed, operators pop and push
+#define RULE_OP_END               0x00
+#define RULE_OP_PUSH8             0x01        // + 1 byte, unsigned
+#define RULE_OP_PUSH16            0x02        // + 2 bytes, signed, LSB first
+#define RULE_OP_INPUT             0x03        // + input index
+#define RULE_OP_EQ                0x10
+#define RULE_OP_NE                0x11
+#define RULE_OP_LT                0x12
+#define RULE_OP_GT                0x13
+#define RULE_OP_LE                0x14
+#define RULE_OP_GE                0x15
+#define RULE_OP_AND               0x16
+#define RULE_OP_OR                0x17
+#define RULE_OP_NOT               0x18
+
+// Actions
+#define RULE_ACT_NONE             0
+#define RULE_ACT_ON               1           // target: node
+#define RULE_ACT_OFF              2           // target: node
+#define RULE_ACT_BR_CCT           3           // target: node, param1: BR, param2: CCT
+#define RULE_ACT_SCENE            4           // target: scene ID
+
+//------------------------------------------------------------------
+// Rule Structures
+//------------------------------------------------------------------
+typedef struct
+{
+  UC type;                                  // RULE_ACT_*
+  UC target;
+  UC param1;
+  US param2;
+} RuleAction_t;
+
+typedef struct
+{
+  US ruleID;
+  UC codeLen;
+  US codeOffset;                            // in the bytecode pool
+  UL deps;                                  // bit per input
+  RuleAction_t action;
+} Rule_t;
+
+//------------------------------------------------------------------
+// Rule Engine Class
+//------------------------------------------------------------------
+// A rule is a condition in bytecode plus an action. Each input keeps the
+// list of rules that read it; changing an input marks only those rules as
+// pending, and Evaluate() runs the pending ones within a time budget.
+// A rule fires when its condition turns true; rules that read the event
+// input fire every time the event makes them true.
+/// The tables are one heap block sized at construction, so a benchmark
+/// can run thousands of rules on an engine of its own.
+class RuleEngineClass
+{
+private:
+  void *m_mem;                              // all the tables below, NULL if out of memory
+  US m_maxRules;
+  US m_codeSize;
+  US m_maxDeps;
+
+  Rule_t *m_rules;
+  UC *m_code;
+  US m_nRules;
+  US m_codeUsed;
+
+  SHORT m_input[RULE_INPUTS];
+  US m_depStart[RULE_INPUTS + 1];           // rules of input i: m_depRules[start[i]..start[i+1])
+  US *m_depRules;
+  US m_nDeps;
+  BOOL m_indexStale;
+
+  UL *m_pending;                            // bit per rule
+  UL *m_state;                              // last result of each rule
+  UL *m_evented;                            // marked by an event, fire even if already true
+  US m_nPending;
+  BOOL m_dryRun;                            // count only, don't act
+
+  // Statistics
+  UL m_evaluated;
+  UL m_fired;
+
+  static BOOL Verify(const UC *code, UC len, UL *deps);
+  static BOOL GetBit(const UL *bits, US i) { return (bits[i >> 5] >> (i & 31)) & 1; }
+  static void SetBit(UL *bits, US i, BOOL on);
+  BOOL Run(const UC *code);
+  void BuildIndex();
+  void MarkDeps(UC input);
+  SHORT FindRule(US ruleID);
+
+  // One owner per table block
+  RuleEngineClass(const RuleEngineClass &);
+  RuleEngineClass &operator=(const RuleEngineClass &);
+
+public:
+  RuleEngineClass(US maxRules = RULE_MAX_RULES, US codeSize = RULE_CODE_SIZE);
+  ~RuleEngineClass();
+  BOOL IsValid() { return m_mem != NULL; }
+
+  void Clear();
+  // Add or replace a rule, false if the bytecode is invalid or no room
+  BOOL AddRule(US ruleID, const UC *code, UC len, const RuleAction_t &action);
+  BOOL RemoveRule(US ruleID);
+  US GetCount() { return m_nRules; }
+
+  // Compile a postfix expression, e.g. "s1 30 < time 18:00 >= &&",
+  /// returns the code length or 0 on error
+  static UC Compile(const char *expr, UC *code, UC maxLen);
+  // MySensors value type to sensors_t, -1 if not a rule input
+  static SHORT SensorFromType(UC type);
+
+  void SetInput(UC input, SHORT value);
+  void SetEvent(SHORT code);
+  // Run pending rules, returns how many were evaluated
+  US Evaluate(UL budgetUs = RULE_EVAL_BUDGET_US);
+  US GetPending() { return m_nPending; }
+
+  // Also used by the schedules
+  void Execute(const RuleAction_t &action);
+
+  void SetDryRun(BOOL dry) { m_dryRun = dry; }
+  UL GetEvaluated() { return m_evaluated; }
+  UL GetFired() { return m_fired; }
+
+  void print();
+};
+
+//------------------------------------------------------------------
+// Function & Class Helper
+//------------------------------------------------------------------
+extern RuleEngineClass theRules;
+
+#endif /* xlxRuleEngine_h */
@@ -0,0 +1,69 @@
+//  xlxSPSCQueue.h - Xlight lock-free single producer, single consumer queue
+
+#ifndef xlxSPSCQueue_h
+#define xlxSPSCQueue_h
+
+#include "xliCommon.h"
+
+//------------------------------------------------------------------
+// SPSC Queue Class
+//------------------------------------------------------------------
+// A ring of N slots holding up to N - 1 items. Only the producer writes
+// m_tail and only the consumer writes m_head; each publishes its index
+// with a release store after touching the slot, and reads the other's
+// with an acquire load, so no lock is needed between the two threads.
+/// Push() from one thread only, Pop() from one other thread only.
+template <typename T, US N>
+class SPSCQueueClass
+{
+private:
+  T m_items[N];
+  US m_head;                                // next to pop, consumer owned
+  US m_tail;                                // next to push, producer owned
+  UL m_dropped;                             // pushes refused, producer owned
+
+public:
+  SPSCQueueClass()
+  {
+    m_head = 0;
+    m_tail = 0;
+    m_dropped = 0;
+  }
+
+  // Producer: false if full
+  BOOL Push(const T &item)
+  {
+    US tail = m_tail;
+    US next = (tail + 1) % N;
+    if( next == __atomic_load_n(&m_head, __ATOMIC_ACQUIRE) ) {
+      m_dropped++;
+      return false;
+    }
+    m_items[tail] = item;
+    __atomic_store_n(&m_tail, next, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  // Consumer: false if empty
+  BOOL Pop(T &item)
+  {
+    US head = m_head;
+    if( head == __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE) ) return false;
+    item = m_items[head];
+    __atomic_store_n(&m_head, (US)((head + 1) % N), __ATOMIC_RELEASE);
+    return true;
+  }
+
+  // Either side, a snapshot
+  US GetCount()
+  {
+    US tail = __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE);
+    US head = __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+    return (tail + N - head) % N;
+  }
+  BOOL IsEmpty() { return GetCount() == 0; }
+  US GetCapacity() { return N - 1; }
+  UL GetDropped() { return m_dropped; }
+};
+
+#endif /* xlxSPSCQueue_h */
@@ -0,0 +1,189 @@
+/**
+ * xlxScenario.cpp - Xlight scenario store with precompiled RF frames
+ *
+ * Created by Baoshi Sun <bs.sun@datatellit.com>
+ * Copyright (C) 2015-2016 DTIT
+ * Full contributor list:
+ *
+ * Documentation:
+ * Support Forum:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * REVISION HISTORY
+ * Version 1.0 - Created by Baoshi Sun <bs.sun@datatellit.com>
+ *
+ * DESCRIPTION
+ * 1. A scene is a list of (node, ring, hue) targets, looked up by scene ID
+ * 2. Each target is compiled into a V_RGBW set message when the scene is
+ *    set, so recall is a memcpy and a send per frame
+ * 3. Frames carry our node ID as sender and are recompiled if it changes
+ * 4. Payload: [State, BR, CCT lo, CCT hi] for the whole lamp, extended by
+ *    [ring, R, G, B] for a single ring (same order as the V_RGBW ack)
+ *
+ * ToDo:
+ * 1. Keep scenes in MEM_SCENARIOS on the P1 external flash
+ *
+**/
+
+#include "xlxScenario.h"
+#include "xlxRF24Client.h"
+#include "xlxRFWorker.h"
+
+// Recall() posts a scene's frames back to back, the TX queue takes them all
+static_assert(RFW_TX_QUEUE_LEN - 1 >= SCN_MAX_TARGETS, "RF TX queue too short for a scene");
+
+//------------------------------------------------------------------
+// the one and only instance of ScenarioClass
+ScenarioClass theScenario;
+
+//------------------------------------------------------------------
+// Xlight Scenario Class
+//------------------------------------------------------------------
+ScenarioClass::ScenarioClass()
+{
+  memset(m_scenes, 0x00, sizeof(m_scenes));
+  memset(m_sceneIndex, SCN_SLOT_NONE, sizeof(m_sceneIndex));
+  memset(m_nFrames, 0x00, sizeof(m_nFrames));
+  m_usedFrames = 0;
+  m_compiledFor = NODEID_DUMMY;
+}
+
+// Built-in scenes, as the function buttons used to do
+void ScenarioClass::InitScenes()
+{
+  const UC lv_br[] = { BTN_FN1_BR, BTN_FN2_BR, BTN_FN3_BR, BTN_FN4_BR };
+  const US lv_cct[] = { BTN_FN1_CCT, BTN_FN2_CCT, BTN_FN3_CCT, BTN_FN4_CCT };
+
+  ScenarioTarget_t target;
+  memset(&target, 0x00, sizeof(target));
+  target.nodeID = NODEID_MAINDEVICE;
+  target.ringID = RING_ID_ALL;
+  target.hue.State = 1;
+  for( UC i = 0; i < 4; i++ ) {
+    target.hue.BR = lv_br[i];
+    target.hue.CCT = lv_cct[i];
+    SetScene(SCN_ID_FN1 + i, &target, 1);
+  }
+}
+
+void ScenarioClass::CompileTarget(const ScenarioTarget_t &target, ScenarioFrame_t &frame)
+{
+  MyMessage lv_msg;
+  UC payload[8];
+  UC len = 4;
+
+  lv_msg.build(theRadio.getAddress(), target.nodeID, 1, C_SET, V_RGBW, true);
+  payload[0] = target.hue.State;
+  payload[1] = target.hue.BR;
+  payload[2] = target.hue.CCT % 256;
+  payload[3] = target.hue.CCT / 256;
+  if( target.ringID != RING_ID_ALL || target.hue.R || target.hue.G || target.hue.B ) {
+    payload[4] = target.ringID;
+    payload[5] = target.hue.R;
+    payload[6] = target.hue.G;
+    payload[7] = target.hue.B;
+    len = 8;
+  }
+  lv_msg.set((void *)payload, len);
+
+  frame.len = HEADER_SIZE + lv_msg.getLength();
+  memcpy(frame.data, &lv_msg.msg, frame.len);
+}
+
+// Lay out the frames of all scenes in the pool, in slot order
+void ScenarioClass::CompileAll()
+{
+  m_usedFrames = 0;
+  m_compiledFor = theRadio.getAddress();
+  for( UC slot = 0; slot < SCN_MAX_SCENES; slot++ ) {
+    m_firstFrame[slot] = m_usedFrames;
+    m_nFrames[slot] = 0;
+    if( !m_scenes[slot].sceneID ) continue;
+    for( UC i = 0; i < m_scenes[slot].nTargets; i++ ) {
+      CompileTarget(m_scenes[slot].target[i], m_frames[m_usedFrames++]);
+      m_nFrames[slot]++;
+    }
+  }
+}
+
+BOOL ScenarioClass::SetScene(UC sceneID, const ScenarioTarget_t *targets, UC nTargets)
+{
+  if( sceneID == 0 || sceneID > SCN_MAX_ID || nTargets == 0 || nTargets > SCN_MAX_TARGETS ) return false;
+
+  UC slot = m_sceneIndex[sceneID];
+  if( slot == SCN_SLOT_NONE ) {
+    for( slot = 0; slot < SCN_MAX_SCENES; slot++ ) {
+      if( !m_scenes[slot].sceneID ) break;
+    }
+    if( slot >= SCN_MAX_SCENES ) return false;
+  }
+
+  // The frame pool must hold all scenes
+  US nFrames = 0;
+  for( UC i = 0; i < SCN_MAX_SCENES; i++ ) {
+    if( i != slot && m_scenes[i].sceneID ) nFrames += m_scenes[i].nTargets;
+  }
+  if( nFrames + nTargets > SCN_MAX_FRAMES ) return false;
+
+  m_scenes[slot].sceneID = sceneID;
+  m_scenes[slot].nTargets = nTargets;
+  memcpy(m_scenes[slot].target, targets, nTargets * sizeof(ScenarioTarget_t));
+  m_sceneIndex[sceneID] = slot;
+  CompileAll();
+  return true;
+}
+
+BOOL ScenarioClass::RemoveScene(UC sceneID)
+{
+  if( sceneID > SCN_MAX_ID || m_sceneIndex[sceneID] == SCN_SLOT_NONE ) return false;
+
+  memset(&m_scenes[m_sceneIndex[sceneID]], 0x00, sizeof(Scenario_t));
+  m_sceneIndex[sceneID] = SCN_SLOT_NONE;
+  CompileAll();
+  return true;
+}
+
+const Scenario_t *ScenarioClass::GetScene(UC sceneID)
+{
+  if( sceneID > SCN_MAX_ID || m_sceneIndex[sceneID] == SCN_SLOT_NONE ) return NULL;
+  return &m_scenes[m_sceneIndex[sceneID]];
+}
+
+SHORT ScenarioClass::Recall(UC sceneID)
+{
+  if( sceneID > SCN_MAX_ID || m_sceneIndex[sceneID] == SCN_SLOT_NONE ) return -1;
+
+  // Sender is baked into the frames
+  if( m_compiledFor != theRadio.getAddress() ) CompileAll();
+
+  UC slot = m_sceneIndex[sceneID];
+  MyMessage lv_msg;
+  SHORT nSent = 0;
+  for( UC i = 0; i < m_nFrames[slot]; i++ ) {
+    const ScenarioFrame_t &frame = m_frames[m_firstFrame[slot] + i];
+    memcpy(&lv_msg.msg, frame.data, frame.len);
+    if( theRadio.ProcessSend(&lv_msg) ) nSent++;
+  }
+  return nSent;
+}
+
+void ScenarioClass::print()
+{
+  SERIAL_LN("** Scenarios: %d frame(s) of %d compiled for node %d **", m_usedFrames, SCN_MAX_FRAMES, m_compiledFor);
+  for( UC slot = 0; slot < SCN_MAX_SCENES; slot++ ) {
+    const Scenario_t &scene = m_scenes[slot];
+    if( !scene.sceneID ) continue;
+    SERIAL_LN("  Scene %d: %d target(s)", scene.sceneID, scene.nTargets);
+    for( UC i = 0; i < scene.nTargets; i++ ) {
+      const ScenarioTarget_t &target = scene.target[i];
+      SERIAL_LN("    node:%d ring:%d [%d,%d,%d,%d,%d,%d]", target.nodeID, target.ringID,
+          target.hue.State, target.hue.BR, target.hue.CCT, target.hue.R, target.hue.G, target.hue.B);
+    }
+  }
+  SERIAL_LN("");
+}
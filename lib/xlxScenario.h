@@ -0,0 +1,85 @@
+//  xlxScenario.h - Xlight scenario store with precompiled RF frames
+
+#ifndef xlxScenario_h
+#define xlxScenario_h
+
+#include "xliCommon.h"
+#include "xlxConfig.h"
+#include "MyMessage.h"
+
+#define SCN_MAX_SCENES            8
+#define SCN_MAX_TARGETS           8           // lamp rings per scene
+#define SCN_MAX_FRAMES            (SCN_MAX_SCENES * 4)
+#define SCN_MAX_ID                63
+#define SCN_SLOT_NONE             0xFF
+
+// Built-in scenes, from the function buttons
+#define SCN_ID_FN1                1
+#define SCN_ID_FN2                2
+#define SCN_ID_FN3                3
+#define SCN_ID_FN4                4
+
+//------------------------------------------------------------------
+// Scenario Structures
+//------------------------------------------------------------------
+typedef struct
+{
+  UC nodeID;
+  UC ringID;                                // RING_ID_ALL or RING_ID_1..3
+  Hue_t hue;
+} ScenarioTarget_t;
+
+typedef struct
+{
+  UC sceneID;                               // 0 if the slot is free
+  UC nTargets;
+  ScenarioTarget_t target[SCN_MAX_TARGETS];
+} Scenario_t;
+
+// One V_RGBW message, exactly as it goes over the air
+typedef struct
+{
+  UC len;
+  UC data[MAX_MESSAGE_LENGTH];
+} ScenarioFrame_t;
+
+//------------------------------------------------------------------
+// Scenario Class
+//------------------------------------------------------------------
+// Scenes are compiled when they are set: every target becomes a ready-made
+// frame in a shared pool. Recall looks the scene up by ID, copies each frame
+// into a message and sends them back to back, no formatting or parsing.
+class ScenarioClass
+{
+private:
+  Scenario_t m_scenes[SCN_MAX_SCENES];
+  UC m_sceneIndex[SCN_MAX_ID + 1];          // scene ID -> slot
+  UC m_firstFrame[SCN_MAX_SCENES];
+  UC m_nFrames[SCN_MAX_SCENES];
+  ScenarioFrame_t m_frames[SCN_MAX_FRAMES];
+  UC m_usedFrames;
+  UC m_compiledFor;                         // our node ID when compiled
+
+  void CompileTarget(const ScenarioTarget_t &target, ScenarioFrame_t &frame);
+  void CompileAll();
+
+public:
+  ScenarioClass();
+
+  void InitScenes();
+  BOOL SetScene(UC sceneID, const ScenarioTarget_t *targets, UC nTargets);
+  BOOL RemoveScene(UC sceneID);
+  const Scenario_t *GetScene(UC sceneID);
+
+  // Send the frames of a scene, returns the number sent OK
+  SHORT Recall(UC sceneID);
+
+  void print();
+};
+
+//------------------------------------------------------------------
+// Function & Class Helper
+//------------------------------------------------------------------
+extern ScenarioClass theScenario;
+
+#endif /* xlxScenario_h */
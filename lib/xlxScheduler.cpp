@@ -0,0 +1,489 @@
+/**
+ * xlxScheduler.cpp - Xlight timer wheel and alarm schedules kept in MEM_SCHEDULE
+ *
+ * Created by Baoshi Sun <bs.sun@datatellit.com>
+ * Copyright (C) 2015-2016 DTIT
+ * Full contributor list:
+ *
+ * Documentation:
+ * Support Forum:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * REVISION HISTORY
+ * Version 1.0 - Created by Baoshi Sun <bs.sun@datatellit.com>
+ *
+ * DESCRIPTION
+ * 1. Timer wheel of 4 levels x 64 slots in seconds, O(1) add and cancel;
+ *    timers beyond the horizon are parked in the top level and re-placed
+ * 2. A schedule runs a rule action at hh:mm local time on some weekdays,
+ *    or once; the next occurrence is worked out in UTC with the time zone
+ *    and DST offset, and again whenever the time zone changes
+ * 3. A clock jump of more than an hour (e.g. the first Cloud time sync)
+ *    re-arms all schedules instead of firing everything in between
+ * 4. The table is kept in MEM_SCHEDULE with a CRC32, written with the
+ *    periodic config save and only the bytes that differ
+ * 5. Tick() runs from a once-a-second task, which IsDue() also wakes
+ *    as soon as the earliest timer's second comes; a cancelled timer
+ *    only leaves that one early wake-up behind
+ *
+ * ToDo:
+ * 1.
+ *
+**/
+
+#include "xlxScheduler.h"
+#include "xlxConfig.h"
+
+//------------------------------------------------------------------
+// the one and only instance of SchedulerClass
+SchedulerClass theScheduler;
+
+//------------------------------------------------------------------
+// Xlight Timer Wheel Class
+//------------------------------------------------------------------
+TimerWheelClass::TimerWheelClass()
+{
+  Reset(0);
+}
+
+void TimerWheelClass::Reset(UL now)
+{
+  memset(m_timers, 0x00, sizeof(m_timers));
+  memset(m_head, TWHEEL_NONE, sizeof(m_head));
+  m_now = now;
+  m_count = 0;
+}
+
+// Put an active timer in the slot matching its distance from m_now.
+/// A cascade runs before the current second's slot is served, so a timer
+/// it brings down that is due now goes there; anywhere else that slot is
+/// done with and due now means the next second.
+void TimerWheelClass::Link(UC timer, BOOL cascading)
+{
+  WheelTimer_t &t = m_timers[timer];
+  UL delta = t.expires - m_now;
+  UC level, index;
+
+  if( delta == 0 && cascading ) {
+    level = 0;
+    index = m_now & TWHEEL_MASK;
+  } else if( (LONG)delta <= 0 ) {
+    // Overdue, next second
+    level = 0;
+    index = (m_now + 1) & TWHEEL_MASK;
+  } else if( delta >= TWHEEL_HORIZON ) {
+    // Park as far as the wheel goes, re-placed when it gets there
+    level = TWHEEL_LEVELS - 1;
+    index = ((m_now + TWHEEL_HORIZON - 1) >> ((TWHEEL_LEVELS - 1) * TWHEEL_BITS)) & TWHEEL_MASK;
+  } else {
+    level = 0;
+    while( delta >= (1UL << ((level + 1) * TWHEEL_BITS)) ) level++;
+    index = (t.expires >> (level * TWHEEL_BITS)) & TWHEEL_MASK;
+  }
+
+  t.slot = level * TWHEEL_SLOTS + index;
+  t.prev = TWHEEL_NONE;
+  t.next = m_head[t.slot];
+  if( t.next != TWHEEL_NONE ) m_timers[t.next].prev = timer;
+  m_head[t.slot] = timer;
+}
+
+void TimerWheelClass::Unlink(UC timer)
+{
+  WheelTimer_t &t = m_timers[timer];
+  if( t.prev != TWHEEL_NONE ) m_timers[t.prev].next = t.next;
+  else m_head[t.slot] = t.next;
+  if( t.next != TWHEEL_NONE ) m_timers[t.next].prev = t.prev;
+  t.next = t.prev = TWHEEL_NONE;
+}
+
+// Move the timers of the current slot of a level down the wheel
+void TimerWheelClass::Cascade(UC level)
+{
+  UC slot = level * TWHEEL_SLOTS + ((m_now >> (level * TWHEEL_BITS)) & TWHEEL_MASK);
+  UC timer = m_head[slot];
+  m_head[slot] = TWHEEL_NONE;
+  while( timer != TWHEEL_NONE ) {
+    UC next = m_timers[timer].next;
+    Link(timer, true);
+    timer = next;
+  }
+}
+
+// Clock jumped too far to step through, place everything afresh
+void TimerWheelClass::Rebuild(UL now)
+{
+  memset(m_head, TWHEEL_NONE, sizeof(m_head));
+  m_now = now;
+  for( UC timer = 0; timer < TWHEEL_MAX_TIMERS; timer++ ) {
+    if( m_timers[timer].active ) Link(timer);
+  }
+}
+
+UC TimerWheelClass::Add(UL expires, UL period, TimerCallback_t callback, US arg)
+{
+  for( UC timer = 0; timer < TWHEEL_MAX_TIMERS; timer++ ) {
+    WheelTimer_t &t = m_timers[timer];
+    if( t.active ) continue;
+    t.expires = expires;
+    t.period = period;
+    t.callback = callback;
+    t.arg = arg;
+    t.active = true;
+    Link(timer);
+    m_count++;
+    return timer;
+  }
+  return TWHEEL_NONE;
+}
+
+BOOL TimerWheelClass::Cancel(UC timer)
+{
+  if( !IsActive(timer) ) return false;
+  Unlink(timer);
+  m_timers[timer].active = false;
+  m_count--;
+  return true;
+}
+
+US TimerWheelClass::Advance(UL now)
+{
+  LONG delta = (LONG)(now - m_now);
+  if( delta <= 0 ) {
+    if( delta < 0 ) Rebuild(now);
+    return 0;
+  }
+  if( m_count == 0 ) {
+    m_now = now;
+    return 0;
+  }
+  // Overdue ones go to the next second
+  if( (UL)delta >= TWHEEL_HORIZON ) Rebuild(now - 1);
+
+  US nExpired = 0;
+  while( m_now != now ) {
+    m_now++;
+    for( UC level = 1; level < TWHEEL_LEVELS; level++ ) {
+      if( m_now & ((1UL << (level * TWHEEL_BITS)) - 1) ) break;
+      Cascade(level);
+    }
+
+    // One at a time, a callback may add or cancel timers
+    UC slot = m_now & TWHEEL_MASK;
+    UC timer;
+    while( (timer = m_head[slot]) != TWHEEL_NONE ) {
+      WheelTimer_t &t = m_timers[timer];
+      Unlink(timer);
+      if( (LONG)(t.expires - m_now) > 0 ) {
+        // Parked beyond the horizon, not due yet
+        Link(timer);
+        continue;
+      }
+
+      if( t.period ) {
+        t.expires += t.period;
+        Link(timer);
+      } else {
+        t.active = false;
+        m_count--;
+      }
+      nExpired++;
+      if( t.callback ) (*t.callback)(timer, t.arg);
+    }
+  }
+  return nExpired;
+}
+
+UL TimerWheelClass::NextExpiry()
+{
+  UL next = m_now + TWHEEL_HORIZON;
+  if( m_count == 0 ) return next;
+
+  // Level 0 slots are exact, higher levels give the time of their cascade
+  for( UC level = 0; level < TWHEEL_LEVELS; level++ ) {
+    UC shift = level * TWHEEL_BITS;
+    for( UC k = 1; k <= TWHEEL_SLOTS; k++ ) {
+      UL at = ((m_now >> shift) + k) << shift;
+      if( (LONG)(at - next) >= 0 ) break;
+      if( m_head[level * TWHEEL_SLOTS + ((at >> shift) & TWHEEL_MASK)] != TWHEEL_NONE ) {
+        next = at;
+        break;
+      }
+    }
+  }
+  return next;
+}
+
+//------------------------------------------------------------------
+// Xlight Scheduler Class
+//------------------------------------------------------------------
+SchedulerClass::SchedulerClass()
+{
+  memset(m_table, 0x00, sizeof(m_table));
+  memset(m_timer, TWHEEL_NONE, sizeof(m_timer));
+  m_nextDue = 0;
+  m_isChanged = false;
+}
+
+void SchedulerClass::OnTimer(UC timer, US arg)
+{
+  Schedule_t &entry = theScheduler.m_table[arg];
+  theScheduler.m_timer[arg] = TWHEEL_NONE;
+  SERIAL_LN("Schedule %d due", entry.id);
+
+  RuleAction_t action = entry.action;
+  if( entry.flags & SCHED_FLAG_ONESHOT ) {
+    memset(&entry, 0x00, sizeof(entry));
+    theScheduler.m_isChanged = true;
+  } else {
+    theScheduler.Arm(arg);
+  }
+  theRules.Execute(action);
+}
+
+void SchedulerClass::Arm(UC row)
+{
+  m_wheel.Cancel(m_timer[row]);
+  m_timer[row] = TWHEEL_NONE;
+
+  const Schedule_t &entry = m_table[row];
+  if( !entry.id || !(entry.flags & SCHED_FLAG_ENABLED) ) return;
+
+  UL at = entry.at;
+  if( !(entry.flags & SCHED_FLAG_ONESHOT) ) {
+    at = NextOccurrence(entry.hour, entry.minute, entry.weekdays, Time.now(),
+        (LONG)theConfig.GetTimeZoneDSTOffset() * 60);
+  }
+  m_timer[row] = m_wheel.Add(at, 0, OnTimer, row);
+  m_nextDue = m_wheel.NextExpiry();
+}
+
+void SchedulerClass::Rearm()
+{
+  m_wheel.Reset(Time.now());
+  memset(m_timer, TWHEEL_NONE, sizeof(m_timer));
+  for( UC row = 0; row < SCHED_MAX_ENTRIES; row++ ) Arm(row);
+  m_nextDue = m_wheel.NextExpiry();
+}
+
+SHORT SchedulerClass::FindRow(UC id, BOOL add)
+{
+  SHORT freeRow = -1;
+  for( UC row = 0; row < SCHED_MAX_ENTRIES; row++ ) {
+    if( m_table[row].id == id ) return row;
+    if( freeRow < 0 && !m_table[row].id ) freeRow = row;
+  }
+  return (add ? freeRow : -1);
+}
+
+BOOL SchedulerClass::Load()
+{
+  memset(m_table, 0x00, sizeof(m_table));
+  if( sizeof(ScheduleHeader_t) + sizeof(m_table) > MEM_SCHEDULE_LEN ) {
+    SERIAL_LN(F("Failed to load Schedules, too large."));
+    return false;
+  }
+
+  ScheduleHeader_t hdr;
+  EEPROM.get(MEM_SCHEDULE_OFFSET, hdr);
+  if( hdr.magic == SCHED_MAGIC && hdr.len == sizeof(m_table) ) {
+    UC *data = (UC *)m_table;
+    for( US i = 0; i < sizeof(m_table); i++ )
+      data[i] = EEPROM.read(MEM_SCHEDULE_OFFSET + sizeof(hdr) + i);
+    if( CalcCRC32(m_table, sizeof(m_table)) != hdr.crc ) {
+      memset(m_table, 0x00, sizeof(m_table));
+    }
+  }
+  m_isChanged = false;
+  Rearm();
+
+  UC nEntries = 0;
+  for( UC row = 0; row < SCHED_MAX_ENTRIES; row++ ) {
+    if( m_table[row].id ) nEntries++;
+  }
+  SERIAL_LN("Schedules loaded, %d entries.", nEntries);
+  return true;
+}
+
+// Table first, then the header that vouches for it
+BOOL SchedulerClass::Save()
+{
+  if( !m_isChanged ) return false;
+
+  ScheduleHeader_t hdr;
+  hdr.magic = SCHED_MAGIC;
+  hdr.len = sizeof(m_table);
+  hdr.crc = CalcCRC32(m_table, sizeof(m_table));
+
+  US addr = MEM_SCHEDULE_OFFSET + sizeof(hdr);
+  const UC *data = (const UC *)m_table;
+  for( US i = 0; i < sizeof(m_table); i++ ) {
+    if( EEPROM.read(addr + i) != data[i] ) EEPROM.write(addr + i, data[i]);
+  }
+  data = (const UC *)&hdr;
+  for( US i = 0; i < sizeof(hdr); i++ ) {
+    if( EEPROM.read(MEM_SCHEDULE_OFFSET + i) != data[i] ) EEPROM.write(MEM_SCHEDULE_OFFSET + i, data[i]);
+  }
+
+  m_isChanged = false;
+  SERIAL_LN("Schedules saved.");
+  return true;
+}
+
+BOOL SchedulerClass::SetSchedule(UC id, UC hour, UC minute, UC weekdays, const RuleAction_t &action)
+{
+  SHORT row = FindRow(id, true);
+  if( id == 0 || row < 0 || hour > 23 || minute > 59 ) return false;
+
+  Schedule_t &entry = m_table[row];
+  entry.id = id;
+  entry.flags = SCHED_FLAG_ENABLED;
+  entry.weekdays = (weekdays & SCHED_EVERYDAY ? weekdays & SCHED_EVERYDAY : SCHED_EVERYDAY);
+  entry.hour = hour;
+  entry.minute = minute;
+  entry.at = 0;
+  entry.action = action;
+  m_isChanged = true;
+  Arm(row);
+  return true;
+}
+
+BOOL SchedulerClass::SetOnce(UC id, UC hour, UC minute, const RuleAction_t &action)
+{
+  if( !SetSchedule(id, hour, minute, SCHED_EVERYDAY, action) ) return false;
+
+  UC row = FindRow(id);
+  Schedule_t &entry = m_table[row];
+  entry.flags |= SCHED_FLAG_ONESHOT;
+  entry.at = NextOccurrence(hour, minute, SCHED_EVERYDAY, Time.now(), (LONG)theConfig.GetTimeZoneDSTOffset() * 60);
+  return true;
+}
+
+BOOL SchedulerClass::Remove(UC id)
+{
+  SHORT row = FindRow(id);
+  if( id == 0 || row < 0 ) return false;
+
+  m_wheel.Cancel(m_timer[row]);
+  m_timer[row] = TWHEEL_NONE;
+  memset(&m_table[row], 0x00, sizeof(Schedule_t));
+  m_isChanged = true;
+  return true;
+}
+
+void SchedulerClass::Tick()
+{
+  UL now = Time.now();
+  LONG delta = (LONG)(now - m_wheel.GetNow());
+  if( delta > 3600 || delta < -3600 ) {
+    // Clock was set, work the schedules out again
+    Rearm();
+  } else {
+    m_wheel.Advance(now);
+    m_nextDue = m_wheel.NextExpiry();
+  }
+}
+
+UL SchedulerClass::NextOccurrence(UC hour, UC minute, UC weekdays, UL nowUtc, LONG offsetSec)
+{
+  if( !(weekdays & SCHED_EVERYDAY) ) weekdays = SCHED_EVERYDAY;
+  UL local = nowUtc + offsetSec;
+  UL day = local / 86400;
+  UL tod = (UL)hour * 3600 + (UL)minute * 60;
+  for( UC k = 0; k <= 7; k++ ) {
+    UL at = (day + k) * 86400 + tod;
+    if( at <= local ) continue;
+    // 1970-01-01 was a Thursday
+    if( weekdays & (1 << ((day + k + 4) % 7)) ) return at - offsetSec;
+  }
+  return nowUtc;
+}
+
+//------------------------------------------------------------------
+// Self-test with a virtual clock
+//------------------------------------------------------------------
+static TimerWheelClass *stWheel;
+static UL stExpected[16];
+static UL stFired[16];
+static UC stFireCount[16];
+static US stFailed;
+
+static void selfTestCallback(UC timer, US arg)
+{
+  UL now = stWheel->GetNow();
+  if( stFired[arg] && now - stFired[arg] != 7 ) stFailed++;   // periodic one
+  if( !stFired[arg] && now != stExpected[arg] ) stFailed++;
+  stFired[arg] = now;
+  stFireCount[arg]++;
+}
+
+US SchedulerClass::SelfTest()
+{
+  const UL base = 1000;
+  // 88, 3096, 4120 and 265240 expire on 64 and 4096 second boundaries,
+  /// where they come down a level in the same second they are due
+  const UL offsets[] = { 1, 88, 63, 64, 65, 100, 4095, 4096, 4120, 70000, 262143, 262144, 300000,
+      3096, 265240, 9 };
+  const UC nTimers = sizeof(offsets) / sizeof(offsets[0]);
+
+  TimerWheelClass wheel;
+  stWheel = &wheel;
+  stFailed = 0;
+  memset(stFired, 0x00, sizeof(stFired));
+  memset(stFireCount, 0x00, sizeof(stFireCount));
+
+  wheel.Reset(base);
+  UC timers[16];
+  for( UC i = 0; i < nTimers; i++ ) {
+    stExpected[i] = base + offsets[i];
+    // the last one repeats every 7 seconds
+    timers[i] = wheel.Add(stExpected[i], (i == nTimers - 1 ? 7 : 0), selfTestCallback, i);
+  }
+  wheel.Cancel(timers[5]);
+  if( wheel.NextExpiry() != base + 1 ) stFailed++;
+
+  // Uneven steps of the virtual clock
+  UL now = base, seed = 12345;
+  while( now < base + 300100 ) {
+    seed = seed * 1103515245 + 12345;
+    now += 1 + (seed >> 16) % 600;
+    wheel.Advance(now);
+  }
+
+  for( UC i = 0; i < nTimers - 1; i++ ) {
+    if( stFireCount[i] != (i == 5 ? 0 : 1) ) stFailed++;
+  }
+  if( stFireCount[nTimers - 1] == 0 ) stFailed++;
+  wheel.Cancel(timers[nTimers - 1]);
+  if( wheel.GetCount() != 0 ) stFailed++;
+
+  // 2016-06-01 00:00 UTC is a Wednesday, 08:00 in UTC+8
+  const UL wed = 1464739200UL;
+  const LONG utc8 = 8 * 3600;
+  if( NextOccurrence(8, 0, SCHED_EVERYDAY, wed, utc8) != wed + 86400 ) stFailed++;
+  if( NextOccurrence(8, 1, SCHED_EVERYDAY, wed, utc8) != wed + 60 ) stFailed++;
+  if( NextOccurrence(8, 0, 0x02, wed, utc8) != wed + 5 * 86400 ) stFailed++;      // Monday
+  if( NextOccurrence(7, 0, 0x08, wed, utc8) != wed + 7 * 86400 - 3600 ) stFailed++;  // Wednesday
+
+  return stFailed;
+}
+
+void SchedulerClass::print()
+{
+  UL now = Time.now();
+  SERIAL_LN("** Schedules: %d timer(s), next due in %lus **", m_wheel.GetCount(), m_wheel.NextExpiry() - now);
+  for( UC row = 0; row < SCHED_MAX_ENTRIES; row++ ) {
+    const Schedule_t &entry = m_table[row];
+    if( !entry.id ) continue;
+    SERIAL_LN("  %c%d: %02d:%02d %s days:0x%02X action %d(%d,%d,%d), in %lds", CLS_SCHEDULE, entry.id,
+        entry.hour, entry.minute, (entry.flags & SCHED_FLAG_ONESHOT) ? "once" : "every",
+        entry.weekdays, entry.action.type, entry.action.target, entry.action.param1, entry.action.param2,
+        m_wheel.IsActive(m_timer[row]) ? (LONG)(m_wheel.GetExpires(m_timer[row]) - now) : -1L);
+  }
+  SERIAL_LN("");
+}
@@ -0,0 +1,152 @@
+//  xlxScheduler.h - Xlight timer wheel and alarm schedules kept in MEM_SCHEDULE
+
+#ifndef xlxScheduler_h
+#define xlxScheduler_h
+
+#include "xliCommon.h"
+#include "xliMemoryMap.h"
+#include "xlxRuleEngine.h"
+
+// Timer wheel: 4 levels of 64 slots, 1s / 64s / 68min / 3days per slot
+#define TWHEEL_LEVELS             4
+#define TWHEEL_BITS               6
+#define TWHEEL_SLOTS              (1 << TWHEEL_BITS)
+#define TWHEEL_MASK               (TWHEEL_SLOTS - 1)
+#define TWHEEL_HORIZON            (1UL << (TWHEEL_LEVELS * TWHEEL_BITS))   // ~194 days
+#define TWHEEL_MAX_TIMERS         16
+#define TWHEEL_NONE               0xFF
+
+// Schedules
+#define SCHED_MAX_ENTRIES         10
+#define SCHED_MAGIC               0x4153      // "SA"
+#define SCHED_FLAG_ENABLED        0x01
+#define SCHED_FLAG_ONESHOT        0x02
+#define SCHED_EVERYDAY            0x7F        // weekday bits, Sunday = bit 0
+
+// Expiry callback: timer index and the argument given to Add()
+typedef void (*TimerCallback_t)(UC timer, US arg);
+
+//------------------------------------------------------------------
+// Timer Wheel Structures
+//------------------------------------------------------------------
+typedef struct
+{
+  UL expires;                               // seconds, same clock as Advance()
+  UL period;                                // 0 for one-shot
+  TimerCallback_t callback;
+  US arg;
+  UC next;
+  UC prev;
+  UC slot;                                  // level * TWHEEL_SLOTS + index
+  BOOL active;
+} WheelTimer_t;
+
+//------------------------------------------------------------------
+// Timer Wheel Class
+//------------------------------------------------------------------
+// Hierarchical wheel: a timer sits in the level whose slot size matches
+// how far away it is, and moves down a level each time the level below
+// wraps around. Add and Cancel unlink or link a list node, O(1); each
+// second advanced touches one slot, plus a cascade every 64 seconds.
+// The clock is whatever Advance() is fed, so tests can drive a virtual one.
+class TimerWheelClass
+{
+private:
+  WheelTimer_t m_timers[TWHEEL_MAX_TIMERS];
+  UC m_head[TWHEEL_LEVELS * TWHEEL_SLOTS];
+  UL m_now;
+  UC m_count;
+
+  void Link(UC timer, BOOL cascading = false);
+  void Unlink(UC timer);
+  void Cascade(UC level);
+  void Rebuild(UL now);
+
+public:
+  TimerWheelClass();
+
+  void Reset(UL now);
+  // Returns the timer index or TWHEEL_NONE if the pool is full
+  UC Add(UL expires, UL period, TimerCallback_t callback, US arg);
+  BOOL Cancel(UC timer);
+  BOOL IsActive(UC timer) { return (timer < TWHEEL_MAX_TIMERS && m_timers[timer].active); }
+  UL GetExpires(UC timer) { return m_timers[timer].expires; }
+
+  // Run every timer due up to now, returns how many expired
+  US Advance(UL now);
+  // Earliest time something may be due, now + TWHEEL_HORIZON if idle
+  UL NextExpiry();
+
+  UL GetNow() { return m_now; }
+  UC GetCount() { return m_count; }
+};
+
+//------------------------------------------------------------------
+// Schedule Structures
+//------------------------------------------------------------------
+typedef struct
+{
+  UC id;                                    // 0 if the entry is free
+  UC flags;                                 // SCHED_FLAG_*
+  UC weekdays;                              // bit per day, Sunday = bit 0
+  UC hour;                                  // local time
+  UC minute;
+  UL at;                                    // one-shot: UTC time
+  RuleAction_t action;
+} Schedule_t;
+
+typedef struct
+{
+  US magic;
+  US len;
+  UL crc;                                   // CRC32 of the table
+} ScheduleHeader_t;
+
+//------------------------------------------------------------------
+// Scheduler Class
+//------------------------------------------------------------------
+class SchedulerClass
+{
+private:
+  Schedule_t m_table[SCHED_MAX_ENTRIES];
+  UC m_timer[SCHED_MAX_ENTRIES];            // wheel timer of each entry
+  TimerWheelClass m_wheel;
+  UL m_nextDue;                             // wheel's NextExpiry(), may be early but never late
+  BOOL m_isChanged;
+
+  static void OnTimer(UC timer, US arg);
+  void Arm(UC row);
+  SHORT FindRow(UC id, BOOL add = false);
+
+public:
+  SchedulerClass();
+
+  BOOL Load();
+  BOOL Save();
+
+  // Recurring at hh:mm local time on the given weekdays
+  BOOL SetSchedule(UC id, UC hour, UC minute, UC weekdays, const RuleAction_t &action);
+  // Once, at the next hh:mm local time
+  BOOL SetOnce(UC id, UC hour, UC minute, const RuleAction_t &action);
+  BOOL Remove(UC id);
+  // Time zone or clock changed
+  void Rearm();
+
+  void Tick();
+  // Something on the wheel is due, Tick() is wanted now
+  BOOL IsDue() { return (LONG)(Time.now() - m_nextDue) >= 0; }
+
+  // Next local hh:mm on the weekdays after nowUtc, as UTC
+  static UL NextOccurrence(UC hour, UC minute, UC weekdays, UL nowUtc, LONG offsetSec);
+  // Virtual clock self-test of the wheel, returns the number of failures
+  static US SelfTest();
+
+  void print();
+};
+
+//------------------------------------------------------------------
+// Function & Class Helper
+//------------------------------------------------------------------
+extern SchedulerClass theScheduler;
+
+#endif /* xlxScheduler_h */
@@ -46,6 +46,19 @@
 #include "xlxASRInterface.h"
 #include "xlxConfig.h"
 #include "xlxRF24Client.h"
+#include "xlxNodeList.h"
+#include "xlxOfflineCache.h"
+#include "xlxScenario.h"
+#include "xlxRuleEngine.h"
+#include "xlxScheduler.h"
+#include "xlxStatistics.h"
+#include "xlxProfiler.h"
+#include "xlxTaskList.h"
+#include "xlxNetProbe.h"
+#include "xlxConnManager.h"
+#include "xlxRFBench.h"
+#include "xlxLogger.h"
+#include "xlxCloudPublisher.h"
 
 //------------------------------------------------------------------
 // the one and only instance of SerialConsoleClass
@@ -98,7 +111,7 @@ typedef enum
 
 /// Matrix: actual definition for command/handler array
 const StateMachine_t fsmMain[] = {
-  // Current-State    Next-State      Event-String        Function
+  // Current-State    Next-State      Event-String        Function            Flags
   {consoleRoot,       consoleRoot,    "?",                gc_doHelp},
   {consoleRoot,       consoleRoot,    "help",             gc_doHelp},
   {consoleRoot,       consoleRoot,    "check",            gc_doCheck},
@@ -113,14 +126,14 @@ const StateMachine_t fsmMain[] = {
   {consoleRoot,       consoleRoot,    "",                 gc_doHelp},
 
   /// Shared function
-  {consoleSys,        consoleRoot,    "reset",            gc_doSysSub},
-  {consoleSys,        consoleRoot,    "safe",             gc_doSysSub},
-  {consoleSys,        consoleRoot,    "dfu",              gc_doSysSub},
-  {consoleSys,        consoleRoot,    "update",           gc_doSysSub},
+  {consoleSys,        consoleRoot,    "reset",            gc_doSysSub,        SERIALCOMMAND_EXACT},
+  {consoleSys,        consoleRoot,    "safe",             gc_doSysSub,        SERIALCOMMAND_EXACT},
+  {consoleSys,        consoleRoot,    "dfu",              gc_doSysSub,        SERIALCOMMAND_EXACT},
+  {consoleSys,        consoleRoot,    "update",           gc_doSysSub,        SERIALCOMMAND_EXACT},
   {consoleSys,        consoleRoot,    "sync",             gc_doSysSub},
-  {consoleSys,        consoleRoot,    "clear",            gc_doSysSub},
-  {consoleSys,        consoleRoot,    "base",             gc_doSysSub},
-  {consoleSys,        consoleRoot,    "private",          gc_doSysSub},
+  {consoleSys,        consoleRoot,    "clear",            gc_doSysSub,        SERIALCOMMAND_EXACT},
+  {consoleSys,        consoleRoot,    "base",             gc_doSysSub,        SERIALCOMMAND_EXACT},
+  {consoleSys,        consoleRoot,    "private",          gc_doSysSub,        SERIALCOMMAND_EXACT},
   {consoleSys,        consoleRoot,    "serial",           gc_doSysSub},
   /// Workflow
   {consoleSys,        consoleWF_YesNo,   "setup",         gc_doSysSetupWiFi},
@@ -167,10 +180,13 @@ void SerialConsoleClass::Init()
 
 bool SerialConsoleClass::processCommand()
 {
+  // Replies are written in full, however long
+  theOutput.BeginReply();
   bool retVal = readSerial();
   if( !retVal ) {
     SERIAL_LN(F("Unknown command or incorrect arguments\n\r"));
   }
+  theOutput.EndReply();
 
   return retVal;
 }
@@ -199,26 +215,37 @@ bool SerialConsoleClass::showThisHelp(String &strTopic)
     SERIAL_LN(F("   flash: check flash space"));
     SERIAL_LN(F("   rf:    check RF availability"));
     SERIAL_LN(F("   wifi:  check Wi-Fi module status"));
-    SERIAL_LN(F("   wlan:  check internet status"));
+    SERIAL_LN(F("   wlan:  check internet status, and probe again"));
     SERIAL_LN(F("e.g. check rf\n\r"));
     CloudOutput(F("check ble|flash|rf|wifi|wlan"));
   } else if(strTopic.equals("show")) {
     SERIAL_LN(F("--- Command: show <object> ---"));
     SERIAL_LN(F("To show value or summary information, where <object> could be:"));
     SERIAL_LN(F("   ble:     show BLE summary"));
+    SERIAL_LN(F("   boot:    show boot phases and their timestamps"));
+    SERIAL_LN(F("   cloud:   show the Cloud publish queue and counters"));
+    SERIAL_LN(F("   conn:    show Wi-Fi and Cloud connection states and timing"));
     SERIAL_LN(F("   debug:   show debug channel and level"));
     SERIAL_LN(F("   dev:     show device list"));
     SERIAL_LN(F("   flag:    show system flags"));
     SERIAL_LN(F("   net:     show network summary"));
     SERIAL_LN(F("   node:    show node summary"));
+    SERIAL_LN(F("   log:     show log levels and the records not yet printed"));
     SERIAL_LN(F("   nlist:   show NodeID list"));
-    SERIAL_LN(F("   rf:      print RF details"));
+    SERIAL_LN(F("   offline: show commands cached while the link is down"));
+    SERIAL_LN(F("   perf:    show main loop timing (min/p50/p99/max) and boot phases"));
+    SERIAL_LN(F("   rf:      print RF details and worker queues"));
+    SERIAL_LN(F("   rule:    show rules"));
+    SERIAL_LN(F("   scene:   show scenarios"));
+    SERIAL_LN(F("   sched:   show alarm schedules"));
+    SERIAL_LN(F("   stats [hours|dump]: show counters, totals of the last hours, or all records"));
     SERIAL_LN(F("   time:    show current time and time zone"));
     SERIAL_LN(F("   var:     show system variables"));
     SERIAL_LN(F("   table:   show working memory tables"));
+    SERIAL_LN(F("   task:    show main loop tasks"));
     SERIAL_LN(F("   version: show firmware version"));
     SERIAL_LN(F("e.g. show rf\n\r"));
-    CloudOutput(F("show ble|debug|dev|flag|net|node|rf|time|var|table|version"));
+    CloudOutput(F("show ble|cloud|debug|dev|flag|net|node|rf|time|var|table|version"));
   } else if(strTopic.equals("ping")) {
     SERIAL_LN(F("--- Command: ping <address> ---"));
     SERIAL_LN(F("To ping an IP or domain name, default address is 8.8.8.8"));
@@ -230,16 +257,28 @@ bool SerialConsoleClass::showThisHelp(String &strTopic)
     SERIAL_LN(F("To execute action, e.g. turn on the lamp"));
     SERIAL_LN(F("e.g. do on"));
     SERIAL_LN(F("e.g. do off"));
-    SERIAL_LN(F("e.g. do color R,G,B\n\r"));
-    CloudOutput(F("do on|off|color"));
+    SERIAL_LN(F("e.g. do color R,G,B"));
+    SERIAL_LN(F("e.g. do scene 2\n\r"));
+    CloudOutput(F("do on|off|color|scene"));
   } else if(strTopic.equals("test")) {
     SERIAL_LN(F("--- Command: test <action parameters> ---"));
     SERIAL_LN(F("To perform testing, where <action> could be:"));
     SERIAL_LN(F("   ping <ip address>: ping ip address"));
     SERIAL_LN(F("   send <NodeId:MessageId>: send test message to node"));
     SERIAL_LN(F("   send <message>: send MySensors format message"));
-    SERIAL_LN(F("   asr <cmd>: send command to ASR module\n\r"));
-    CloudOutput(F("test ping|send"));
+    SERIAL_LN(F("   asr <cmd>: send command to ASR module"));
+    SERIAL_LN(F("   json [rounds]: measure JSON parser throughput"));
+    SERIAL_LN(F("   json num: parse and print numbers with long fractions"));
+    SERIAL_LN(F("   json cfg: check the config & device status JSON schemas"));
+    SERIAL_LN(F("   json mem: show JSON buffer bytes per node, legacy modelled"));
+    SERIAL_LN(F("   rules [count]: measure rule evaluation per event, on a separate rule table"));
+    SERIAL_LN(F("   sched: run the timer wheel self-test on a virtual clock"));
+    SERIAL_LN(F("   rfq [count]: pass numbers from the RF worker thread through a queue"));
+    SERIAL_LN(F("   flood [count] [to=<nodes>] [rate=<n/s>] [ack=radio|app] [retry=<n>]"));
+    SERIAL_LN(F("         [msg=<MessageId:Payload>] [loop[=<loss %>]]: send messages in the"));
+    SERIAL_LN(F("         background and report throughput, e.g. test flood 1000 to=1-3 rate=50"));
+    SERIAL_LN(F("   flood [stop]: show or stop the flood test\n\r"));
+    CloudOutput(F("test ping|send|asr|json|rules|sched|rfq|flood"));
   } else if(strTopic.equals("send")) {
     SERIAL_LN(F("--- Command: send <message> or <NodeId:MessageId> ---"));
     SERIAL_LN(F("To send testing message"));
@@ -276,6 +315,44 @@ bool SerialConsoleClass::showThisHelp(String &strTopic)
         SERIAL_LN(F("--- Command: set cloud [0|1|2] ---"));
         SERIAL_LN(F("To disable, enable or require cloud"));
         CloudOutput(F("set cloud 0|1|2"));
+      } else if (strnicmp(sObj, "rule", 4) == 0) {
+        SERIAL_LN(F("--- Command: set rule <id> <condition> then <action> ---"));
+        SERIAL_LN(F("<condition>: postfix, operands s0..s15 (sensors), time, event, number or hh:mm"));
+        SERIAL_LN(F("             operators == != < > <= >= && || !"));
+        SERIAL_LN(F("<action>: on <node>, off <node>, brcct <node> <br> <cct>, scene <id>"));
+        SERIAL_LN(F("e.g. set rule 1 s1 30 < time 18:00 >= && then on 1"));
+        SERIAL_LN(F("     , turn lamp 1 on when it's dark after 6pm"));
+        SERIAL_LN(F("e.g. set rule 1 del"));
+        CloudOutput(F("set rule <id> <condition> then <action>"));
+      } else if (strnicmp(sObj, "sched", 5) == 0) {
+        SERIAL_LN(F("--- Command: set sched <id> <hh:mm> <days> <action> ---"));
+        SERIAL_LN(F("<days>: daily, once, or weekday digits 0..6 with Sunday as 0"));
+        SERIAL_LN(F("<action>: on <node>, off <node>, brcct <node> <br> <cct>, scene <id>"));
+        SERIAL_LN(F("e.g. set sched 1 07:30 12345 on 1"));
+        SERIAL_LN(F("     , turn lamp 1 on at 7:30 on weekdays"));
+        SERIAL_LN(F("e.g. set sched 2 23:00 once scene 1"));
+        SERIAL_LN(F("e.g. set sched 1 del"));
+        CloudOutput(F("set sched <id> <hh:mm> <days> <action>"));
+      } else if (strnicmp(sObj, "output", 6) == 0) {
+        SERIAL_LN(F("--- Command: set output [0|1] ---"));
+        SERIAL_LN(F("To make console output blocking or non-blocking"));
+        SERIAL_LN(F("Non-blocking output drops what the serial port can't take,"));
+        SERIAL_LN(F("except command replies, which are always written in full"));
+        CloudOutput(F("set output 0|1"));
+      } else if (strnicmp(sObj, "log", 3) == 0) {
+        SERIAL_LN(F("--- Command: set log [module] <level> | direct [0|1] ---"));
+        SERIAL_LN(F("To filter the log, <module> is sys|rf|dev|net, all if left out"));
+        SERIAL_LN(F("<level> is off|error|warn|info|debug, or 0..4"));
+        SERIAL_LN(F("Log lines are printed when the port has time, direct 1 prints them at once"));
+        SERIAL_LN(F("e.g. set log rf warn"));
+        SERIAL_LN(F("e.g. set log direct 1"));
+        CloudOutput(F("set log [module] <level>|direct 0|1"));
+      } else if (strnicmp(sObj, "raw", 3) == 0) {
+        SERIAL_LN(F("--- Command: set raw [0|1] ---"));
+        SERIAL_LN(F("To paste a script: lines run one by one without echo"));
+        SERIAL_LN(F("Blank lines and lines starting with # are skipped"));
+        SERIAL_LN(F("Ctrl-D or 'set raw 0' ends it"));
+        CloudOutput(F("set raw 0|1"));
       }
     } else {
       SERIAL_LN(F("--- Command: set <object value> ---"));
@@ -300,10 +377,22 @@ bool SerialConsoleClass::showThisHelp(String &strTopic)
       SERIAL_LN(F("     , to set value of variable, use '? set var' for detail"));
       SERIAL_LN(F("e.g. set cloud [0|1|2]"));
       SERIAL_LN(F("     , cloud option disable|enable|must"));
+      SERIAL_LN(F("e.g. set output [0|1]"));
+      SERIAL_LN(F("     , console output blocking|non-blocking"));
+      SERIAL_LN(F("e.g. set log [module] <level>"));
+      SERIAL_LN(F("     , log level per module, use '? set log' for detail"));
+      SERIAL_LN(F("e.g. set raw [0|1]"));
+      SERIAL_LN(F("     , console input for pasted scripts, use '? set raw' for detail"));
+      SERIAL_LN(F("set rule <id> <condition> then <action>"));
+      SERIAL_LN(F("     , to add or replace a rule, use '? set rule' for detail"));
+      SERIAL_LN(F("set sched <id> <hh:mm> <days> <action>"));
+      SERIAL_LN(F("     , to add or replace an alarm, use '? set sched' for detail"));
+      SERIAL_LN(F("e.g. set perf reset"));
+      SERIAL_LN(F("     , to clear the profiler histograms"));
       SERIAL_LN(F("e.g. set debug [log:level]"));
       SERIAL_LN(F("     , where log is [serial|flash|syslog|cloud|all"));
       SERIAL_LN(F("     and level is [none|alter|critical|error|warn|notice|info|debug]\n\r"));
-      CloudOutput(F("set tz|dst|nodeid|base|spkr|flag|var|cloud|debug"));
+      CloudOutput(F("set tz|dst|nodeid|base|spkr|flag|var|cloud|output|log|rule|sched|perf|debug"));
     }
   } else if(strTopic.equals("sys")) {
     SERIAL_LN(F("--- Command: sys <mode> ---"));
@@ -326,6 +415,8 @@ bool SerialConsoleClass::showThisHelp(String &strTopic)
   } else {
     SERIAL_LN(F("Available Commands:"));
     SERIAL_LN(F("    check, show, ping, do, test, send, set, sys, help or ?"));
+    SERIAL_LN(F("Tab completes a command, the first letters do if they are unique, e.g. 'sh' for show"));
+    SERIAL_LN(F("sys reset, safe, dfu, update, clear, base and private must be typed in full"));
     SERIAL_LN(F("Use 'help <command>' for more information\n\r"));
     CloudOutput(F("check, show, ping, do, test, send, set, sys, help or ?"));
   }
@@ -378,10 +469,13 @@ bool SerialConsoleClass::doCheck(const char *cmd)
         }
         CloudOutput("Wi-Fi module is %s, RSSI=%ddB", (WiFi.ready() ? "ready" : "not ready!"), lv_RSSI);
     } else if (strnicmp(sTopic, "wlan", 4) == 0) {
-        SERIAL_LN("**Resolving IP for www.google.com...%s\n\r", (WiFi.resolve("www.google.com") ? "OK" : "failed!"));
-        CloudOutput("WLAN is OK");
+        // Cached, a fresh probe follows in the background
+        theNetProbe.print();
+        theNetProbe.Kick();
+        CloudOutput("WLAN is %s", (theNetProbe.IsWANGood() ? "OK" : "down"));
     } else if (strnicmp(sTopic, "flash", 5) == 0) {
         SERIAL_LN("** Free memory: %lu bytes, total EEPROM space: %lu bytes\n\r", System.freeMemory(), EEPROM.length());
+        theConfig.print_logStatus();
         CloudOutput("Free memory: %lu bytes, total EEPROM space: %lu bytes", System.freeMemory(), EEPROM.length());
     } else {
       retVal = false;
@@ -413,11 +507,11 @@ bool SerialConsoleClass::doShow(const char *cmd)
       SERIAL_LN("  MAC address: %s", PrintMacAddress(strDisplay, mac));
       if( WiFi.ready() ) {
         SERIAL("  IP Address: ");
-        TheSerial.println(WiFi.localIP());
+        theOutput.println(WiFi.localIP());
         SERIAL("  Subnet Mask: ");
-        TheSerial.println(WiFi.subnetMask());
+        theOutput.println(WiFi.subnetMask());
         SERIAL("  Gateway IP: ");
-        TheSerial.println(WiFi.gatewayIP());
+        theOutput.println(WiFi.gatewayIP());
         SERIAL_LN("  SSID: %s", WiFi.SSID());
       }
       SERIAL_LN("");
@@ -434,13 +528,41 @@ bool SerialConsoleClass::doShow(const char *cmd)
       CloudOutput("NodeID: %d (%s), Status: %d", lv_NodeID, (lv_NodeID==GATEWAY_ADDRESS ? "Gateway" : (lv_NodeID==AUTO ? "AUTO" : "Node")), theSys.GetStatus());
   } else if (strnicmp(sTopic, "dev", 3) == 0) {
       theConfig.print_devStatus();
+  } else if (strnicmp(sTopic, "log", 3) == 0) {
+    theLogger.print();
+  } else if (strnicmp(sTopic, "nlist", 5) == 0) {
+      theNodeList.print();
+  } else if (strnicmp(sTopic, "offline", 7) == 0) {
+      theOffline.print();
+  } else if (strnicmp(sTopic, "perf", 4) == 0) {
+      theProfiler.print();
+  } else if (strnicmp(sTopic, "task", 4) == 0) {
+      theTasks.print();
+  } else if (strnicmp(sTopic, "scene", 5) == 0) {
+      theScenario.print();
+  } else if (strnicmp(sTopic, "rule", 4) == 0) {
+      theRules.print();
+  } else if (strnicmp(sTopic, "sched", 5) == 0) {
+      theScheduler.print();
+  } else if (strnicmp(sTopic, "stats", 5) == 0) {
+      retVal = ShowStatistics(next());
+	} else if (strnicmp(sTopic, "boot", 4) == 0) {
+      theSys.PrintBoot();
+	} else if (strnicmp(sTopic, "cloud", 5) == 0) {
+      thePublisher.print();
+	} else if (strnicmp(sTopic, "conn", 4) == 0) {
+      theConnMgr.print();
 	} else if (strnicmp(sTopic, "ble", 3) == 0) {
       // ToDo: show BLE summay
       SERIAL_LN("");
       CloudOutput("");
 	} else if (strnicmp(sTopic, "rf", 2) == 0) {
-      theRadio.PrintRFDetails();
+      {
+        RFWorkerLock lock;
+        if( lock.IsParked() ) theRadio.PrintRFDetails();
+      }
       SERIAL_LN("");
+      theRFWorker.print();
 	} else if (strnicmp(sTopic, "time", 4) == 0) {
       time_t time = Time.now();
       SERIAL_LN("Now is %s, %s\n\r", Time.format(time, TIME_FORMAT_ISO8601_FULL).c_str(), theSys.m_tzString.c_str());
@@ -484,6 +606,7 @@ bool SerialConsoleClass::doPing(const char *cmd)
 bool SerialConsoleClass::doAction(const char *cmd)
 {
   IF_SERIAL_DEBUG(SERIAL_LN(F("doAction(%s)\n\r"), cmd));
+  theStat.Command(STAT_SRC_CONSOLE);
 
   bool retVal = false;
 
@@ -501,6 +624,20 @@ bool SerialConsoleClass::doAction(const char *cmd)
       // ToDo:
       SERIAL_LN("**Color changed\n\r");
       retVal = true;
+    } else if (strnicmp(sTopic, "scene", 5) == 0) {
+      char *sParam = next();
+      if( sParam ) {
+        UC lv_scene = (UC)atoi(sParam);
+        UL lv_start = micros();
+        SHORT nSent = theScenario.Recall(lv_scene);
+        UL lv_elapsed = micros() - lv_start;
+        if( nSent < 0 ) {
+          SERIAL_LN("Scene %d not found\n\r", lv_scene);
+        } else {
+          SERIAL_LN("**Scene %d recalled, %d frame(s) sent in %luus\n\r", lv_scene, nSent, lv_elapsed);
+        }
+        retVal = true;
+      }
     }
   }
 
@@ -533,6 +670,35 @@ bool SerialConsoleClass::doTest(const char *cmd)
         theASR.sendCommand(atoi(sParam));
         retVal = true;
       }
+    } else if (strnicmp(sTopic, "json", 4) == 0) {
+      char *sParam = next();
+      if( sParam && strnicmp(sParam, "mem", 3) == 0 ) {
+        retVal = ReportJsonMemory();
+      } else if( sParam && strnicmp(sParam, "num", 3) == 0 ) {
+        retVal = CheckJsonNumbers();
+      } else if( sParam && strnicmp(sParam, "cfg", 3) == 0 ) {
+        retVal = CheckJsonConfig();
+      } else {
+        retVal = BenchmarkJson(sParam);
+      }
+    } else if (strnicmp(sTopic, "rules", 5) == 0) {
+      retVal = BenchmarkRules(next());
+    } else if (strnicmp(sTopic, "sched", 5) == 0) {
+      US nFailed = SchedulerClass::SelfTest();
+      SERIAL_LN("sched: self-test %s, %d failure(s)\n\r", nFailed ? "FAILED" : "passed", nFailed);
+      CloudOutput("sched: self-test %s", nFailed ? "FAILED" : "passed");
+      retVal = true;
+    } else if (strnicmp(sTopic, "rfq", 3) == 0) {
+      char *sParam = next();
+      UL nCount = (sParam ? atol(sParam) : 0);
+      if( nCount == 0 ) nCount = 10000;
+      SERIAL_LN("rfq: self-test");
+      UL nErrors = theRFWorker.SelfTest(nCount);
+      SERIAL_LN("rfq: self-test %s\n\r", nErrors ? "FAILED" : "passed");
+      CloudOutput("rfq: self-test %s", nErrors ? "FAILED" : "passed");
+      retVal = true;
+    } else if (strnicmp(sTopic, "flood", 5) == 0) {
+      retVal = FloodRF(next());
     }
   }
 
@@ -543,6 +709,7 @@ bool SerialConsoleClass::doTest(const char *cmd)
 bool SerialConsoleClass::doSend(const char *cmd)
 {
   IF_SERIAL_DEBUG(SERIAL_LN(F("doSend(%s)\n\r"), cmd));
+  theStat.Command(STAT_SRC_CONSOLE);
 
   bool retVal = false;
 
@@ -560,6 +727,7 @@ bool SerialConsoleClass::doSend(const char *cmd)
 bool SerialConsoleClass::doSet(const char *cmd)
 {
   IF_SERIAL_DEBUG(SERIAL_LN(F("doSet(%s)\n\r"), cmd));
+  theStat.Command(STAT_SRC_CONSOLE);
 
   bool retVal = false;
 
@@ -575,7 +743,7 @@ bool SerialConsoleClass::doSet(const char *cmd)
           CloudOutput("Set Time Zone to %f", fltTmp);
         } else {
           SERIAL_LN("Failed to SetTimeZone:%s\n\r", sParam1);
-          CloudOutput("Failed to SetTimeZone:%s", sParam1);
+          CloudError("Failed to SetTimeZone:%s", sParam1);
         }
         retVal = true;
       }
@@ -608,10 +776,15 @@ bool SerialConsoleClass::doSet(const char *cmd)
     } else if (strnicmp(sTopic, "base", 4) == 0) {
       sParam1 = next();
       if( sParam1) {
-        theRadio.enableBaseNetwork(atoi(sParam1) > 0);
+        {
+          RFWorkerLock lock;
+          if( lock.IsParked() ) {
+            theRadio.enableBaseNetwork(atoi(sParam1) > 0);
+            retVal = true;
+          }
+        }
         SERIAL_LN("Base RF network is %s\n\r", (theRadio.isBaseNetworkEnabled() ? "enabled" : "disabled"));
         CloudOutput("Base RF network is %s", (theRadio.isBaseNetworkEnabled() ? "enabled" : "disabled"));
-        retVal = true;
       }
     } else if (strnicmp(sTopic, "spkr", 4) == 0) {
       // Enable or disable speaker
@@ -637,6 +810,45 @@ bool SerialConsoleClass::doSet(const char *cmd)
         SERIAL_LN("Require Cloud option [0|1|2], use '? set cloud' for detail\n\r");
         retVal = true;
       }
+    } else if (strnicmp(sTopic, "output", 6) == 0) {
+      // Console output mode
+      sParam1 = next();
+      if( sParam1) {
+        theOutput.SetNonBlocking(atoi(sParam1) > 0);
+        SERIAL_LN("Console output is %s\n\r", (theOutput.IsNonBlocking() ? "non-blocking" : "blocking"));
+        CloudOutput("Console output is %s", (theOutput.IsNonBlocking() ? "non-blocking" : "blocking"));
+        retVal = true;
+      } else {
+        SERIAL_LN("Require output flag value [0|1], use '? set output' for detail\n\r");
+        retVal = true;
+      }
+    } else if (strnicmp(sTopic, "log", 3) == 0) {
+      retVal = SetLog(next());
+    } else if (strnicmp(sTopic, "raw", 3) == 0) {
+      // Console input mode, only for the serial port
+      sParam1 = next();
+      if( isInCloudCommand ) {
+        CloudError("Raw mode is for the serial console");
+        retVal = true;
+      } else if( sParam1) {
+        setRawMode(atoi(sParam1) > 0);
+        retVal = true;
+      } else {
+        SERIAL_LN("Require raw flag value [0|1], use '? set raw' for detail\n\r");
+        retVal = true;
+      }
+    } else if (strnicmp(sTopic, "rule", 4) == 0) {
+      retVal = SetRule(next());
+    } else if (strnicmp(sTopic, "sched", 5) == 0) {
+      retVal = SetSchedule(next());
+    } else if (strnicmp(sTopic, "perf", 4) == 0) {
+      sParam1 = next();
+      if( sParam1 && strnicmp(sParam1, "reset", 5) == 0 ) {
+        theProfiler.Reset();
+        SERIAL_LN("Profiler reset\n\r");
+        CloudOutput("Profiler reset");
+        retVal = true;
+      }
     }
   }
 
@@ -668,12 +880,14 @@ bool SerialConsoleClass::doSysSub(const char *cmd)
     else if (strnicmp(sTopic, "safe", 4) == 0) {
       SERIAL_LN(F("System is about to enter safe mode..."));
       CloudOutput("System is about to enter safe mod");
+      SERIAL_FLUSH(true);
       delay(1000);
       System.enterSafeMode();
     }
     else if (strnicmp(sTopic, "dfu", 3) == 0) {
       SERIAL_LN(F("System is about to enter DFU mode..."));
       CloudOutput("System is about to enter DFU mode");
+      SERIAL_FLUSH(true);
       delay(1000);
       System.dfu();
     }
@@ -689,7 +903,8 @@ bool SerialConsoleClass::doSysSub(const char *cmd)
           return false;
         }
       } else {
-        SERIAL_LN("Serial speed:%d\r\n", SERIALPORT_SPEED_DEFAULT);
+        SERIAL_LN("Serial speed:%d, %s output, %lu bytes dropped\r\n", SERIALPORT_SPEED_DEFAULT,
+            (theOutput.IsNonBlocking() ? "non-blocking" : "blocking"), theOutput.GetDroppedBytes());
         CloudOutput("Serial speed:%d", SERIALPORT_SPEED_DEFAULT);
       }
     }
@@ -720,12 +935,22 @@ bool SerialConsoleClass::doSysSub(const char *cmd)
     }
     else if (strnicmp(sTopic, "base", 4) == 0) {
       // Switch to Base Network
+      RFWorkerLock lock;
+      if( !lock.IsParked() ) {
+        CloudError(F("RF busy, network not switched"));
+        return false;
+      }
       theRadio.switch2BaseNetwork();
       SERIAL_LN(F("Switched to base network\n\r"));
       CloudOutput(F("Switched to base network"));
     }
     else if (strnicmp(sTopic, "private", 7) == 0) {
       // Switch to Private Network
+      RFWorkerLock lock;
+      if( !lock.IsParked() ) {
+        CloudError(F("RF busy, network not switched"));
+        return false;
+      }
       theRadio.switch2MyNetwork();
       SERIAL_LN(F("Switched to private network: %s\n\r"), PrintUint64(strDisplay, theRadio.getCurrentNetworkID()));
       CloudOutput(F("Switched to private network"));
@@ -807,8 +1032,9 @@ bool SerialConsoleClass::SetWiFiCredential(const char *cmd)
   }
   SERIAL("Wi-Fi credential saved");
   WiFi.listen(false);
+  // Reconnects in the background, see 'show conn'
   theSys.connectWiFi();
-  CloudOutput("Wi-Fi credential saved, reconnect %s", WiFi.ready() ? "OK" : "Failed");
+  CloudOutput("Wi-Fi credential saved, reconnecting");
 
   return true;
 }
@@ -817,7 +1043,7 @@ bool SerialConsoleClass::PingAddress(const char *sAddress)
 {
   if( !WiFi.ready() ) {
     SERIAL_LN("Wi-Fi is not ready!");
-    CloudOutput("Wi-Fi is not ready");
+    CloudError("Wi-Fi is not ready");
     return false;
   }
 
@@ -829,8 +1055,9 @@ bool SerialConsoleClass::PingAddress(const char *sAddress)
   // Ping 4 times
   int pingStartTime = millis();
   SERIAL("Pinging %s (", sAddress);
-  TheSerial.print(ipAddr);
+  theOutput.print(ipAddr);
   SERIAL(")...");
+  SERIAL_FLUSH(true);
   int myByteCount = WiFi.ping(ipAddr, 3);
   int elapsedTime = millis() - pingStartTime;
   SERIAL_LN("received %d bytes over %d ms", myByteCount, elapsedTime);
@@ -839,6 +1066,197 @@ bool SerialConsoleClass::PingAddress(const char *sAddress)
   return true;
 }
 
+// Representative payloads: a cloud command and a scene definition
+static const char *const strJsonSamples[] = {
+  "{\"cmd\":\"send\",\"nd\":1,\"sen\":1,\"ack\":1,\"typ\":3,\"payl\":\"65\"}",
+  "{\"scene\":7,\"name\":\"Evening warm\",\"rings\":[[1,100,2700,0,0,0],"
+  "[1,50,3000,255,160,60],[0,0,6500,255,255,255]],\"devs\":[{\"nd\":1,"
+  "\"hue\":[1,80,3200,0,0,0]},{\"nd\":8,\"hue\":[1,40,2700,0,0,0]}]}"
+};
+
+bool SerialConsoleClass::BenchmarkJson(const char *sRounds)
+{
+  UL rounds = (sRounds ? atol(sRounds) : 0);
+  if( rounds == 0 ) rounds = 1000;
+
+  char strBuf[256];
+  for( UC i = 0; i < sizeof(strJsonSamples) / sizeof(strJsonSamples[0]); i++ ) {
+    size_t len = strlen(strJsonSamples[i]);
+    bool bSuccess = true;
+    // Time includes restoring the input, as the parser works in place
+    UL startTime = micros();
+    for( UL r = 0; r < rounds && bSuccess; r++ ) {
+      memcpy(strBuf, strJsonSamples[i], len + 1);
+      StaticJsonBuffer<512> jBuf;
+      bSuccess = jBuf.parseObject(strBuf).success();
+    }
+    UL elapsedTime = micros() - startTime;
+    if( !bSuccess ) {
+      SERIAL_LN("json sample %d failed to parse", i);
+      return false;
+    }
+    if( elapsedTime == 0 ) elapsedTime = 1;
+    // Bytes per microsecond is MB/s, keep two decimals
+    UL rate = (UL)((uint64_t)len * rounds * 100 / elapsedTime);
+    SERIAL_LN("json sample %d: %u bytes x %lu in %lu us, %lu.%02lu MB/s",
+        i, (unsigned)len, rounds, elapsedTime, rate / 100, rate % 100);
+    CloudOutput("json sample %d: %lu.%02lu MB/s", i, rate / 100, rate % 100);
+  }
+
+  return true;
+}
+
+// A model of the node layout before the compact JsonVariant, for
+/// comparison: hand-written from the old sources, not the old library
+/// itself, so the legacy numbers are estimates
+typedef struct {
+  int type;
+  union { double d; long l; void *p; } content;
+} LegacyJsonVariant_t;
+typedef struct { void *next; LegacyJsonVariant_t content; } LegacyJsonNode_t;
+typedef struct { void *next; const char *key; LegacyJsonVariant_t value; } LegacyJsonPairNode_t;
+typedef struct { void *buffer; void *firstNode; } LegacyJsonList_t;
+
+// Count containers, array elements and object members of a document
+static void CountJsonNodes(JsonVariant &var, US *containers, US *elements, US *members)
+{
+  if( var.is<JsonArray &>() ) {
+    JsonArray &array = var.asArray();
+    (*containers)++;
+    for( JsonArray::iterator it = array.begin(); it != array.end(); ++it ) {
+      (*elements)++;
+      CountJsonNodes(*it, containers, elements, members);
+    }
+  } else if( var.is<JsonObject &>() ) {
+    JsonObject &object = var.asObject();
+    (*containers)++;
+    for( JsonObject::iterator it = object.begin(); it != object.end(); ++it ) {
+      (*members)++;
+      CountJsonNodes(it->value, containers, elements, members);
+    }
+  }
+}
+
+bool SerialConsoleClass::ReportJsonMemory()
+{
+  SERIAL_LN("JsonVariant %u bytes, array node %u, object node %u (modelled legacy %u, %u, %u)",
+      (unsigned)sizeof(JsonVariant), (unsigned)sizeof(JsonArray::node_type),
+      (unsigned)sizeof(JsonObject::node_type), (unsigned)sizeof(LegacyJsonVariant_t),
+      (unsigned)sizeof(LegacyJsonNode_t), (unsigned)sizeof(LegacyJsonPairNode_t));
+
+  char strBuf[256];
+  for( UC i = 0; i < sizeof(strJsonSamples) / sizeof(strJsonSamples[0]); i++ ) {
+    strncpy(strBuf, strJsonSamples[i], sizeof(strBuf) - 1);
+    strBuf[sizeof(strBuf) - 1] = '\0';
+    StaticJsonBuffer<512> jBuf;
+    JsonObject &root = jBuf.parseObject(strBuf);
+    if( !root.success() ) {
+      SERIAL_LN("json sample %d failed to parse", i);
+      return false;
+    }
+
+    JsonVariant var;
+    var = root;
+    US containers = 0, elements = 0, members = 0;
+    CountJsonNodes(var, &containers, &elements, &members);
+    US nodes = elements + members;
+    if( nodes == 0 ) nodes = 1;
+    UL legacySize = containers * sizeof(LegacyJsonList_t)
+        + elements * sizeof(LegacyJsonNode_t) + members * sizeof(LegacyJsonPairNode_t);
+    SERIAL_LN("json sample %d: %u nodes, %u bytes (%u/node), modelled legacy %lu bytes (%lu/node)",
+        i, nodes, (unsigned)jBuf.size(), (unsigned)(jBuf.size() / nodes),
+        legacySize, legacySize / nodes);
+    CloudOutput("json sample %d: %u/node, modelled legacy %lu/node", i,
+        (unsigned)(jBuf.size() / nodes), legacySize / nodes);
+  }
+
+  return true;
+}
+
+// Numbers keep their decimals in the variant's type byte, however many
+/// there are they must come back as doubles and print
+bool SerialConsoleClass::CheckJsonNumbers()
+{
+  const US digits[] = {2, 240, 248, 249, 250, 251, 254, 255, 300};
+  char strIn[320];
+  char strOut[320];
+  UC nFailed = 0;
+  for( UC i = 0; i < sizeof(digits) / sizeof(digits[0]); i++ ) {
+    // {"a":0.00...01} with digits[i] decimals
+    US n = 0;
+    n += sprintf(strIn, "{\"a\":0.");
+    for( US d = 1; d < digits[i]; d++ ) strIn[n++] = '0';
+    n += sprintf(strIn + n, "1}");
+
+    StaticJsonBuffer<256> jBuf;
+    JsonObject &root = jBuf.parseObject(strIn);
+    bool bOK = root.success() && root["a"].is<double>();
+    if( bOK ) {
+      size_t len = root.printTo(strOut, sizeof(strOut));
+      bOK = (len > 7 && strncmp(strOut, "{\"a\":0", 6) == 0 && strOut[len - 1] == '}');
+    }
+    if( !bOK ) {
+      SERIAL_LN("json num: %d decimals FAILED", digits[i]);
+      nFailed++;
+    }
+  }
+  SERIAL_LN("json num: self-test %s\n\r", nFailed ? "FAILED" : "passed");
+  CloudOutput("json num: self-test %s", nFailed ? "FAILED" : "passed");
+  return true;
+}
+
+// What the Cloud functions JSONConfig and JSONDevSt decode, on copies so
+/// the live config is left alone
+bool SerialConsoleClass::CheckJsonConfig()
+{
+  UC nFailed = 0;
+  Config_t cfg;
+  memset(&cfg, 0x00, sizeof(cfg));
+  cfg.nodeID = 70;
+  cfg.rfPowerLevel = RF24_PA_LOW;
+
+  // Given keys change, the rest and unknown keys such as nodeID don't
+  if( !JsonToStruct("{\"enableSpeaker\":1,\"timeZone\":{\"id\":90,\"offset\":-300,\"dst\":1},"
+      "\"Organization\":\"xlight.ca\",\"nodeID\":5}", cfg)
+      || !cfg.enableSpeaker || cfg.timeZone.id != 90 || cfg.timeZone.offset != -300 || !cfg.timeZone.dst
+      || strcmp(cfg.Organization, "xlight.ca") || cfg.nodeID != 70 || cfg.rfPowerLevel != RF24_PA_LOW ) {
+    SERIAL_LN("json cfg: partial config FAILED");
+    nFailed++;
+  }
+
+  // Out of range rejects the whole document
+  Config_t before = cfg;
+  if( JsonToStruct("{\"enableSpeaker\":0,\"rfPowerLevel\":9}", cfg) || memcmp(&cfg, &before, sizeof(cfg)) ) {
+    SERIAL_LN("json cfg: out of range FAILED");
+    nFailed++;
+  }
+
+  // Written and read back
+  char strJson[256];
+  Config_t copy;
+  memset(&copy, 0x00, sizeof(copy));
+  if( !StructToJson(cfg, strJson, sizeof(strJson)) || !JsonToStruct(strJson, copy)
+      || copy.enableSpeaker != cfg.enableSpeaker || copy.timeZone.offset != cfg.timeZone.offset
+      || strcmp(copy.Organization, cfg.Organization) || copy.nodeID != 0 ) {
+    SERIAL_LN("json cfg: round trip FAILED, %s", strJson);
+    nFailed++;
+  }
+
+  // Rings by position
+  DevStatusRow_t row;
+  memset(&row, 0x00, sizeof(row));
+  if( !JsonToStruct("{\"node_id\":8,\"present\":1,\"ring\":[[1,80,3000,0,0,0],[0,0,2700,1,2,3]]}", row)
+      || row.node_id != 8 || !row.present || !row.ring[0].State || row.ring[0].BR != 80
+      || row.ring[0].CCT != 3000 || row.ring[1].CCT != 2700 || row.ring[1].B != 3 ) {
+    SERIAL_LN("json cfg: device status FAILED");
+    nFailed++;
+  }
+
+  SERIAL_LN("json cfg: self-test %s\n\r", nFailed ? "FAILED" : "passed");
+  CloudOutput("json cfg: self-test %s", nFailed ? "FAILED" : "passed");
+  return true;
+}
+
 bool SerialConsoleClass::String2IP(const char *sAddress, IPAddress &ipAddr)
 {
   int lv_len = strlen(sAddress);
@@ -902,7 +1320,9 @@ bool SerialConsoleClass::ExecuteCloudCommand(const char *cmd)
   clearBuffer();
   setCommandBuffer(cmd);
   isInCloudCommand = true;
+  theOutput.BeginReply();
   bool rc = scanStateMachine();
+  theOutput.EndReply();
   isInCloudCommand = false;
   return rc;
 }
@@ -912,15 +1332,324 @@ void SerialConsoleClass::CloudOutput(const char *msg, ...)
 {
   if( !isInCloudCommand ) return;
 
-  int nSize = 0;
-  char buf[512];
+  va_list args;
+  va_start(args, msg);
+  CloudOutputV(CPUB_PRIO_NORMAL, msg, args);
+  va_end(args);
+}
+
+// Same for a failure, published ahead of other results
+void SerialConsoleClass::CloudError(const char *msg, ...)
+{
+  if( !isInCloudCommand ) return;
 
-  // Prepare message
   va_list args;
   va_start(args, msg);
-  nSize = vsnprintf(buf, 512, msg, args);
-  buf[nSize] = NULL;
+  CloudOutputV(CPUB_PRIO_ERROR, msg, args);
+  va_end(args);
+}
 
-  // Set message
+void SerialConsoleClass::CloudOutputV(UC prio, const char *msg, va_list args)
+{
+  char buf[512];
+
+  // Prepare message
+  vsnprintf(buf, sizeof(buf), msg, args);
+
+  // Set message, and queue it for publishing, cut to CPUB_MSG_SIZE
   theSys.m_lastMsg = buf;
+  thePublisher.Add(buf, prio);
+}
+
+// <action tokens>: on <node>, off <node>, brcct <node> <br> <cct>, scene <id>
+bool SerialConsoleClass::ParseAction(RuleAction_t &action)
+{
+  memset(&action, 0x00, sizeof(action));
+  char *sAction = next();
+  char *sTarget = next();
+  if( !sAction || !sTarget ) return false;
+  action.target = (UC)atoi(sTarget);
+  if( strnicmp(sAction, "on", 2) == 0 ) {
+    action.type = RULE_ACT_ON;
+  } else if( strnicmp(sAction, "off", 3) == 0 ) {
+    action.type = RULE_ACT_OFF;
+  } else if( strnicmp(sAction, "scene", 5) == 0 ) {
+    action.type = RULE_ACT_SCENE;
+  } else if( strnicmp(sAction, "brcct", 5) == 0 ) {
+    char *sBR = next();
+    char *sCCT = next();
+    if( !sBR || !sCCT ) return false;
+    action.type = RULE_ACT_BR_CCT;
+    action.param1 = (UC)constrain(atoi(sBR), 0, 100);
+    action.param2 = (US)constrain(atoi(sCCT), CT_MIN_VALUE, CT_MAX_VALUE);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// set rule <id> <condition tokens> then <action tokens>
+bool SerialConsoleClass::SetRule(const char *sRuleID)
+{
+  if( !sRuleID ) return false;
+  US ruleID = (US)atoi(sRuleID);
+
+  char *sToken = next();
+  if( sToken && strnicmp(sToken, "del", 3) == 0 ) {
+    BOOL rc = theRules.RemoveRule(ruleID);
+    SERIAL_LN("Rule %d %s\n\r", ruleID, rc ? "removed" : "not found");
+    return true;
+  }
+
+  // Condition runs up to 'then'
+  char strExpr[96];
+  strExpr[0] = '\0';
+  while( sToken && strnicmp(sToken, "then", 4) != 0 ) {
+    if( strlen(strExpr) + strlen(sToken) + 2 > sizeof(strExpr) ) return false;
+    strcat(strExpr, sToken);
+    strcat(strExpr, " ");
+    sToken = next();
+  }
+  if( !sToken ) return false;
+
+  RuleAction_t action;
+  if( !ParseAction(action) ) return false;
+
+  UC code[RULE_MAX_CODE_LEN];
+  UC len = RuleEngineClass::Compile(strExpr, code, sizeof(code));
+  if( len == 0 ) {
+    SERIAL_LN("Failed to compile rule condition: %s\n\r", strExpr);
+  } else if( !theRules.AddRule(ruleID, code, len, action) ) {
+    SERIAL_LN("No room for rule %d\n\r", ruleID);
+  } else {
+    SERIAL_LN("Rule %d set, %d bytes of code\n\r", ruleID, len);
+  }
+  return true;
+}
+
+// set sched <id> <hh:mm> <daily|once|weekday digits> <action tokens>
+bool SerialConsoleClass::SetSchedule(const char *sSchedID)
+{
+  if( !sSchedID ) return false;
+  UC schedID = (UC)atoi(sSchedID);
+  if( schedID == 0 ) return false;
+
+  char *sToken = next();
+  if( !sToken ) return false;
+  if( strnicmp(sToken, "del", 3) == 0 ) {
+    BOOL rc = theScheduler.Remove(schedID);
+    SERIAL_LN("Schedule %d %s\n\r", schedID, rc ? "removed" : "not found");
+    return true;
+  }
+
+  // hh:mm
+  char *sMinute = strchr(sToken, ':');
+  if( !sMinute ) return false;
+  UC hour = (UC)atoi(sToken);
+  UC minute = (UC)atoi(sMinute + 1);
+  if( hour > 23 || minute > 59 ) return false;
+
+  char *sDays = next();
+  if( !sDays ) return false;
+  BOOL once = false;
+  UC weekdays = 0;
+  if( strnicmp(sDays, "once", 4) == 0 ) {
+    once = true;
+  } else if( strnicmp(sDays, "daily", 5) == 0 ) {
+    weekdays = SCHED_EVERYDAY;
+  } else {
+    for( const char *p = sDays; *p; p++ ) {
+      if( *p < '0' || *p > '6' ) return false;
+      weekdays |= (1 << (*p - '0'));
+    }
+  }
+
+  RuleAction_t action;
+  if( !ParseAction(action) ) return false;
+
+  BOOL rc = (once ? theScheduler.SetOnce(schedID, hour, minute, action)
+                  : theScheduler.SetSchedule(schedID, hour, minute, weekdays, action));
+  if( rc ) {
+    SERIAL_LN("Schedule %d set at %02d:%02d\n\r", schedID, hour, minute);
+  } else {
+    SERIAL_LN("No room for schedule %d\n\r", schedID);
+  }
+  return true;
+}
+
+// show stats: RAM counters; show stats <hours>: totals recorded over the
+/// last hours; show stats dump: every record
+bool SerialConsoleClass::ShowStatistics(const char *sParam)
+{
+  if( !sParam ) {
+    theStat.print();
+    return true;
+  }
+  if( strnicmp(sParam, "dump", 4) == 0 ) {
+    SERIAL_LN("** Statistics records: %d **", theStat.GetRecordCount());
+    theStat.Dump(0, 0xFFFFFFFF);
+    return true;
+  }
+
+  UL hours = atoi(sParam);
+  if( hours == 0 ) return false;
+  UL now = Time.now();
+  UL sums[STAT_COUNTERS];
+  UL startTime = micros();
+  US nRecords = theStat.Query(now > hours * 3600 ? now - hours * 3600 : 0, now, sums);
+  UL elapsedTime = micros() - startTime;
+
+  UL lampSec = 0;
+  for( UC l = 0; l < STAT_MAX_LAMPS; l++ ) lampSec += sums[STAT_CNT_LAMP_SEC + l];
+  SERIAL_LN("Last %lu h: %d record(s) in %lu us", hours, nRecords, elapsedTime);
+  SERIAL_LN("  commands console %lu, asr %lu, cloud %lu, auto %lu", sums[STAT_CNT_CMD + STAT_SRC_CONSOLE],
+      sums[STAT_CNT_CMD + STAT_SRC_ASR], sums[STAT_CNT_CMD + STAT_SRC_CLOUD], sums[STAT_CNT_CMD + STAT_SRC_AUTO]);
+  SERIAL_LN("  sent %lu, failed %lu, received %lu, lamps on %lu.%02lu h\n\r", sums[STAT_CNT_SEND_OK],
+      sums[STAT_CNT_SEND_FAIL], sums[STAT_CNT_RECEIVED], lampSec / 3600, (lampSec / 36) % 100);
+  CloudOutput("Last %lu h: sent %lu, failed %lu", hours, sums[STAT_CNT_SEND_OK], sums[STAT_CNT_SEND_FAIL]);
+  return true;
+}
+
+// set log [module] <level> | direct [0|1]
+bool SerialConsoleClass::SetLog(const char *sParam)
+{
+  if( !sParam ) {
+    SERIAL_LN("Require log level, use '? set log' for detail\n\r");
+    return true;
+  }
+
+  if( strnicmp(sParam, "direct", 6) == 0 ) {
+    const char *sFlag = next();
+    if( sFlag ) theLogger.SetDirect(atoi(sFlag) > 0);
+    SERIAL_LN("Log is %s\n\r", (theLogger.IsDirect() ? "direct" : "deferred"));
+    CloudOutput("Log is %s", (theLogger.IsDirect() ? "direct" : "deferred"));
+    return true;
+  }
+
+  // Module first, or just the level for all of them
+  UC module = LoggerClass::ParseModule(sParam);
+  const char *sLevel = sParam;
+  if( module < XLOG_MODULES ) sLevel = next();
+  UC level = (sLevel ? LoggerClass::ParseLevel(sLevel) : XLOG_LEVELS);
+  if( level >= XLOG_LEVELS ) {
+    SERIAL_LN("Unknown log module or level '%s', use '? set log' for detail\n\r", (sLevel ? sLevel : sParam));
+    return true;
+  }
+
+  if( module < XLOG_MODULES ) {
+    theLogger.SetLevel(module, level);
+  } else {
+    theLogger.SetLevelAll(level);
+  }
+  SERIAL_LN("Log level %s set to %d\n\r", (module < XLOG_MODULES ? sParam : "of all modules"), level);
+  CloudOutput("Log level %d", level);
+  return true;
+}
+
+// Start an RF flood test from the first parameter on, or report on it.
+/// The rest of the parameters are name=value, in any order.
+bool SerialConsoleClass::FloodRF(char *sParam)
+{
+  if( !sParam ) {
+    theRFBench.print();
+    CloudOutput("flood: %s", (theRFBench.IsRunning() ? "running" : "idle"));
+    return true;
+  }
+  if( strnicmp(sParam, "stop", 4) == 0 ) {
+    theRFBench.Stop();
+    CloudOutput("flood: stopped");
+    return true;
+  }
+
+  UL nCount = atol(sParam);
+  if( nCount == 0 ) nCount = 100;
+  UL nRate = 10;
+  const char *sDests = "1";
+  const char *sTemplate = RFB_DEFAULT_TEMPLATE;
+  UC ackMode = RFB_ACK_RADIO;
+  UC nRetries = 0;
+  BOOL loopback = false;
+  UC lossPct = 0;
+  while( (sParam = next()) != NULL ) {
+    if( strnicmp(sParam, "to=", 3) == 0 ) {
+      sDests = sParam + 3;
+    } else if( strnicmp(sParam, "rate=", 5) == 0 ) {
+      nRate = atol(sParam + 5);
+    } else if( strnicmp(sParam, "ack=", 4) == 0 ) {
+      ackMode = (strnicmp(sParam + 4, "app", 3) == 0 ? RFB_ACK_APP : RFB_ACK_RADIO);
+    } else if( strnicmp(sParam, "retry=", 6) == 0 ) {
+      nRetries = atoi(sParam + 6);
+    } else if( strnicmp(sParam, "msg=", 4) == 0 ) {
+      sTemplate = sParam + 4;
+    } else if( strnicmp(sParam, "loop", 4) == 0 ) {
+      loopback = true;
+      if( sParam[4] == '=' ) lossPct = constrain(atoi(sParam + 5), 0, 100);
+    } else {
+      SERIAL_LN("Unknown flood parameter '%s', use '? test' for detail\n\r", sParam);
+      return true;
+    }
+  }
+
+  BOOL started = theRFBench.Start(nCount, nRate, sDests, ackMode, nRetries, sTemplate, loopback, lossPct);
+  CloudOutput("flood: %s", (started ? "started" : "failed"));
+  return true;
+}
+
+// Fill an engine of its own with generated rules, then change one input
+/// at a time and measure the evaluation. theRules is left alone.
+bool SerialConsoleClass::BenchmarkRules(const char *sRules)
+{
+  US nRules = (sRules ? atoi(sRules) : 0);
+  if( nRules == 0 ) nRules = RULE_BENCH_RULES;
+  if( nRules > RULE_BENCH_MAX_RULES ) nRules = RULE_BENCH_MAX_RULES;
+
+  // A generated rule takes at most 15 bytes of code
+  RuleEngineClass *bench = new RuleEngineClass(nRules, nRules * 16);
+  if( !bench || !bench->IsValid() ) {
+    SERIAL_LN("rules: not enough memory for %d rules\n\r", nRules);
+    CloudError("rules: not enough memory for %d rules", nRules);
+    delete bench;
+    return true;
+  }
+  bench->SetDryRun(true);
+
+  // Sensor threshold, some also with a time window
+  char strExpr[48];
+  UC code[RULE_MAX_CODE_LEN];
+  RuleAction_t action;
+  memset(&action, 0x00, sizeof(action));
+  US nAdded = 0;
+  UL startTime = micros();
+  for( US r = 0; r < nRules; r++ ) {
+    if( r % 3 == 0 ) {
+      sprintf(strExpr, "s%d %d > time %d >= &&", r % 10, (r * 7) % 100, (r * 13) % 1440);
+    } else {
+      sprintf(strExpr, "s%d %d <", r % 10, (r * 7) % 100);
+    }
+    UC len = RuleEngineClass::Compile(strExpr, code, sizeof(code));
+    if( len && bench->AddRule(r + 1, code, len, action) ) nAdded++;
+  }
+  UL compileTime = micros() - startTime;
+  bench->Evaluate(0xFFFFFFFF);
+
+  const US nEvents = 100;
+  UL evaluated = bench->GetEvaluated();
+  UL maxTime = 0;
+  startTime = micros();
+  for( US e = 0; e < nEvents; e++ ) {
+    UL eventStart = micros();
+    bench->SetInput(e % 10, (SHORT)((e * 37) % 100));
+    bench->Evaluate(0xFFFFFFFF);
+    UL eventTime = micros() - eventStart;
+    if( eventTime > maxTime ) maxTime = eventTime;
+  }
+  UL elapsedTime = micros() - startTime;
+  evaluated = bench->GetEvaluated() - evaluated;
+  delete bench;
+
+  SERIAL_LN("rules: %d compiled in %lu us", nAdded, compileTime);
+  SERIAL_LN("rules: %d events, %lu rules evaluated, avg %lu us, max %lu us per event (budget %d us)\n\r",
+      nEvents, evaluated, elapsedTime / nEvents, maxTime, RULE_EVAL_BUDGET_US);
+  CloudOutput("rules: %d, avg %lu us, max %lu us per event", nAdded, elapsedTime / nEvents, maxTime);
+  return true;
 }
@@ -4,6 +4,7 @@
 #define xlxSerialConsole_h
 
 #include "SerialCommand.h"
+#include "xlxRuleEngine.h"
 
 class SerialConsoleClass : public SerialCommand
 {
@@ -52,13 +53,27 @@ public:
   bool SetupWiFi(const char *cmd);
   bool SetWiFiCredential(const char *cmd);
   bool PingAddress(const char *sAddress);
+  bool BenchmarkJson(const char *sRounds);
+  bool ReportJsonMemory();
+  bool CheckJsonNumbers();
+  bool CheckJsonConfig();
+  bool ParseAction(RuleAction_t &action);
+  bool SetRule(const char *sRuleID);
+  bool SetSchedule(const char *sSchedID);
+  bool ShowStatistics(const char *sParam);
+  bool SetLog(const char *sParam);
+  bool BenchmarkRules(const char *sRules);
+  bool FloodRF(char *sParam);
   bool String2IP(const char *sAddress, IPAddress &ipAddr);
 
   bool ExecuteCloudCommand(const char *cmd);
   void CloudOutput(const char *msg, ...);
+  void CloudError(const char *msg, ...);
 
 private:
   bool isInCloudCommand;
+
+  void CloudOutputV(UC prio, const char *msg, va_list args);
 };
 
 //------------------------------------------------------------------
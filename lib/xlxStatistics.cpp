@@ -0,0 +1,342 @@
+/**
+ * xlxStatistics.cpp - Xlight statistics, RAM counters flushed as delta records
+ *
+ * Created by Baoshi Sun <bs.sun@datatellit.com>
+ * Copyright (C) 2015-2016 DTIT
+ * Full contributor list:
+ *
+ * Documentation:
+ * Support Forum:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * REVISION HISTORY
+ * Version 1.0 - Created by Baoshi Sun <bs.sun@datatellit.com>
+ *
+ * DESCRIPTION
+ * 1. Counters: commands per source, send OK/failed, received, RTT
+ *    histogram and seconds on per lamp
+ * 2. Every STAT_FLUSH_INTERVAL the counters that moved are appended as one
+ *    timestamped record of varint deltas; nothing is written when idle
+ * 3. Records go round the storage ring; the RAM index keeps the newest
+ *    STAT_MAX_RECORDS in order, and queries binary-search it by time
+ * 4. Totals since any point are the sum of the deltas, so the RAM counters
+ *    may start from zero after a reboot
+ * 5. The RAM backend sits in retained memory, so records outlive a reset
+ *
+ * ToDo:
+ * 1. External flash backend at MEM_REPORT_OFFSET on the P1
+ *
+**/
+
+#include "xlxStatistics.h"
+
+//------------------------------------------------------------------
+// the one and only instance of StatisticsClass, with RAM storage in the
+/// Photon's backup SRAM: kept over a reset, Begin() finds the records by
+/// their CRC, and garbage after power-up is skipped the same way
+static retained UC statRamBuf[STAT_RAM_SIZE];
+RamOfflineStorage theStatRam(statRamBuf, sizeof(statRamBuf), false);
+StatisticsClass theStat;
+
+static const char *statSources[STAT_SOURCES] = { "console", "asr", "cloud", "auto" };
+
+//------------------------------------------------------------------
+// Xlight Statistics Class
+//------------------------------------------------------------------
+StatisticsClass::StatisticsClass()
+{
+  m_storage = NULL;
+  m_nRecords = 0;
+  m_tail = 0;
+  m_seq = 0;
+  memset(m_counter, 0x00, sizeof(m_counter));
+  memset(m_flushed, 0x00, sizeof(m_flushed));
+  m_lastFlush = 0;
+  memset(m_lampNode, NODEID_DUMMY, sizeof(m_lampNode));
+  memset(m_lampOnSince, 0x00, sizeof(m_lampOnSince));
+  m_srtt = 0;
+}
+
+// Read and check the record at addr, false if there is none
+BOOL StatisticsClass::ReadRecord(UL addr, UC *rec, UC maxLen)
+{
+  if( !m_storage || addr + STAT_REC_HEADER + 1 > m_storage->GetSize() ) return false;
+  if( !m_storage->Read(addr, rec, 2) ) return false;
+  UC len = rec[1];
+  if( rec[0] != STAT_REC_MAGIC || len < STAT_REC_HEADER + 1 || len > maxLen ) return false;
+  if( addr + len > m_storage->GetSize() || !m_storage->Read(addr, rec, len) ) return false;
+  return ((UC)CalcCRC32(rec, len - 1) == rec[len - 1]);
+}
+
+BOOL StatisticsClass::Decode(const UC *rec, UL *deltas)
+{
+  UL mask;
+  memcpy(&mask, rec + 8, sizeof(mask));
+  UC pos = STAT_REC_HEADER;
+  UC end = rec[1] - 1;
+  for( UC c = 0; c < STAT_COUNTERS; c++ ) {
+    deltas[c] = 0;
+    if( !(mask & (1UL << c)) ) continue;
+    UC shift = 0;
+    do {
+      if( pos >= end || shift > 28 ) return false;
+      deltas[c] |= (UL)(rec[pos] & 0x7F) << shift;
+      shift += 7;
+    } while( rec[pos++] & 0x80 );
+  }
+  return true;
+}
+
+BOOL StatisticsClass::Begin(OfflineStorage *storage)
+{
+  m_storage = storage;
+  m_nRecords = 0;
+  m_tail = 0;
+  m_seq = 0;
+  if( !m_storage ) return false;
+
+  // Walk the ring, skipping a byte at a time over anything that isn't a
+  /// record. Keep the newest by sequence, which wraps.
+  UC rec[STAT_REC_MAX_LEN];
+  UL addr = 0;
+  while( addr + STAT_REC_HEADER + 1 <= m_storage->GetSize() ) {
+    if( !ReadRecord(addr, rec, sizeof(rec)) ) {
+      addr++;
+      continue;
+    }
+
+    StatIndex_t entry;
+    memcpy(&entry.seq, rec + 2, sizeof(entry.seq));
+    memcpy(&entry.time, rec + 4, sizeof(entry.time));
+    entry.addr = addr;
+    entry.len = rec[1];
+    addr += entry.len;
+
+    if( m_nRecords >= STAT_MAX_RECORDS ) {
+      if( (SHORT)(entry.seq - m_index[0].seq) < 0 ) continue;
+      memmove(m_index, m_index + 1, (--m_nRecords) * sizeof(StatIndex_t));
+    }
+    UC i = m_nRecords++;
+    while( i > 0 && (SHORT)(entry.seq - m_index[i - 1].seq) < 0 ) {
+      m_index[i] = m_index[i - 1];
+      i--;
+    }
+    m_index[i] = entry;
+  }
+
+  if( m_nRecords > 0 ) {
+    const StatIndex_t &last = m_index[m_nRecords - 1];
+    m_seq = last.seq + 1;
+    m_tail = last.addr + last.len;
+  }
+  return true;
+}
+
+void StatisticsClass::Command(UC source)
+{
+  if( source < STAT_SOURCES ) m_counter[STAT_CNT_CMD + source]++;
+}
+
+void StatisticsClass::Sent(BOOL ok, UL rttUs)
+{
+  if( !ok ) {
+    m_counter[STAT_CNT_SEND_FAIL]++;
+    return;
+  }
+
+  m_counter[STAT_CNT_SEND_OK]++;
+  UC bucket = 0;
+  for( UL limit = STAT_RTT_BASE_US; bucket < STAT_RTT_BUCKETS - 1 && rttUs >= limit; limit <<= 1 ) bucket++;
+  m_counter[STAT_CNT_RTT + bucket]++;
+
+  // srtt += (rtt - srtt) / 8, in 1/16 us
+  if( m_srtt == 0 ) {
+    m_srtt = rttUs << 4;
+  } else {
+    m_srtt = m_srtt - (m_srtt >> 3) + (rttUs << 1);
+  }
+}
+
+SHORT StatisticsClass::LampSlot(UC nodeID, BOOL add)
+{
+  SHORT freeSlot = -1;
+  for( UC i = 0; i < STAT_MAX_LAMPS; i++ ) {
+    if( m_lampNode[i] == nodeID ) return i;
+    if( freeSlot < 0 && m_lampNode[i] == NODEID_DUMMY ) freeSlot = i;
+  }
+  if( add && freeSlot >= 0 ) m_lampNode[freeSlot] = nodeID;
+  return (add ? freeSlot : -1);
+}
+
+void StatisticsClass::LampSwitch(UC nodeID, BOOL on)
+{
+  SHORT slot = LampSlot(nodeID, on);
+  if( slot < 0 ) return;
+
+  UL now = Time.now();
+  if( on ) {
+    if( !m_lampOnSince[slot] ) m_lampOnSince[slot] = now;
+  } else if( m_lampOnSince[slot] ) {
+    if( now > m_lampOnSince[slot] ) m_counter[STAT_CNT_LAMP_SEC + slot] += now - m_lampOnSince[slot];
+    m_lampOnSince[slot] = 0;
+  }
+}
+
+// Bring the usage of lamps that are still on up to now
+void StatisticsClass::AccrueLamps(UL now)
+{
+  for( UC i = 0; i < STAT_MAX_LAMPS; i++ ) {
+    if( m_lampOnSince[i] && now > m_lampOnSince[i] ) {
+      m_counter[STAT_CNT_LAMP_SEC + i] += now - m_lampOnSince[i];
+      m_lampOnSince[i] = now;
+    }
+  }
+}
+
+void StatisticsClass::Tick()
+{
+  UL now = Time.now();
+  // First call, or the clock was set back
+  if( m_lastFlush == 0 || now < m_lastFlush ) m_lastFlush = now;
+  if( now - m_lastFlush >= STAT_FLUSH_INTERVAL ) Flush();
+}
+
+// Forget the records the new one is about to overwrite
+void StatisticsClass::DropRange(UL addr, UC len)
+{
+  UC n = 0;
+  for( UC i = 0; i < m_nRecords; i++ ) {
+    const StatIndex_t &entry = m_index[i];
+    if( entry.addr < addr + len && addr < entry.addr + entry.len ) continue;
+    m_index[n++] = entry;
+  }
+  m_nRecords = n;
+}
+
+BOOL StatisticsClass::Flush()
+{
+  UL now = Time.now();
+  m_lastFlush = now;
+  AccrueLamps(now);
+  if( !m_storage ) return false;
+
+  UC rec[STAT_REC_MAX_LEN];
+  UL mask = 0;
+  UC pos = STAT_REC_HEADER;
+  for( UC c = 0; c < STAT_COUNTERS; c++ ) {
+    UL delta = m_counter[c] - m_flushed[c];
+    if( !delta ) continue;
+    mask |= (1UL << c);
+    while( delta >= 0x80 ) {
+      rec[pos++] = (UC)(delta | 0x80);
+      delta >>= 7;
+    }
+    rec[pos++] = (UC)delta;
+  }
+  if( !mask ) return true;
+
+  UC len = pos + 1;
+  rec[0] = STAT_REC_MAGIC;
+  rec[1] = len;
+  memcpy(rec + 2, &m_seq, sizeof(m_seq));
+  memcpy(rec + 4, &now, sizeof(now));
+  memcpy(rec + 8, &mask, sizeof(mask));
+  rec[pos] = (UC)CalcCRC32(rec, pos);
+
+  if( m_tail + len > m_storage->GetSize() ) m_tail = 0;
+  DropRange(m_tail, len);
+  if( !m_storage->Write(m_tail, rec, len) ) return false;
+
+  if( m_nRecords >= STAT_MAX_RECORDS ) {
+    memmove(m_index, m_index + 1, (--m_nRecords) * sizeof(StatIndex_t));
+  }
+  StatIndex_t &entry = m_index[m_nRecords++];
+  entry.time = now;
+  entry.addr = m_tail;
+  entry.seq = m_seq++;
+  entry.len = len;
+  m_tail += len;
+  memcpy(m_flushed, m_counter, sizeof(m_flushed));
+  return true;
+}
+
+// First record at or after the time, m_nRecords if none
+SHORT StatisticsClass::LowerBound(UL time)
+{
+  SHORT lo = 0, hi = m_nRecords;
+  while( lo < hi ) {
+    SHORT mid = (lo + hi) / 2;
+    if( m_index[mid].time < time ) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+US StatisticsClass::Query(UL from, UL to, UL *sums)
+{
+  memset(sums, 0x00, STAT_COUNTERS * sizeof(UL));
+
+  UC rec[STAT_REC_MAX_LEN];
+  UL deltas[STAT_COUNTERS];
+  US nFound = 0;
+  for( SHORT i = LowerBound(from); i < m_nRecords && m_index[i].time <= to; i++ ) {
+    if( !ReadRecord(m_index[i].addr, rec, sizeof(rec)) || !Decode(rec, deltas) ) continue;
+    for( UC c = 0; c < STAT_COUNTERS; c++ ) sums[c] += deltas[c];
+    nFound++;
+  }
+  return nFound;
+}
+
+void StatisticsClass::Dump(UL from, UL to)
+{
+  UC rec[STAT_REC_MAX_LEN];
+  UL deltas[STAT_COUNTERS];
+  for( SHORT i = LowerBound(from); i < m_nRecords && m_index[i].time <= to; i++ ) {
+    const StatIndex_t &entry = m_index[i];
+    if( !ReadRecord(entry.addr, rec, sizeof(rec)) || !Decode(rec, deltas) ) {
+      SERIAL_LN("  #%u at %lu: bad record", entry.seq, entry.addr);
+      continue;
+    }
+    UL lampSec = 0;
+    for( UC l = 0; l < STAT_MAX_LAMPS; l++ ) lampSec += deltas[STAT_CNT_LAMP_SEC + l];
+    SERIAL_LN("  #%u %s %dB cmd %lu/%lu/%lu/%lu send %lu/%lu rx %lu lamp %lus", entry.seq,
+        Time.format(entry.time, TIME_FORMAT_ISO8601_FULL).c_str(), entry.len,
+        deltas[STAT_CNT_CMD], deltas[STAT_CNT_CMD + 1], deltas[STAT_CNT_CMD + 2], deltas[STAT_CNT_CMD + 3],
+        deltas[STAT_CNT_SEND_OK], deltas[STAT_CNT_SEND_FAIL], deltas[STAT_CNT_RECEIVED], lampSec);
+  }
+  SERIAL_LN("");
+}
+
+void StatisticsClass::print()
+{
+  UL now = Time.now();
+  SERIAL_LN("** Statistics: %d record(s), %lu bytes at %lu, next flush in %lds **",
+      m_nRecords, (m_storage ? m_storage->GetSize() : 0), m_tail,
+      (LONG)(m_lastFlush + STAT_FLUSH_INTERVAL) - (LONG)now);
+  for( UC s = 0; s < STAT_SOURCES; s++ ) {
+    SERIAL_LN("  commands from %s: %lu", statSources[s], m_counter[STAT_CNT_CMD + s]);
+  }
+  SERIAL_LN("  sent %lu, failed %lu, received %lu, srtt %lu us", m_counter[STAT_CNT_SEND_OK],
+      m_counter[STAT_CNT_SEND_FAIL], m_counter[STAT_CNT_RECEIVED], GetSmoothedRTT());
+  UL limit = STAT_RTT_BASE_US;
+  for( UC b = 0; b < STAT_RTT_BUCKETS; b++, limit <<= 1 ) {
+    SERIAL_LN("  rtt %s%lu us: %lu", (b < STAT_RTT_BUCKETS - 1 ? "< " : ">= "),
+        (b < STAT_RTT_BUCKETS - 1 ? limit : limit >> 1), m_counter[STAT_CNT_RTT + b]);
+  }
+  for( UC i = 0; i < STAT_MAX_LAMPS; i++ ) {
+    if( m_lampNode[i] == NODEID_DUMMY ) continue;
+    // Hundredths of an hour
+    UL centiHours = m_counter[STAT_CNT_LAMP_SEC + i] / 36;
+    SERIAL_LN("  lamp %d: %lu.%02lu h%s", m_lampNode[i], centiHours / 100, centiHours % 100,
+        (m_lampOnSince[i] ? ", on" : ""));
+  }
+  SERIAL_LN("");
+}
@@ -0,0 +1,120 @@
+//  xlxStatistics.h - Xlight statistics, RAM counters flushed as delta records
+
+#ifndef xlxStatistics_h
+#define xlxStatistics_h
+
+#include "xliCommon.h"
+#include "xliMemoryMap.h"
+#include "xlxOfflineCache.h"
+
+#define STAT_RAM_SIZE             1024        // RAM backend in retained memory, ~40 records
+#define STAT_MAX_RECORDS          48          // RAM index of the records in the storage
+#define STAT_FLUSH_INTERVAL       900         // seconds between records
+#define STAT_MAX_LAMPS            8
+#define STAT_RTT_BUCKETS          8           // <250us, <500us, <1ms ... >=16ms
+#define STAT_RTT_BASE_US          250
+
+// Command sources
+#define STAT_SRC_CONSOLE          0
+#define STAT_SRC_ASR              1
+#define STAT_SRC_CLOUD            2
+#define STAT_SRC_AUTO             3           // rules and schedules
+#define STAT_SOURCES              4
+
+// Counter layout, one bit each in a record's mask
+#define STAT_CNT_CMD              0           // + source
+#define STAT_CNT_SEND_OK          (STAT_CNT_CMD + STAT_SOURCES)
+#define STAT_CNT_SEND_FAIL        (STAT_CNT_SEND_OK + 1)
+#define STAT_CNT_RECEIVED         (STAT_CNT_SEND_FAIL + 1)
+#define STAT_CNT_RTT              (STAT_CNT_RECEIVED + 1)           // + bucket
+#define STAT_CNT_LAMP_SEC         (STAT_CNT_RTT + STAT_RTT_BUCKETS) // + lamp slot
+#define STAT_COUNTERS             (STAT_CNT_LAMP_SEC + STAT_MAX_LAMPS)
+
+#if STAT_COUNTERS > 32
+#error "Statistics record mask holds 32 counters"
+#endif
+
+// Record: [magic][len][seq lo][seq hi][time:4][mask:4][varint deltas...][crc]
+#define STAT_REC_MAGIC            0xA7
+#define STAT_REC_HEADER           12
+#define STAT_REC_MAX_LEN          (STAT_REC_HEADER + STAT_COUNTERS * 5 + 1)
+
+//------------------------------------------------------------------
+// Statistics Structures
+//------------------------------------------------------------------
+typedef struct
+{
+  UL time;                                  // Time.now() of the flush
+  UL addr;                                  // in the storage
+  US seq;
+  UC len;
+} StatIndex_t;
+
+//------------------------------------------------------------------
+// Statistics Class
+//------------------------------------------------------------------
+// Counters only ever grow in RAM. Flush() appends a record with the
+// delta of each counter that moved since the previous record, as varints
+// behind a bit mask; an idle period writes nothing. The storage is a
+// ring; records are found again at boot by their magic and checksum.
+// A range query binary-searches the RAM index by time and sums the
+// deltas of the records in range.
+class StatisticsClass
+{
+private:
+  OfflineStorage *m_storage;
+  StatIndex_t m_index[STAT_MAX_RECORDS];    // oldest first
+  UC m_nRecords;
+  UL m_tail;                                // where the next record goes
+  US m_seq;
+
+  UL m_counter[STAT_COUNTERS];
+  UL m_flushed[STAT_COUNTERS];              // values in the last record
+  UL m_lastFlush;
+
+  // Lamp slots are handed out by node ID and kept until reboot
+  UC m_lampNode[STAT_MAX_LAMPS];
+  UL m_lampOnSince[STAT_MAX_LAMPS];         // 0 while off
+
+  // Smoothed RTT in us, fixed point 28.4 (TCP style, gain 1/8)
+  UL m_srtt;
+
+  BOOL ReadRecord(UL addr, UC *rec, UC maxLen);
+  static BOOL Decode(const UC *rec, UL *deltas);
+  void DropRange(UL addr, UC len);
+  void AccrueLamps(UL now);
+  SHORT LampSlot(UC nodeID, BOOL add);
+  SHORT LowerBound(UL time);
+
+public:
+  StatisticsClass();
+
+  // Scan the storage and index the records found
+  BOOL Begin(OfflineStorage *storage);
+
+  void Command(UC source);
+  void Sent(BOOL ok, UL rttUs);
+  void Received() { m_counter[STAT_CNT_RECEIVED]++; }
+  void LampSwitch(UC nodeID, BOOL on);
+
+  // Flush every STAT_FLUSH_INTERVAL
+  void Tick();
+  BOOL Flush();
+
+  // Sum of the deltas recorded in [from, to], returns the record count
+  US Query(UL from, UL to, UL *sums);
+  void Dump(UL from, UL to);
+  UL GetCounter(UC counter) { return m_counter[counter]; }
+  UL GetSmoothedRTT() { return m_srtt >> 4; }
+  UC GetRecordCount() { return m_nRecords; }
+
+  void print();
+};
+
+//------------------------------------------------------------------
+// Function & Class Helper
+//------------------------------------------------------------------
+extern StatisticsClass theStat;
+extern RamOfflineStorage theStatRam;
+
+#endif /* xlxStatistics_h */
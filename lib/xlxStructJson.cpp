@@ -0,0 +1,359 @@
+/**
+ * xlxStructJson.cpp - Xlight schema-bound JSON reader & writer
+ *
+ * Created by Baoshi Sun <bs.sun@datatellit.com>
+ * Copyright (C) 2015-2016 DTIT
+ * Full contributor list:
+ *
+ * Documentation:
+ * Support Forum:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * REVISION HISTORY
+ * Version 1.0 - Created by Baoshi Sun <bs.sun@datatellit.com>
+ *
+ * DESCRIPTION
+ * 1. Each structure has a field map (sjSchema_t) binding JSON keys or array
+ *    positions to its members, with range limits for numbers
+ * 2. The reader walks the JSON text once and writes the members directly,
+ *    no JsonBuffer and no DOM are involved
+ * 3. The writer produces the same format from the same map
+ *
+ * ToDo:
+ * 1. Floating point members
+ *
+**/
+
+#include "xlxStructJson.h"
+#include <ctype.h>
+#include "QuotedString.h"
+#include "StringBuilder.h"
+
+using namespace ArduinoJson::Internals;
+
+//------------------------------------------------------------------
+// Reader
+//------------------------------------------------------------------
+static BOOL sjParseStruct(const char *&p, void *obj, const sjSchema_t &schema);
+
+static void sjSkipSpaces(const char *&p)
+{
+  while( *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n' ) p++;
+}
+
+static BOOL sjSkipChar(const char *&p, char c)
+{
+  sjSkipSpaces(p);
+  if( *p != c ) return false;
+  p++;
+  return true;
+}
+
+static BOOL sjSkipWord(const char *&p, const char *word)
+{
+  size_t len = strlen(word);
+  if( strncmp(p, word, len) ) return false;
+  p += len;
+  return true;
+}
+
+// Copy a quoted string into buf (NULL to drop it), false if it doesn't fit
+static BOOL sjParseString(const char *&p, char *buf, size_t size, US *hash = NULL)
+{
+  char quote = *p;
+  if( quote != '"' && quote != '\'' ) return false;
+  p++;
+
+  uint32_t h = 2166136261UL;
+  size_t len = 0;
+  for( ;; ) {
+    char c = *p++;
+    if( c == '\0' ) return false;
+    if( c == quote ) break;
+    if( c == '\\' ) {
+      c = *p++;
+      switch( c ) {
+      case 'b': c = '\b'; break;
+      case 'f': c = '\f'; break;
+      case 'n': c = '\n'; break;
+      case 'r': c = '\r'; break;
+      case 't': c = '\t'; break;
+      case '\0': return false;
+      }
+    }
+    h = (uint32_t)((h ^ (UC)c) * 16777619UL);
+    if( buf ) {
+      if( len + 1 >= size ) return false;
+      buf[len] = c;
+    }
+    len++;
+  }
+
+  if( buf ) buf[len] = '\0';
+  if( hash ) *hash = (US)(h ^ (h >> 16));
+  return true;
+}
+
+static BOOL sjParseLong(const char *&p, LONG *value)
+{
+  if( sjSkipWord(p, "true") ) { *value = 1; return true; }
+  if( sjSkipWord(p, "false") ) { *value = 0; return true; }
+
+  BOOL negative = (*p == '-');
+  if( negative ) p++;
+  if( *p < '0' || *p > '9' ) return false;
+
+  uint32_t result = 0;
+  while( *p >= '0' && *p <= '9' ) {
+    if( result > 0x7FFFFFFFUL / 10 ) return false;
+    result = result * 10 + (*p++ - '0');
+  }
+  // Fractions are not expected in any of our structures
+  if( *p == '.' || *p == 'e' || *p == 'E' ) return false;
+
+  *value = negative ? -(LONG)result : (LONG)result;
+  return true;
+}
+
+static BOOL sjParseUInt64(const char *&p, uint64_t *value)
+{
+  uint64_t result = 0;
+  if( *p == '"' || *p == '\'' ) {
+    char strBuf[20];
+    if( !sjParseString(p, strBuf, sizeof(strBuf)) ) return false;
+    if( strncmp(strBuf, "0x", 2) && strncmp(strBuf, "0X", 2) ) {
+      result = StringToUInt64(strBuf);
+    } else {
+      for( const char *s = strBuf + 2; *s; s++ ) {
+        if( !isxdigit(*s) ) return false;
+        result = (result << 4) + h2i(*s);
+      }
+    }
+  } else {
+    if( *p < '0' || *p > '9' ) return false;
+    while( *p >= '0' && *p <= '9' ) result = result * 10 + (*p++ - '0');
+  }
+
+  *value = result;
+  return true;
+}
+
+// Skip any JSON value, including nested objects and arrays
+static BOOL sjSkipValue(const char *&p)
+{
+  UC depth = 0;
+  do {
+    sjSkipSpaces(p);
+    switch( *p ) {
+    case '\0':
+      return false;
+    case '"':
+    case '\'':
+      if( !sjParseString(p, NULL, 0) ) return false;
+      break;
+    case '{':
+    case '[':
+      depth++;
+      p++;
+      break;
+    case '}':
+    case ']':
+      if( depth == 0 ) return false;
+      depth--;
+      p++;
+      break;
+    case ',':
+    case ':':
+      if( depth == 0 ) return false;
+      p++;
+      break;
+    default:
+      // number or literal
+      while( *p && !strchr(",:[]{}\"' \t\r\n", *p) ) p++;
+      break;
+    }
+  } while( depth > 0 );
+
+  return true;
+}
+
+static BOOL sjParseField(const char *&p, void *obj, const sjField_t &field)
+{
+  sjSkipSpaces(p);
+  if( sjSkipWord(p, "null") ) return true;
+
+  UC *member = (UC *)obj + field.offset;
+  switch( field.kind ) {
+  case sjfNumber: {
+    LONG value;
+    if( !sjParseLong(p, &value) ) return false;
+    if( value < field.minValue || value > field.maxValue ) return false;
+    field.set(obj, value);
+    return true;
+  }
+
+  case sjfString:
+    return sjParseString(p, (char *)member, field.size);
+
+  case sjfUInt64: {
+    uint64_t value;
+    if( !sjParseUInt64(p, &value) ) return false;
+    memcpy(member, &value, sizeof(value));
+    return true;
+  }
+
+  case sjfStruct:
+    return sjParseStruct(p, member, *field.schema);
+
+  case sjfArray: {
+    if( !sjSkipChar(p, '[') ) return false;
+    if( sjSkipChar(p, ']') ) return true;
+    for( UC i = 0; ; i++ ) {
+      if( i < field.count ) {
+        if( !sjParseStruct(p, member + i * field.size, *field.schema) ) return false;
+      } else {
+        if( !sjSkipValue(p) ) return false;
+      }
+      if( sjSkipChar(p, ']') ) return true;
+      if( !sjSkipChar(p, ',') ) return false;
+    }
+  }
+  }
+
+  return false;
+}
+
+static const sjField_t *sjFindField(const sjSchema_t &schema, const char *key, US hash)
+{
+  for( UC i = 0; i < schema.numFields; i++ ) {
+    const sjField_t &field = schema.fields[i];
+    if( field.keyHash == hash && strcmp(field.key, key) == 0 ) return &field;
+  }
+  return NULL;
+}
+
+static BOOL sjParseStruct(const char *&p, void *obj, const sjSchema_t &schema)
+{
+  sjSkipSpaces(p);
+
+  // Positional form: [v0, v1, ...] in field map order
+  if( *p == '[' ) {
+    p++;
+    if( sjSkipChar(p, ']') ) return true;
+    for( UC i = 0; ; i++ ) {
+      if( i < schema.numFields ) {
+        if( !sjParseField(p, obj, schema.fields[i]) ) return false;
+      } else {
+        if( !sjSkipValue(p) ) return false;
+      }
+      if( sjSkipChar(p, ']') ) return true;
+      if( !sjSkipChar(p, ',') ) return false;
+    }
+  }
+
+  // Keyed form: {"key": value, ...}
+  if( !sjSkipChar(p, '{') ) return false;
+  if( sjSkipChar(p, '}') ) return true;
+  for( ;; ) {
+    char strKey[24];
+    US hash;
+    sjSkipSpaces(p);
+    const char *keyStart = p;
+    if( !sjParseString(p, strKey, sizeof(strKey), &hash) ) {
+      // A key longer than any of ours can't match, just step over it
+      p = keyStart;
+      if( !sjParseString(p, NULL, 0) ) return false;
+      strKey[0] = '\0';
+      hash = 0;
+    }
+    if( !sjSkipChar(p, ':') ) return false;
+
+    const sjField_t *field = (strKey[0] ? sjFindField(schema, strKey, hash) : NULL);
+    if( field ) {
+      if( !sjParseField(p, obj, *field) ) return false;
+    } else {
+      if( !sjSkipValue(p) ) return false;
+    }
+
+    if( sjSkipChar(p, '}') ) return true;
+    if( !sjSkipChar(p, ',') ) return false;
+  }
+}
+
+BOOL sjDecode(const char *json, void *obj, const sjSchema_t &schema)
+{
+  if( !json ) return false;
+  const char *p = json;
+  if( !sjParseStruct(p, obj, schema) ) return false;
+  sjSkipSpaces(p);
+  return (*p == '\0');
+}
+
+//------------------------------------------------------------------
+// Writer
+//------------------------------------------------------------------
+static size_t sjEncodeField(const void *obj, const sjField_t &field, Print &out)
+{
+  const UC *member = (const UC *)obj + field.offset;
+  switch( field.kind ) {
+  case sjfNumber:
+    return out.print(field.get(obj));
+
+  case sjfString: {
+    // The member may be full, print a terminated copy
+    char strBuf[64];
+    size_t len = (field.size < sizeof(strBuf) ? field.size : sizeof(strBuf)) - 1;
+    strncpy(strBuf, (const char *)member, len);
+    strBuf[len] = '\0';
+    return QuotedString::printTo(strBuf, out);
+  }
+
+  case sjfUInt64: {
+    uint64_t value;
+    memcpy(&value, member, sizeof(value));
+    char strBuf[24];
+    sprintf(strBuf, "\"0x%08lX%08lX\"", (UL)(value >> 32), (UL)(value & 0xFFFFFFFFUL));
+    return out.print(strBuf);
+  }
+
+  case sjfStruct:
+    return sjEncode(member, *field.schema, out);
+
+  case sjfArray: {
+    size_t n = out.write('[');
+    for( UC i = 0; i < field.count; i++ ) {
+      if( i > 0 ) n += out.write(',');
+      n += sjEncode(member + i * field.size, *field.schema, out);
+    }
+    return n + out.write(']');
+  }
+  }
+
+  return out.print("null");
+}
+
+size_t sjEncode(const void *obj, const sjSchema_t &schema, Print &out)
+{
+  size_t n = out.write(schema.positional ? '[' : '{');
+  for( UC i = 0; i < schema.numFields; i++ ) {
+    const sjField_t &field = schema.fields[i];
+    if( i > 0 ) n += out.write(',');
+    if( !schema.positional ) {
+      n += QuotedString::printTo(field.key, out);
+      n += out.write(':');
+    }
+    n += sjEncodeField(obj, field, out);
+  }
+  return n + out.write(schema.positional ? ']' : '}');
+}
+
+size_t sjEncode(const void *obj, const sjSchema_t &schema, char *buf, size_t size)
+{
+  StringBuilder sb(buf, size);
+  return sjEncode(obj, schema, sb);
+}
@@ -0,0 +1,119 @@
+//  xlxStructJson.h - Xlight schema-bound JSON reader & writer for data structures
+
+#ifndef xlxStructJson_h
+#define xlxStructJson_h
+
+#include "xliCommon.h"
+#include <stddef.h>
+
+//------------------------------------------------------------------
+// Field Map Definitions
+//------------------------------------------------------------------
+// What a JSON key (or array position) is bound to
+typedef enum
+{
+  sjfNumber = 0,            // integer or bitfield via accessors, range checked
+  sjfString,                // char array, always '\0' terminated
+  sjfUInt64,                // uint64_t, number or "0x" hex string
+  sjfStruct,                // nested structure with its own schema
+  sjfArray                  // fixed array of nested structures
+} sjFieldKind_t;
+
+struct sjSchema_t;
+
+typedef struct
+{
+  const char *key;
+  US keyHash;                               // sjKeyHash(key)
+  UC kind;                                  // sjFieldKind_t
+  LONG minValue;                            // sjfNumber range
+  LONG maxValue;
+  LONG (*get)(const void *obj);             // sjfNumber accessors
+  void (*set)(void *obj, LONG value);
+  US offset;                                // other kinds: member offset
+  US size;                                  // member or element size
+  UC count;                                 // sjfArray element count
+  const sjSchema_t *schema;                 // sjfStruct & sjfArray
+} sjField_t;
+
+typedef struct sjSchema_t
+{
+  const sjField_t *fields;
+  UC numFields;
+  BOOL positional;                          // written as array, e.g. Hue_t
+} sjSchema_t;
+
+// FNV-1a folded to 16 bits, evaluated at compile time for the key tables
+constexpr uint32_t sjHashStep(const char *s, uint32_t h)
+{
+  return *s ? sjHashStep(s + 1, (uint32_t)((h ^ (UC)*s) * 16777619UL)) : h;
+}
+
+constexpr US sjKeyHash(const char *s)
+{
+  return (US)(sjHashStep(s, 2166136261UL) ^ (sjHashStep(s, 2166136261UL) >> 16));
+}
+
+// Bitfields can't be addressed, so number fields go through accessors
+#define SJ_ACCESSORS(T, m) \
+  static LONG sjGet_##T##_##m(const void *obj) { return ((const T *)obj)->m; } \
+  static void sjSet_##T##_##m(void *obj, LONG value) { ((T *)obj)->m = value; }
+
+#define SJ_NUMBER(T, key, m, lo, hi) \
+  {key, sjKeyHash(key), sjfNumber, lo, hi, sjGet_##T##_##m, sjSet_##T##_##m, 0, 0, 0, NULL}
+
+#define SJ_STRING(T, key, m) \
+  {key, sjKeyHash(key), sjfString, 0, 0, NULL, NULL, offsetof(T, m), sizeof(((T *)0)->m), 1, NULL}
+
+#define SJ_UINT64(T, key, m) \
+  {key, sjKeyHash(key), sjfUInt64, 0, 0, NULL, NULL, offsetof(T, m), sizeof(uint64_t), 1, NULL}
+
+#define SJ_STRUCT(T, key, m, S) \
+  {key, sjKeyHash(key), sjfStruct, 0, 0, NULL, NULL, offsetof(T, m), sizeof(S), 1, &JsonSchema<S>::schema}
+
+#define SJ_ARRAY(T, key, m, S) \
+  {key, sjKeyHash(key), sjfArray, 0, 0, NULL, NULL, offsetof(T, m), sizeof(S), \
+   sizeof(((T *)0)->m) / sizeof(S), &JsonSchema<S>::schema}
+
+#define SJ_SCHEMA(T, fieldTable, isPositional) \
+  const sjSchema_t JsonSchema<T>::schema = \
+    {fieldTable, sizeof(fieldTable) / sizeof(sjField_t), isPositional}
+
+// Specialized next to each structure, see xlxConfig.h
+template <typename T> struct JsonSchema;
+
+//------------------------------------------------------------------
+// Reader & Writer
+//------------------------------------------------------------------
+// Decode one JSON object (by key) or array (by position) into obj.
+// Unknown keys and extra elements are skipped, null leaves a field as is.
+// Returns false on syntax error or out of range value; obj may then be
+// partially written, use JsonToStruct() for all or nothing.
+BOOL sjDecode(const char *json, void *obj, const sjSchema_t &schema);
+
+// Write obj as JSON, returns the number of bytes written
+size_t sjEncode(const void *obj, const sjSchema_t &schema, Print &out);
+size_t sjEncode(const void *obj, const sjSchema_t &schema, char *buf, size_t size);
+
+template <typename T>
+BOOL JsonToStruct(const char *json, T &obj)
+{
+  T temp = obj;
+  if( !sjDecode(json, &temp, JsonSchema<T>::schema) ) return false;
+  obj = temp;
+  return true;
+}
+
+template <typename T>
+size_t StructToJson(const T &obj, Print &out)
+{
+  return sjEncode(&obj, JsonSchema<T>::schema, out);
+}
+
+template <typename T>
+size_t StructToJson(const T &obj, char *buf, size_t size)
+{
+  return sjEncode(&obj, JsonSchema<T>::schema, buf, size);
+}
+
+#endif /* xlxStructJson_h */
@@ -0,0 +1,155 @@
+/**
+ * xlxTaskList.cpp - Xlight cooperative tasks of the main loop
+ *
+ * Created by Baoshi Sun <bs.sun@datatellit.com>
+ * Copyright (C) 2015-2016 DTIT
+ * Full contributor list:
+ *
+ * Documentation:
+ * Support Forum:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ *******************************
+ *
+ * REVISION HISTORY
+ * Version 1.0 - Created by Baoshi Sun <bs.sun@datatellit.com>
+ *
+ * DESCRIPTION
+ * 1. A task has a period, an input check, or both; it runs when its period
+ *    is up or its input check says there is something to do
+ * 2. Between passes the loop sleeps until the earliest deadline, polling
+ *    the input checks every millisecond
+ * 3. Each task may time into a profiler probe; the pass itself, without
+ *    the sleep, goes into PERF_LOOP. With MAINLOOP_TIMER every probed run
+ *    is also printed
+ *
+ * ToDo:
+ * 1. Wake on the RF24 IRQ pin instead of polling the radio
+ *
+**/
+
+#include "xlxTaskList.h"
+
+//------------------------------------------------------------------
+// the one and only instance of TaskListClass
+TaskListClass theTasks;
+
+//------------------------------------------------------------------
+// Xlight Task List Class
+//------------------------------------------------------------------
+TaskListClass::TaskListClass()
+{
+  memset(m_tasks, 0x00, sizeof(m_tasks));
+  m_count = 0;
+  m_passes = 0;
+  m_wakeups = 0;
+  m_sleptMs = 0;
+}
+
+UC TaskListClass::Add(const char *name, TaskFunc_t run, UL period, TaskReady_t ready, UC probe)
+{
+  if( m_count >= TASK_MAX_TASKS || !run ) {
+    // A task that isn't added never runs, say so
+    SERIAL_LN("Task %s not added, %d of %d in use", (name ? name : "?"), m_count, TASK_MAX_TASKS);
+    return TASK_NONE;
+  }
+
+  Task_t &task = m_tasks[m_count];
+  task.name = name;
+  task.run = run;
+  task.ready = ready;
+  task.period = period;
+  task.due = millis() + period;
+  task.runs = 0;
+  task.probe = probe;
+  task.enabled = true;
+  return m_count++;
+}
+
+void TaskListClass::Enable(UC task, BOOL on)
+{
+  if( task >= m_count ) return;
+  m_tasks[task].enabled = on;
+  if( on ) m_tasks[task].due = millis() + m_tasks[task].period;
+}
+
+void TaskListClass::Trigger(UC task)
+{
+  if( task < m_count ) m_tasks[task].due = millis();
+}
+
+BOOL TaskListClass::AnyReady()
+{
+  for( UC i = 0; i < m_count; i++ ) {
+    if( m_tasks[i].enabled && m_tasks[i].ready && m_tasks[i].ready() ) return true;
+  }
+  return false;
+}
+
+void TaskListClass::Run(UL maxSleepMs)
+{
+  UL passStart = micros();
+  m_passes++;
+
+  for( UC i = 0; i < m_count; i++ ) {
+    Task_t &task = m_tasks[i];
+    if( !task.enabled ) continue;
+
+    UL now = millis();
+    BOOL isDue = (task.period > 0 && (LONG)(now - task.due) >= 0);
+    if( !isDue && !(task.ready && task.ready()) ) continue;
+
+    // Next period counts from this run, whatever started it
+    if( task.period > 0 ) task.due = now + task.period;
+    UL taskStart = micros();
+    task.run();
+    if( task.probe != TASK_NONE ) {
+      UL taskSpent = micros() - taskStart;
+      theProfiler.Record(task.probe, taskSpent);
+#ifdef MAINLOOP_TIMER
+      SERIAL_LN("%s spent %lu us", theProfiler.GetName(task.probe), taskSpent);
+#endif
+    }
+    task.runs++;
+  }
+  theProfiler.Record(PERF_LOOP, micros() - passStart);
+
+  // Sleep until the earliest deadline, or input
+  UL now = millis();
+  UL sleepMs = maxSleepMs;
+  for( UC i = 0; i < m_count; i++ ) {
+    const Task_t &task = m_tasks[i];
+    if( !task.enabled || task.period == 0 ) continue;
+    LONG left = (LONG)(task.due - now);
+    if( left <= 0 ) return;
+    if( (UL)left < sleepMs ) sleepMs = left;
+  }
+  while( millis() - now < sleepMs ) {
+    if( AnyReady() ) {
+      m_wakeups++;
+      break;
+    }
+    delay(1);
+  }
+  m_sleptMs += millis() - now;
+}
+
+void TaskListClass::print()
+{
+  UL now = millis();
+  SERIAL_LN("** Tasks: %d, %lu passes, %lu woken by input, %lu%% asleep **", m_count, m_passes, m_wakeups,
+      (now ? (UL)((uint64_t)m_sleptMs * 100 / now) : 0));
+  for( UC i = 0; i < m_count; i++ ) {
+    const Task_t &task = m_tasks[i];
+    if( task.period > 0 ) {
+      SERIAL_LN("  %-8s %-3s every %5lu ms%s, %lu runs, due in %ld ms", task.name, (task.enabled ? "on" : "off"),
+          task.period, (task.ready ? " or input" : ""), task.runs, (LONG)(task.due - now));
+    } else {
+      SERIAL_LN("  %-8s %-3s on input, %lu runs", task.name, (task.enabled ? "on" : "off"), task.runs);
+    }
+  }
+  SERIAL_LN("");
+}
@@ -0,0 +1,72 @@
+//  xlxTaskList.h - Xlight cooperative tasks of the main loop
+
+#ifndef xlxTaskList_h
+#define xlxTaskList_h
+
+#include "xliCommon.h"
+#include "xlxProfiler.h"
+
+#define TASK_MAX_TASKS            16          // with room to spare, see InitTasks()
+#define TASK_MAX_SLEEP            1000        // ms, longest sleep between passes
+#define TASK_NONE                 0xFF
+
+// Task body, and the check for input that wakes a task early
+typedef void (*TaskFunc_t)();
+typedef BOOL (*TaskReady_t)();
+
+//------------------------------------------------------------------
+// Task Structures
+//------------------------------------------------------------------
+typedef struct
+{
+  const char *name;
+  TaskFunc_t run;
+  TaskReady_t ready;                        // NULL if periodic only
+  UL period;                                // ms, 0 if on input only
+  UL due;                                   // millis() of the next periodic run
+  UL runs;
+  UC probe;                                 // PERF_*, or TASK_NONE
+  BOOL enabled;
+} Task_t;
+
+//------------------------------------------------------------------
+// Task List Class
+//------------------------------------------------------------------
+// Run() makes one pass over the tasks, in the order they were added, and
+// runs those that are due or whose ready() reports input. It then sleeps
+// in 1 ms steps until the earliest deadline, or until a ready() check
+// turns true, so input is served within a millisecond or two instead of
+// waiting out a fixed loop delay.
+class TaskListClass
+{
+private:
+  Task_t m_tasks[TASK_MAX_TASKS];
+  UC m_count;
+
+  // Statistics
+  UL m_passes;
+  UL m_wakeups;                             // sleeps cut short by input
+  UL m_sleptMs;
+
+  BOOL AnyReady();
+
+public:
+  TaskListClass();
+
+  // Returns the task ID, or TASK_NONE if the list is full
+  UC Add(const char *name, TaskFunc_t run, UL period, TaskReady_t ready = NULL, UC probe = TASK_NONE);
+  void Enable(UC task, BOOL on);
+  // Run on the next pass
+  void Trigger(UC task);
+
+  void Run(UL maxSleepMs = TASK_MAX_SLEEP);
+
+  void print();
+};
+
+//------------------------------------------------------------------
+// Function & Class Helper
+//------------------------------------------------------------------
+extern TaskListClass theTasks;
+
+#endif /* xlxTaskList_h */
@@ -37,6 +37,18 @@ SerialCommand::SerialCommand()
 	currentCommand = 0;
 	currentState = 0;
 	prevState = 0;
+	prevChar = 0;
+	overflow = false;
+	rxHead = rxTail = rxPeak = 0;
+	echoLen = 0;
+	escState = 0;
+	histCount = 0;
+	histNewest = 0;
+	histBrowse = -1;
+	rawMode = false;
+	rawLines = rawTooLong = 0;
+	indexFull = false;
+	memset(dispatchIndex, SERIALCOMMAND_NO_ENTRY, sizeof(dispatchIndex));
 	clearBuffer();
 	CommandList = NULL;
 }
@@ -52,6 +64,18 @@ SerialCommand::SerialCommand(SoftwareSerial &_SoftSer)
 	currentCommand = 0;
 	currentState = 0;
 	prevState = 0;
+	prevChar = 0;
+	overflow = false;
+	rxHead = rxTail = rxPeak = 0;
+	echoLen = 0;
+	escState = 0;
+	histCount = 0;
+	histNewest = 0;
+	histBrowse = -1;
+	rawMode = false;
+	rawLines = rawTooLong = 0;
+	indexFull = false;
+	memset(dispatchIndex, SERIALCOMMAND_NO_ENTRY, sizeof(dispatchIndex));
 	clearBuffer();
 	CommandList = NULL;
 }
@@ -63,7 +87,7 @@ SerialCommand::SerialCommand(SoftwareSerial &_SoftSer)
 //
 void SerialCommand::clearBuffer()
 {
-	for(int i=0; i<SERIALCOMMANDBUFFER; i++) {
+	for(int i=0; i<SERIALCOMMAND_LINE_SIZE; i++) {
 		buffer[i] = 0;
 	}
 	bufPos=0;
@@ -88,43 +112,198 @@ char *SerialCommand::next()
 	return nextToken;
 }
 
+// Moves whatever the port has into the receive ring, in as few reads as
+// the ring's wrap allows. When the ring is full the rest waits in the port.
+// Called before every line and from the console's ready check, so the
+// port is drained every pass of the main loop even while a script runs.
+bool SerialCommand::fillInput()
+{
+	Stream *port = &TheSerial;
+	#ifndef SERIALCOMMAND_HARDWAREONLY
+	if (usingSoftwareSerial) port = SoftSerial;
+	#endif
+
+	int avail;
+	while ((avail = port->available()) > 0) {
+		// Contiguous room from the head, one slot stays free to tell full from empty
+		int room = (rxTail > rxHead ? rxTail - rxHead - 1 : SERIALCOMMAND_RX_SIZE - rxHead - (rxTail == 0 ? 1 : 0));
+		if (room <= 0) break;
+		int n = port->readBytes(rxRing + rxHead, (avail < room ? avail : room));
+		if (n <= 0) break;
+		rxHead = (rxHead + n) % SERIALCOMMAND_RX_SIZE;
+	}
+
+	uint16_t count = (rxHead + SERIALCOMMAND_RX_SIZE - rxTail) % SERIALCOMMAND_RX_SIZE;
+	if (count > rxPeak) rxPeak = count;
+	return (count > 0);
+}
+
 // This checks the Serial stream for characters, and assembles them into a buffer.
 // When the terminator character (default '\r') is seen, it starts parsing the
-// buffer for a prefix command, and calls handlers setup by addCommand() member
+// buffer for a prefix command, and calls handlers setup by addCommand() member.
+// One command per call, the rest stays in the receive ring for the next one.
 bool SerialCommand::readSerial()
 {
-	// If we're using the Hardware port, check it.   Otherwise check the user-created SoftwareSerial Port
-	#ifdef SERIALCOMMAND_HARDWAREONLY
-	while (TheSerial.available() > 0)
-	#else
-	while ((usingSoftwareSerial==0 && TheSerial.available() > 0) || (usingSoftwareSerial==1 && SoftSerial->available() > 0) )
-	#endif
-	{
-		if (!usingSoftwareSerial) {
-			// Hardware serial port
-			inChar=TheSerial.read();   // Read single available character, there may be more waiting
-		} else {
-			#ifndef SERIALCOMMAND_HARDWAREONLY
-			// SoftwareSerial port
-			inChar = SoftSerial->read();   // Read single available character, there may be more waiting
-			#endif
-		}
+	fillInput();
+
+	while (rxTail != rxHead) {
+		inChar = rxRing[rxTail];
+		rxTail = (rxTail + 1) % SERIALCOMMAND_RX_SIZE;
+
+		// "\r\n" is one terminator
+		char lastChar = prevChar;
+		prevChar = inChar;
+		if (inChar == '\n' && lastChar == '\r') continue;
 
-		SERIAL("%c", inChar);   	// Echo back to serial stream
+		if (rawMode) {
+			if (inChar == 0x03 || inChar == 0x04) {    // Ctrl-C, Ctrl-D
+				setRawMode(false);
+				continue;
+			}
+		} else if (escState == 1) {
+			// ESC [ or ESC O, then the key
+			escState = (inChar == '[' || inChar == 'O' ? 2 : 0);
+			continue;
+		} else if (escState >= 2) {
+			if (inChar >= '0' && inChar <= '9') {
+				escState = 3;     // ESC [ 3 ~ and the like, ignored up to the '~'
+				continue;
+			}
+			if (escState == 2 && inChar == 'A') recallHistory(true);
+			if (escState == 2 && inChar == 'B') recallHistory(false);
+			escState = 0;
+			continue;
+		} else if (inChar == 0x1B) {
+			escState = 1;
+			continue;
+		} else if (inChar == 0x08 || inChar == 0x7F) {    // Backspace, DEL
+			if (bufPos > 0 && !overflow) {
+				buffer[--bufPos] = '\0';
+				echoChar('\b'); echoChar(' '); echoChar('\b');
+			}
+			continue;
+		} else if (inChar == '\t') {
+			completeLine();
+			continue;
+		} else if (inChar == 0x03 || inChar == 0x15) {    // Ctrl-C, Ctrl-U
+			eraseLine();
+			clearBuffer();
+			overflow = false;
+			histBrowse = -1;
+			continue;
+		}
 
 		if (inChar == '\r' || inChar == '\n') {     // Check for the terminator meaning end of command string
+			if (!rawMode) echoChar(inChar);
+			echoFlush();
+			histBrowse = -1;
+
+			if (overflow) {
+				overflow = false;
+				clearBuffer();
+				if (rawMode) rawTooLong++;
+				SERIAL_LN("\r\nLine too long, %d characters at most, ignored", SERIALCOMMAND_LINE_SIZE - 1);
+				SERIAL_FLUSH();
+				return true;
+			}
+
+			if (rawMode) {
+				// Blank lines and comments in a script
+				if (bufPos == 0 || buffer[0] == '#') {
+					clearBuffer();
+					continue;
+				}
+				rawLines++;
+			} else {
+				addHistory();
+			}
+
+			SERIAL_FLUSH();
 			IF_SERIAL_DEBUG(SERIAL_LN("Received: %s", buffer));
 			return scanStateMachine();
 		} else if (isprint(inChar))	{
 			// Only printable characters into the buffer
-			buffer[bufPos++] = inChar;   	// Put character into buffer
-			if (bufPos > SERIALCOMMANDBUFFER-1) bufPos=0; // wrap buffer around if full
+			if (bufPos < SERIALCOMMAND_LINE_SIZE - 1) {
+				buffer[bufPos++] = inChar;   	// Put character into buffer
+				if (!rawMode) echoChar(inChar);
+			} else if (!overflow) {
+				overflow = true;
+				if (!rawMode) echoChar('\a');
+			}
 		}
 	}
 
+	echoFlush();
+	SERIAL_FLUSH();
 	return true;
 }
 
+void SerialCommand::setRawMode(bool on)
+{
+	if (on == rawMode) return;
+	rawMode = on;
+	clearBuffer();
+	overflow = false;
+	escState = 0;
+	if (on) {
+		rawLines = rawTooLong = 0;
+		rxPeak = 0;
+		SERIAL_LN("Raw mode: paste the script, Ctrl-D or 'set raw 0' to finish");
+	} else {
+		SERIAL_LN("Raw mode off: %lu line(s) run, %lu too long, receive ring peaked at %d of %d bytes",
+				rawLines, rawTooLong, rxPeak, SERIALCOMMAND_RX_SIZE - 1);
+	}
+}
+
+void SerialCommand::echoChar(char c)
+{
+	if (echoLen >= SERIALCOMMAND_ECHO_SIZE) echoFlush();
+	echo[echoLen++] = c;
+}
+
+// Echo back to serial stream, buffered
+void SerialCommand::echoFlush()
+{
+	if (echoLen == 0) return;
+	theOutput.write((const uint8_t *)echo, echoLen);
+	echoLen = 0;
+}
+
+// Take the current line off the screen
+void SerialCommand::eraseLine()
+{
+	for (int i = 0; i < bufPos; i++) {
+		echoChar('\b'); echoChar(' '); echoChar('\b');
+	}
+}
+
+void SerialCommand::addHistory()
+{
+	if (bufPos == 0) return;
+	// A repeat of the latest line isn't kept twice
+	if (histCount > 0 && strcmp(history[histNewest], buffer) == 0) return;
+	histNewest = (histNewest + 1) % SERIALCOMMAND_HISTORY;
+	strcpy(history[histNewest], buffer);
+	if (histCount < SERIALCOMMAND_HISTORY) histCount++;
+}
+
+// Up arrow goes back a line, down arrow forward to the empty line
+void SerialCommand::recallHistory(bool older)
+{
+	int pos = histBrowse + (older ? 1 : -1);
+	if (pos >= histCount || pos < -1) return;
+
+	eraseLine();
+	clearBuffer();
+	overflow = false;
+	histBrowse = pos;
+	if (pos >= 0) {
+		strcpy(buffer, history[(histNewest + SERIALCOMMAND_HISTORY - pos) % SERIALCOMMAND_HISTORY]);
+		bufPos = strlen(buffer);
+		for (int i = 0; i < bufPos; i++) echoChar(buffer[i]);
+	}
+}
+
 bool SerialCommand::scanStateMachine()
 {
 	if( !CommandList )
@@ -139,31 +318,23 @@ bool SerialCommand::scanStateMachine()
 	} else {
 		token = next();
 	}
-	int i = findFirstCommand(currentState);
-	for (; i<numCommand; i++) {
-		if( currentState != (uint8_t)(CommandList[i].state) )
-			break;
-
-	  // Compare the found event against the list of known events in the same state for a match
-		if (strlen(CommandList[i].event) == 0 ||
-		    strnicmp(token, CommandList[i].event, SERIALCOMMANDBUFFER) == 0)
-		{
-			currentCommand = i;
-			matched = true;
-			prevState = currentState;
-			currentState = (uint8_t)(CommandList[i].next);			// Change to the next state
-
-			IF_SERIAL_DEBUG(SERIAL_LN("Matched Command: %s in state %d, index=%d", token, currentState, i));
-
-			// Execute the stored handler function for the command
-			if( CommandList[i].function ) {
-				bRunCmd = (*CommandList[i].function)(token);
-			} else {
-				bRunCmd = callbackCommand(token);
-			}
-			clearBuffer();
-			break;
+	// Look the token up among the known events in the current state
+	int i = findCommand(currentState, token);
+	if (i < numCommand) {
+		currentCommand = i;
+		matched = true;
+		prevState = currentState;
+		currentState = (uint8_t)(CommandList[i].next);			// Change to the next state
+
+		IF_SERIAL_DEBUG(SERIAL_LN("Matched Command: %s in state %d, index=%d", token, currentState, i));
+
+		// Execute the stored handler function for the command
+		if( CommandList[i].function ) {
+			bRunCmd = (*CommandList[i].function)(token);
+		} else {
+			bRunCmd = callbackCommand(token);
 		}
+		clearBuffer();
 	}
 
 	// No macthed item found
@@ -202,13 +373,158 @@ int SerialCommand::findFirstCommand(uint8_t state)
 	return nFound;
 }
 
+// FNV-1a over the state and the lower-cased event
+static uint16_t hashEvent(uint8_t state, const char *event)
+{
+	uint32_t h = 2166136261UL;
+	h = (h ^ state) * 16777619UL;
+	for (int n = 0; *event && n < SERIALCOMMANDBUFFER; n++) {
+		h = (h ^ (uint8_t)tolower(*event++)) * 16777619UL;
+	}
+	return (uint16_t)(h & (SERIALCOMMAND_INDEX_SIZE - 1));
+}
+
+// Put every item with an event into the index. Defaults ("") stay out,
+// they are found after the items of their state.
+void SerialCommand::buildIndex()
+{
+	memset(dispatchIndex, SERIALCOMMAND_NO_ENTRY, sizeof(dispatchIndex));
+	indexFull = false;
+
+	int indexed = 0;
+	for (int i = 0; i < numCommand; i++) {
+		if (CommandList[i].event[0] == '\0') continue;
+		if (i >= SERIALCOMMAND_NO_ENTRY || indexed >= SERIALCOMMAND_INDEX_SIZE / 2) {
+			indexFull = true;
+			break;
+		}
+		uint16_t slot = hashEvent(CommandList[i].state, CommandList[i].event);
+		while (dispatchIndex[slot] != SERIALCOMMAND_NO_ENTRY) slot = (slot + 1) & (SERIALCOMMAND_INDEX_SIZE - 1);
+		// Earlier items get the earlier slots, so the first of two equal events wins
+		dispatchIndex[slot] = i;
+		indexed++;
+	}
+
+	if (indexFull) SERIAL_LN("Command index full at %d items, the rest is scanned", indexed);
+}
+
+// The item for an event in a state: the exact event, else the only one it
+// is a prefix of unless that one must be typed in full, else the state's
+// default. numCommand if none.
+int SerialCommand::findCommand(uint8_t state, const char *event)
+{
+	int i;
+	if (event && event[0]) {
+		if (!indexFull) {
+			uint16_t slot = hashEvent(state, event);
+			while ((i = dispatchIndex[slot]) != SERIALCOMMAND_NO_ENTRY) {
+				if (CommandList[i].state == state && strnicmp(event, CommandList[i].event, SERIALCOMMANDBUFFER) == 0)
+					return i;
+				slot = (slot + 1) & (SERIALCOMMAND_INDEX_SIZE - 1);
+			}
+		} else {
+			for (i = findFirstCommand(state); i < numCommand && CommandList[i].state == state; i++) {
+				if (CommandList[i].event[0] && strnicmp(event, CommandList[i].event, SERIALCOMMANDBUFFER) == 0)
+					return i;
+			}
+		}
+
+		// e.g. "sh" for "show", but not "r" for "reset"
+		int count;
+		i = findByPrefix(state, event, strlen(event), count);
+		if (count == 1 && !(CommandList[i].flags & SERIALCOMMAND_EXACT)) return i;
+	}
+
+	for (i = findFirstCommand(state); i < numCommand && CommandList[i].state == state; i++) {
+		if (CommandList[i].event[0] == '\0') return i;
+	}
+	return numCommand;
+}
+
+// First item in a state whose event starts with prefix, and how many do
+int SerialCommand::findByPrefix(uint8_t state, const char *prefix, int len, int &count)
+{
+	int found = numCommand;
+	count = 0;
+	for (int i = findFirstCommand(state); i < numCommand && CommandList[i].state == state; i++) {
+		const char *ev = CommandList[i].event;
+		if (ev[0] == '\0' || strnicmp(ev, prefix, len) != 0) continue;
+		if (count++ == 0) found = i;
+	}
+	return found;
+}
+
+// Tab: complete the word being typed. Words before it are walked through
+// the state machine for as long as they change the state, e.g. "sys r"
+// completes in the sys menu; after "show" it is up to the handler.
+void SerialCommand::completeLine()
+{
+	if (!CommandList || overflow) return;
+
+	uint8_t state = currentState;
+	char word[SERIALCOMMANDBUFFER];
+	const char *p = buffer;
+	while (true) {
+		while (*p == ' ') p++;
+		const char *end = strchr(p, ' ');
+		if (!end) break;
+		int len = end - p;
+		if (len >= SERIALCOMMANDBUFFER) return;
+		memcpy(word, p, len);
+		word[len] = '\0';
+		int i = findCommand(state, word);
+		if (i >= numCommand || CommandList[i].event[0] == '\0' || CommandList[i].next == state) return;
+		state = CommandList[i].next;
+		p = end;
+	}
+
+	int len = strlen(p);
+	int count;
+	int first = findByPrefix(state, p, len, count);
+	if (count == 0) return;
+
+	// Longest common prefix of the candidates
+	const char *cand = CommandList[first].event;
+	int common = strlen(cand);
+	for (int i = first + 1; i < numCommand && CommandList[i].state == state; i++) {
+		const char *ev = CommandList[i].event;
+		if (ev[0] == '\0' || strnicmp(ev, p, len) != 0) continue;
+		int k = len;
+		while (k < common && tolower(ev[k]) == tolower(cand[k])) k++;
+		common = k;
+	}
+
+	if (common > len || count == 1) {
+		for (int k = len; k < common && bufPos < SERIALCOMMAND_LINE_SIZE - 1; k++) {
+			buffer[bufPos++] = cand[k];
+			echoChar(cand[k]);
+		}
+		if (count == 1 && bufPos < SERIALCOMMAND_LINE_SIZE - 1) {
+			buffer[bufPos++] = ' ';
+			echoChar(' ');
+		}
+		buffer[bufPos] = '\0';
+	} else {
+		// Nothing to add, list them and type the line again
+		echoFlush();
+		SERIAL("\r\n");
+		for (int i = first; i < numCommand && CommandList[i].state == state; i++) {
+			const char *ev = CommandList[i].event;
+			if (ev[0] && strnicmp(ev, p, len) == 0) SERIAL("%s  ", ev);
+		}
+		SERIAL("\r\n");
+		for (int k = 0; k < bufPos; k++) echoChar(buffer[k]);
+	}
+}
+
 // Manully set command buffer
 void SerialCommand::setCommandBuffer(const char *cmd)
 {
-	int len = min(SERIALCOMMANDBUFFER, strlen(cmd));
+	int len = strlen(cmd);
+	if (len > SERIALCOMMAND_LINE_SIZE - 1) len = SERIALCOMMAND_LINE_SIZE - 1;
 	strncpy(buffer, cmd, len);
+	buffer[len] = '\0';
 	bufPos = len;
-	if (bufPos > SERIALCOMMANDBUFFER-1) bufPos=0; // wrap buffer around if full
 }
 
 void SerialCommand::SetStateMachine(const StateMachine_t *newSM, int sizeSM, uint8_t initState)
@@ -219,6 +535,7 @@ void SerialCommand::SetStateMachine(const StateMachine_t *newSM, int sizeSM, uin
 	currentState = initState;
 	prevState = initState;
 	clearBuffer();
+	buildIndex();
 
 	IF_SERIAL_DEBUG(SERIAL_LN("Setup State Machine of %d items with initial state %d", sizeSM, initState));
 }
@@ -21,6 +21,12 @@ Jul 2016 - By Baoshi Sun
            1. Rewriten to support Particle Photon
            2. Added argument suport to command callback function
 					 3. Apply FSM
+Oct 2016 - 1. Bulk reads into a receive ring, echo in runs
+           2. Configurable line size, over-long lines are reported and ignored
+           3. Backspace, Ctrl-U and up/down arrow history
+           4. Raw mode for pasted scripts: no echo, comments and blank lines skipped
+Oct 2016 - 1. Events are pointers to strings instead of 32-byte arrays
+           2. Hashed dispatch index, unique prefix matching and Tab completion
 
 This library is free software; you can redistribute it and/or
 modify it under the terms of the GNU Lesser General Public
@@ -60,15 +66,32 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <SoftwareSerial.h>
 #endif
 
-#define SERIALCOMMANDBUFFER 32          // Maximum length of a command
+#define SERIALCOMMANDBUFFER 32          // Maximum length of an event string
+
+#ifndef SERIALCOMMAND_LINE_SIZE
+#define SERIALCOMMAND_LINE_SIZE 128     // Maximum length of a command line, including the '\0'
+#endif
+#ifndef SERIALCOMMAND_RX_SIZE
+#define SERIALCOMMAND_RX_SIZE   512     // Receive ring, holds a pasted script while commands run
+#endif
+#ifndef SERIALCOMMAND_HISTORY
+#define SERIALCOMMAND_HISTORY   4       // Lines kept for up/down arrow recall
+#endif
+#define SERIALCOMMAND_ECHO_SIZE 32      // Echo is collected and written in runs of up to this
+#ifndef SERIALCOMMAND_INDEX_SIZE
+#define SERIALCOMMAND_INDEX_SIZE 128    // Dispatch index slots, a power of 2 at least twice the number of events
+#endif
+#define SERIALCOMMAND_NO_ENTRY  0xFF    // Empty index slot, so a table holds up to 254 items
+#define SERIALCOMMAND_EXACT     0x01    // Event flag: must be typed in full, no prefix match
 #define MAXDELIMETER 2
 
 typedef bool (*PFunc) (const char *cmd);
 typedef struct {
 	uint8_t state;												// Current State
 	uint8_t next;													// Next State
-	char event[SERIALCOMMANDBUFFER];			// Event
+	const char *event;										// Event, "" for the state's default
 	PFunc function;												// Action
+	uint8_t flags;												// SERIALCOMMAND_EXACT, 0 if left out
 } StateMachine_t;            // Data structure to hold Command/Handler function key-value pairs
 
 class SerialCommand
@@ -83,13 +106,34 @@ class SerialCommand
 		char *first();        // returns pointer to at start of buffer (for getting arguments to commands)
 		char *next();         // returns pointer to next token found in command buffer (for getting arguments to commands)
 		bool readSerial();    // Main entry point.
+		bool fillInput();     // Moves what the port has into the receive ring, true if there is input to process
+		void setRawMode(bool on);    // Raw mode: no echo or editing, for pasted scripts
+		bool isRawMode() { return rawMode; }
 		void addDefaultHandler(PFunc = NULL);    			// A handler to call when no valid command received.
 		void SetStateMachine(const StateMachine_t *newSM, int sizeSM, uint8_t initState = 0);
 
   private:
 		char inChar;          // A character read from the serial stream
-		char buffer[SERIALCOMMANDBUFFER];   // Buffer of stored characters while waiting for terminator character
+		char prevChar;        // The one before, to take "\r\n" as one terminator
+		char buffer[SERIALCOMMAND_LINE_SIZE];   // Buffer of stored characters while waiting for terminator character
 		int  bufPos;                        // Current position in the buffer
+		bool overflow;                      // Line got longer than the buffer, it will be ignored
+		char rxRing[SERIALCOMMAND_RX_SIZE]; // Received, not processed yet
+		uint16_t rxHead;                    // Next byte written by fillInput()
+		uint16_t rxTail;                    // Next byte read by readSerial()
+		uint16_t rxPeak;                    // Most bytes the ring has held
+		char echo[SERIALCOMMAND_ECHO_SIZE]; // Echo not written yet
+		uint8_t echoLen;
+		uint8_t escState;                   // Position in an escape sequence, 0 if none
+		char history[SERIALCOMMAND_HISTORY][SERIALCOMMAND_LINE_SIZE];
+		uint8_t histCount;
+		uint8_t histNewest;                 // Index of the latest line
+		int8_t histBrowse;                  // Lines back from the latest while browsing, -1 if not
+		bool rawMode;
+		uint32_t rawLines;                  // Lines run in raw mode
+		uint32_t rawTooLong;                // and ignored for being too long
+		uint8_t dispatchIndex[SERIALCOMMAND_INDEX_SIZE];  // Hash of (state, event) -> item, open addressing
+		bool indexFull;                     // Items left out of the index, found by scanning
 		char delim[MAXDELIMETER];           // null-terminated list of character to be used as delimeters for tokenizing (default " ")
 		char *token;                        // Returned token from the command buffer as returned by strtok_r
 		char *last;                         // State variable used by strtok_r during processing
@@ -104,7 +148,16 @@ class SerialCommand
 		virtual bool callbackDefault(const char *cmd) = 0;
 
 		bool scanStateMachine();
+		void echoChar(char c);
+		void echoFlush();
+		void eraseLine();
+		void addHistory();
+		void recallHistory(bool older);
 		int findFirstCommand(uint8_t state);
+		int findCommand(uint8_t state, const char *event);
+		int findByPrefix(uint8_t state, const char *prefix, int len, int &count);
+		void buildIndex();
+		void completeLine();
 		void setCommandBuffer(const char *cmd);
 
     int numCommand;
@@ -27,6 +27,18 @@
 #include "xlxConfig.h"
 #include "xlxRF24Client.h"
 #include "xlxSerialConsole.h"
+#include "xlxOfflineCache.h"
+#include "xlxScenario.h"
+#include "xlxRuleEngine.h"
+#include "xlxScheduler.h"
+#include "xlxStatistics.h"
+#include "xlxProfiler.h"
+#include "xlxTaskList.h"
+#include "xlxNetProbe.h"
+#include "xlxConnManager.h"
+#include "xlxRFBench.h"
+#include "xlxLogger.h"
+#include "xlxCloudPublisher.h"
 
 #include "ArduinoJson.h"
 
@@ -36,6 +48,9 @@
 // make an instance for main program
 SmartRemoteClass theSys;
 
+static const char *bootPhaseNames[BOOT_PHASES] = { "power-on", "config", "radio", "wifi", "cloud", "network", "done" };
+static const char *bootResultNames[] = { "pending", "done", "skipped", "failed" };
+
 //------------------------------------------------------------------
 // Smart Controller Class
 //------------------------------------------------------------------
@@ -44,15 +59,24 @@ SmartRemoteClass::SmartRemoteClass()
 	m_isRF = false;
 	m_isLAN = false;
 	m_isWAN = false;
+	m_bootPhase = BOOT_POWER_ON;
+	m_bootPhaseStart = 0;
+	m_bootFailures = 0;
+	memset(m_bootTime, 0x00, sizeof(m_bootTime));
+	memset(m_bootResult, BOOT_ST_PENDING, sizeof(m_bootResult));
 }
 
+// Cloud function entries
+static int cf_JSONConfig(String jsonData) { return theSys.CldJSONConfig(jsonData); }
+static int cf_JSONDevStatus(String jsonData) { return theSys.CldJSONDevStatus(jsonData); }
+
 // Primitive initialization before loading configuration
 void SmartRemoteClass::Init()
 {
   // Open Serial Port
   TheSerial.begin(SERIALPORT_SPEED_DEFAULT);
 
-#ifdef SYS_SERIAL_DEBUG
+#ifdef SYS_SERIAL_WAIT
 	// Wait Serial connection so that we can see the starting information
 	while(!TheSerial.available()) { Particle.process(); }
 	SERIAL_LN(F("SmartRemote is starting..."));
@@ -66,16 +90,32 @@ void SmartRemoteClass::Init()
 	// Open ASR Interface
 	theASR.Init(SERIALPORT_SPEED_LOW);
 
+	// Index the statistics records kept so far
+	theStat.Begin(&theStatRam);
+
+	// Cloud functions, registered before the Cloud connects
+	Particle.function(CLOUD_FN_CONFIG, cf_JSONConfig);
+	Particle.function(CLOUD_FN_DEVSTATUS, cf_JSONDevStatus);
+
 	SERIAL_LN("SmartRemote is starting...SysID=%s", m_SysID.c_str());
+	BootDone(BOOT_POWER_ON);
 }
 
 // Second level initialization after loading configuration
 /// check RF2.4
 void SmartRemoteClass::InitRadio()
 {
-	// Set NetworkID
-	while(theRadio.GetNetworkID() == 0) delay(50);
-	
+	// Set NetworkID, the MAC shows up soon after WiFi.on(). Only a node ID
+	/// request needs it, so don't hold the boot if it's late.
+	UL macWait = millis();
+	while( theRadio.GetNetworkID() == 0 && millis() - macWait < RTE_MAC_WAIT_TIMEOUT ) delay(5);
+
+	// Commands that fail to go out are kept here until the link is back
+	theOffline.Begin(&theOfflineRam);
+
+	// Compile the built-in scenes
+	theScenario.InitScenes();
+
 	// Check RF2.4
 	if( CheckRF() ) {
   	if (IsRFGood())
@@ -84,6 +124,9 @@ void SmartRemoteClass::InitRadio()
   		SetStatus(STATUS_NWS);
   	}
   }
+
+	// From here on the RF worker owns the radio
+	theRFWorker.Begin();
 }
 
 /// check LAN & WAN
@@ -138,13 +181,119 @@ BOOL SmartRemoteClass::Start()
 	// Check NodeID & Send initialization Message
 	if( IsRFGood() ) ResumeRFNetwork();
 
+	// Network health is probed off the main loop
+	theNetProbe.Begin();
+
+	// Commands work from here, the network follows from the main loop
+	BootDone(BOOT_RADIO);
 	return true;
 }
 
+// Close the phase in progress and move on
+void SmartRemoteClass::BootNext(UC result, UC nextPhase)
+{
+	m_bootTime[m_bootPhase] = millis();
+	m_bootResult[m_bootPhase] = result;
+	SERIAL_LN("Boot: %s %s at %lu ms", bootPhaseNames[m_bootPhase], bootResultNames[result], m_bootTime[m_bootPhase]);
+	m_bootPhase = nextPhase;
+	m_bootPhaseStart = 0;
+	if( nextPhase == BOOT_DONE ) {
+		m_bootTime[BOOT_DONE] = m_bootTime[BOOT_NETWORK];
+		m_bootResult[BOOT_DONE] = BOOT_ST_DONE;
+	}
+}
+
+// Steps done synchronously in setup()
+void SmartRemoteClass::BootDone(UC phase)
+{
+	m_bootPhase = phase;
+	BootNext(BOOT_ST_DONE, phase + 1);
+}
+
+// Wi-Fi and Cloud bring-up, one step per call. The connections are made
+/// on the system thread; this only starts them and watches the timeouts.
+void SmartRemoteClass::ProcessBoot()
+{
+	if( IsBooted() || m_bootPhase < BOOT_WIFI ) return;
+
+	UL now = millis();
+	BOOL firstRound = (m_bootPhaseStart == 0);
+	if( firstRound ) m_bootPhaseStart = now;
+
+	switch( m_bootPhase ) {
+	// The connection manager connects, the boot phases only wait for it
+	case BOOT_WIFI:
+		if( firstRound ) {
+			WiFi.listen(false);
+			if( !WiFi.hasCredentials() ) {
+				// get credential from BLE or Serial
+				SERIAL_LN(F("will enter listening mode"));
+				WiFi.listen();
+				BootNext(BOOT_ST_SKIPPED, BOOT_CLOUD);
+				break;
+			}
+			theConnMgr.Start();
+			m_bootFailures = theConnMgr.GetFailures(CONN_WIFI);
+		}
+		if( theConnMgr.IsUp(CONN_WIFI) ) {
+			theConfig.SetWiFiStatus(true);
+			BootNext(BOOT_ST_DONE, BOOT_CLOUD);
+		} else if( theConnMgr.GetFailures(CONN_WIFI) != m_bootFailures ) {
+			if( !theConfig.GetWiFiStatus() ) {
+				SERIAL_LN(F("will enter listening mode"));
+				WiFi.listen();
+			}
+			theConfig.SetWiFiStatus(false);
+			// Must have network: keep waiting while the manager retries
+			if( theConfig.GetUseCloud() != CLOUD_MUST_CONNECT ) BootNext(BOOT_ST_FAILED, BOOT_CLOUD);
+		}
+		break;
+
+	case BOOT_CLOUD:
+		if( !theConnMgr.IsUp(CONN_WIFI) || theConfig.GetUseCloud() == CLOUD_DISABLE ) {
+			BootNext(BOOT_ST_SKIPPED, BOOT_NETWORK);
+			break;
+		}
+		if( firstRound ) m_bootFailures = theConnMgr.GetFailures(CONN_CLOUD);
+		if( theConnMgr.IsUp(CONN_CLOUD) ) {
+			BootNext(BOOT_ST_DONE, BOOT_NETWORK);
+		} else if( theConnMgr.GetFailures(CONN_CLOUD) != m_bootFailures ) {
+			// Must connect to the Cloud: keep waiting, the manager starts over from Wi-Fi
+			if( theConfig.GetUseCloud() != CLOUD_MUST_CONNECT ) BootNext(BOOT_ST_FAILED, BOOT_NETWORK);
+		}
+		break;
+
+	case BOOT_NETWORK:
+		// Status follows when the first probe comes back
+		theNetProbe.Kick();
+		InitNetwork();
+		BootNext(BOOT_ST_DONE, BOOT_DONE);
+		break;
+	}
+}
+
+void SmartRemoteClass::PrintBoot()
+{
+	SERIAL_LN("** Boot: %s, %lu ms since power on **", (IsBooted() ? "finished" : bootPhaseNames[m_bootPhase]), millis());
+	UL prevTime = 0;
+	for( UC phase = 0; phase < BOOT_PHASES; phase++ ) {
+		if( m_bootResult[phase] == BOOT_ST_PENDING ) {
+			SERIAL_LN("  %-8s pending", bootPhaseNames[phase]);
+			continue;
+		}
+		SERIAL_LN("  %-8s %-7s at %6lu ms, +%lu ms", bootPhaseNames[phase], bootResultNames[m_bootResult[phase]],
+				m_bootTime[phase], m_bootTime[phase] - prevTime);
+		prevTime = m_bootTime[phase];
+	}
+	SERIAL_LN("");
+}
+
 void SmartRemoteClass::Restart()
 {
 	theConfig.SaveConfig();
 	SetStatus(STATUS_RST);
+	theLogger.Flush(0xFFFF, true);
+	SERIAL_FLUSH(true);
 	delay(1000);
 	System.reset();
 }
@@ -159,6 +308,8 @@ void SmartRemoteClass::ResumeRFNetwork()
 		SendDeviceRegister();
 	} else {
 		// Set Radio Address
+		RFWorkerLock lock;
+		if( !lock.IsParked() ) return;
 		theRadio.setAddress(theConfig.GetNodeID(), theConfig.GetNetworkID());
 		//theRadio.setAddress(theConfig.GetNodeID(), RF24_BASE_RADIO_ID); // ToDo:test
 		// Send Presentation message
@@ -187,6 +338,7 @@ BOOL SmartRemoteClass::CheckWiFi()
 	if( WiFi.RSSI() > 0 ) {
 		m_isWAN = false;
 		m_isLAN = false;
+		theNetProbe.Reset();
 		SERIAL_LN("Wi-Fi chip error!");
 		return false;
 	}
@@ -194,6 +346,7 @@ BOOL SmartRemoteClass::CheckWiFi()
 	if( !WiFi.ready() ) {
 		m_isWAN = false;
 		m_isLAN = false;
+		theNetProbe.Reset();
 		SERIAL_LN("Wi-Fi module error!");
 		return false;
 	}
@@ -207,22 +360,9 @@ BOOL SmartRemoteClass::CheckNetwork()
 		return false;
 	}
 
-	// Check WAN
-	m_isWAN = WiFi.resolve("www.google.com");
-
-	// Check LAN if WAN is not OK
-	if( !m_isWAN ) {
-		m_isLAN = (WiFi.ping(WiFi.gatewayIP(), 3) < 3);
-		if( !m_isLAN ) {
-			SERIAL_LN("Cannot reach local gateway!");
-			m_isLAN = (WiFi.ping(WiFi.localIP(), 3) < 3);
-			if( !m_isLAN ) {
-				SERIAL_LN("Cannot reach itself!");
-			}
-		}
-	} else {
-		m_isLAN = true;
-	}
+	// WAN and LAN as of the last probe, see NetProbeClass
+	m_isWAN = theNetProbe.IsWANGood();
+	m_isLAN = theNetProbe.IsLANGood();
 
 	return true;
 }
@@ -237,38 +377,29 @@ BOOL SmartRemoteClass::IsWANGood()
 	return m_isWAN;
 }
 
-// Connect to the Cloud
+// Connect to the Cloud, without waiting: true if already connected
 BOOL SmartRemoteClass::connectCloud()
 {
 	BOOL retVal = Particle.connected();
-	if( !retVal ) {
-		SERIAL("Cloud connecting...");
-	  Particle.connect();
-	  waitFor(Particle.connected, RTE_CLOUD_CONN_TIMEOUT);
-	  retVal = Particle.connected();
-		SERIAL_LN("%s", retVal ? "OK" : "Failed");
-	}
+	if( !retVal ) theConnMgr.Reconnect(CONN_CLOUD);
   return retVal;
 }
 
-// Connect Wi-Fi
+// Connect Wi-Fi, without waiting: true if already connected
 BOOL SmartRemoteClass::connectWiFi()
 {
 	BOOL retVal = WiFi.ready();
 	if( !retVal ) {
-		SERIAL("Wi-Fi connecting...");
-	  WiFi.connect();
-	  waitFor(WiFi.ready, RTE_WIFI_CONN_TIMEOUT);
-	  retVal = WiFi.ready();
-		SERIAL_LN("%s", retVal ? "OK" : "Failed");
+		theConnMgr.Start();
+		theConnMgr.Reconnect(CONN_WIFI);
 	}
-  theConfig.SetWiFiStatus(retVal);
   return retVal;
 }
 
 // Close and reopen serial port to avoid buffer overrun
 void SmartRemoteClass::ResetSerialPort()
 {
+	SERIAL_FLUSH(true);
 	TheSerial.end();
 	TheSerial.begin(SERIALPORT_SPEED_DEFAULT);
 }
@@ -286,6 +417,8 @@ String SmartRemoteClass::GetSysVersion()
 BOOL SmartRemoteClass::CheckRF()
 {
 	// RF Server begins
+	RFWorkerLock lock;
+	if( !lock.IsParked() ) return false;
 	m_isRF = theRadio.ClientBegin();
 	if( m_isRF ) {
 		// Change it if setting is not default value
@@ -295,110 +428,158 @@ BOOL SmartRemoteClass::CheckRF()
 	return m_isRF;
 }
 
-BOOL SmartRemoteClass::SelfCheck(US ms)
+// Check RF register values even if RF is marked good, and recover
+void SmartRemoteClass::CheckRadio()
+{
+	BOOL rfOK;
+	{
+		RFWorkerLock lock;
+		// Try again next time rather than take the radio from the worker
+		if( !lock.IsParked() ) return;
+		rfOK = (IsRFGood() && theRadio.CheckConfig());
+	}
+	if( !rfOK ) {
+		if( CheckRF() ) {
+			ResumeRFNetwork();
+			SERIAL_LN(F("RF24 moudle recovered."));
+		}
+	} /*else if( !theConfig.GetPresent() ) {
+		// Send node init message if necessary
+		ResumeRFNetwork();
+	}*/
+}
+
+// Check Network, once the boot has brought it up
+void SmartRemoteClass::CheckConnection()
 {
-	static US tickSaveConfig = 0;				// must be static
-	static US tickCheckRadio = 0;				// must be static
 	static UC tickAcitveCheck = 0;
 	static UC tickWiFiOff = 0;
 
-	// Save config if it was changed
-	if (++tickSaveConfig > 30000 / ms) {	// once per 30 seconds
-		tickSaveConfig = 0;
-		theConfig.SaveConfig();
-	}
-
-  // Slow Checking: once per 10 seconds
-  if (++tickCheckRadio > 10000 / ms) {
-		// Check RF module
-		++tickAcitveCheck;
-		tickCheckRadio = 0;
-    if( !IsRFGood() || !theRadio.CheckConfig() ) {
-			// Check RF register values even if RF is marked good
-      if( CheckRF() ) {
-				ResumeRFNetwork();
-        SERIAL_LN(F("RF24 moudle recovered."));
-      }
-		} /*else if( !theConfig.GetPresent() ) {
-			// Send node init message if necessary
-			ResumeRFNetwork();
-		}*/
+	// ProcessBoot() owns Wi-Fi and Cloud until then
+	if( !IsBooted() ) return;
 
-		// Check Network
-		if( theConfig.GetWiFiStatus() ) {
-			if( !IsWANGood() || tickAcitveCheck % 5 == 0 || GetStatus() == STATUS_DIS ) {
-				InitNetwork();
-			}
+	++tickAcitveCheck;
+	if( theConfig.GetWiFiStatus() ) {
+		if( !IsWANGood() || tickAcitveCheck % 5 == 0 || GetStatus() == STATUS_DIS ) {
+			InitNetwork();
+		}
 
-			if( IsWANGood() ) { // WLAN is good
-				tickWiFiOff = 0;
-				if( !Particle.connected() ) {
-					// Cloud disconnected, try to recover
-					if( theConfig.GetUseCloud() != CLOUD_DISABLE ) {
-						connectCloud();
-					}
+		if( IsWANGood() ) { // WLAN is good, the connection manager looks after the Cloud
+			tickWiFiOff = 0;
+		} else { // WLAN is wrong
+			SERIAL_LN("WLAN if off for %d", tickWiFiOff + 1);
+			if( ++tickWiFiOff > 5 ) {
+				theConfig.SetWiFiStatus(false);
+				if( theConfig.GetUseCloud() == CLOUD_MUST_CONNECT ) {
+					SERIAL_LN("System is about to reset due to lost of network...");
+					Restart();
 				} else {
-					if( theConfig.GetUseCloud() == CLOUD_DISABLE ) {
-						Particle.disconnect();
-					}
-				}
-			} else { // WLAN is wrong
-				SERIAL_LN("WLAN if off for %d", tickWiFiOff + 1);
-				if( ++tickWiFiOff > 5 ) {
-					theConfig.SetWiFiStatus(false);
-					if( theConfig.GetUseCloud() == CLOUD_MUST_CONNECT ) {
-						SERIAL_LN("System is about to reset due to lost of network...");
-						Restart();
-					} else {
-						// Avoid keeping trying
-						SERIAL_LN("Turn off WiFi!");
-						WiFi.disconnect();
-						WiFi.off();	// In order to resume Wi-Fi, restart the application
-					}
+					// Avoid keeping trying
+					SERIAL_LN("Turn off WiFi!");
+					theConnMgr.EnableWiFi(false);
+					WiFi.disconnect();
+					WiFi.off();	// In order to resume Wi-Fi, restart the application
 				}
 			}
-		} else if( WiFi.ready() ) {
-			theConfig.SetWiFiStatus(true);
 		}
+	} else if( WiFi.ready() ) {
+		theConfig.SetWiFiStatus(true);
+	}
+}
 
-		// Daily Cloud Synchronization
-		/// TimeSync
-		theConfig.CloudTimeSync(false);
-  }
+BOOL SmartRemoteClass::IsRFGood()
+{
+	return (m_isRF && theRadio.isValid());
+}
 
-	// Check System Status
-	/*
-	if( GetStatus() == STATUS_ERR ) {
-		SERIAL_LN("System is about to reset due to STATUS_ERR...");
-		Restart();
-	}*/
+//------------------------------------------------------------------
+// Main Loop Tasks
+//------------------------------------------------------------------
+static UC tkBoot = TASK_NONE;
 
-	// ToDo:add any other potential problems to check
-	//...
+// Check and process RF2.4 messages, replay commands cached while the
+/// link was down, and keep a flood test going
+static void tk_RF()
+{
+	theRadio.ProcessReceive();
+	if( theSys.IsRFGood() ) theOffline.Replay();
+	theRFBench.Tick();
+}
 
-	delay(ms);
-	return true;
+static BOOL tk_RFReady() { return (theRFWorker.HasEvent() || theRFBench.IsDue()); }
+
+// Drains the port into the console's receive ring on every check, so a
+/// pasted script isn't lost while other tasks run
+static BOOL tk_ConsoleReady() { return theConsole.fillInput(); }
+static void tk_Console() { theConsole.processCommand(); }
+
+static BOOL tk_ASRReady() { return theASR.isReady(); }
+static void tk_ASR() { theASR.processCommand(); }
+
+// Alarms due, statistics record, then rules whose inputs changed, within
+/// the time budget; rules still pending or an alarm due wake the task again
+static BOOL tk_RulesReady() { return (theRules.GetPending() > 0 || theScheduler.IsDue()); }
+static void tk_Rules()
+{
+	theScheduler.Tick();
+	theStat.Tick();
+	theRules.SetInput(RULE_INPUT_TIME, Time.hour() * 60 + Time.minute());
+	theRules.Evaluate();
 }
 
-BOOL SmartRemoteClass::IsRFGood()
+// Pass on whatever console output is still pending, then format a few
+/// log records if the port keeps up
+static void tk_Output()
 {
-	return (m_isRF && theRadio.isValid());
+	SERIAL_FLUSH();
+	theLogger.Flush();
 }
 
-// Process all kinds of commands
-void SmartRemoteClass::ProcessCommands()
+// Keep Wi-Fi and the Cloud connected, serve the Cloud and publish to it
+static void tk_Cloud()
 {
-	// Check and process RF2.4 messages
-	theRadio.ProcessReceive();
+	theConnMgr.Tick();
+	if( Particle.connected() ) {
+		Particle.process();
+		thePublisher.Tick();
+	}
+}
 
-	// Process Console Command
-  theConsole.processCommand();
+static void tk_Boot()
+{
+	theSys.ProcessBoot();
+	if( theSys.IsBooted() ) theTasks.Enable(tkBoot, false);
+}
 
-	// Process ASR Command
-	theASR.processCommand();
+static void tk_Save() { theConfig.SaveConfig(); }
+static void tk_CheckRadio() { theSys.CheckRadio(); }
+static void tk_CheckNetwork() { theSys.CheckConnection(); }
 
+// Start network probes when due, and update the status as results come in
+static void tk_NetProbe()
+{
+	if( theNetProbe.Tick() && theSys.IsBooted() ) theSys.InitNetwork();
+}
+
+// Daily Cloud Synchronization
+static void tk_TimeSync() { theConfig.CloudTimeSync(false); }
+
+// Input sources first, so a command goes out on the same pass
+void SmartRemoteClass::InitTasks()
+{
+	theTasks.Add("rf", tk_RF, RTE_TASK_RF_POLL, tk_RFReady, PERF_RF_RECEIVE);
+	theTasks.Add("console", tk_Console, 0, tk_ConsoleReady, PERF_CONSOLE);
+	theTasks.Add("asr", tk_ASR, 0, tk_ASRReady, PERF_ASR);
 	// ToDo: process commands from other sources (Wifi, BLE)
-	// ToDo: Potentially move ReadNewRules here
+	theTasks.Add("rules", tk_Rules, RTE_TASK_RULES, tk_RulesReady, PERF_RULES);
+	theTasks.Add("output", tk_Output, RTE_TASK_OUTPUT);
+	theTasks.Add("cloud", tk_Cloud, RTE_TASK_CLOUD, NULL, PERF_CLOUD);
+	tkBoot = theTasks.Add("boot", tk_Boot, RTE_TASK_BOOT, NULL, PERF_CHECKS);
+	theTasks.Add("save", tk_Save, RTE_TASK_SAVE_CONFIG);
+	theTasks.Add("rfcheck", tk_CheckRadio, RTE_TASK_CHECK, NULL, PERF_CHECKS);
+	theTasks.Add("netcheck", tk_CheckNetwork, RTE_TASK_CHECK, NULL, PERF_CHECKS);
+	theTasks.Add("netprobe", tk_NetProbe, RTE_TASK_NETPROBE, NULL, PERF_CHECKS);
+	theTasks.Add("timesync", tk_TimeSync, RTE_TASK_CHECK, NULL, PERF_CHECKS);
 }
 
 //------------------------------------------------------------------
@@ -420,12 +601,19 @@ int SmartRemoteClass::DevSoftSwitch(BOOL sw, UC dev)
 // Copy JSON array to Hue structure
 void SmartRemoteClass::Array2Hue(JsonArray& data, Hue_t& hue)
 {
-	hue.State = data[0];
-	hue.BR = data[1];
-	hue.CCT = data[2];
-	hue.R = data[3];
-	hue.G = data[4];
-	hue.B = data[5];
+	// Walk the list once, missing elements read as 0 like data[i] did
+	long fields[6] = {0, 0, 0, 0, 0, 0};
+	UC i = 0;
+	for( JsonArray::iterator it = data.begin(); it != data.end() && i < 6; ++it ) {
+		fields[i++] = it->as<long>();
+	}
+
+	hue.State = fields[0];
+	hue.BR = fields[1];
+	hue.CCT = fields[2];
+	hue.R = fields[3];
+	hue.G = fields[4];
+	hue.B = fields[5];
 }
 
 // Format:
@@ -435,6 +623,7 @@ void SmartRemoteClass::Array2Hue(JsonArray& data, Hue_t& hue)
 /// 4. "" or "sync": synchronize with could
 int SmartRemoteClass::CldSetCurrentTime(String tmStr)
 {
+	theStat.Command(STAT_SRC_CLOUD);
 	// synchronize with cloud
 	tmStr.trim();
 	tmStr.toLowerCase();
@@ -538,3 +727,20 @@ BOOL SmartRemoteClass::SendChangeBR_CCT(UC _br, US _cct, UC dev)
 	String strCmd = String::format("%d:13:%d:%d", dev, _br, _cct);
 	return theRadio.ProcessSend(strCmd);
 }
+
+// Format: Config_t fields by name, only the given ones are changed
+/// e.g. {"timeZone":{"id":90,"offset":-300,"dst":1},"enableSpeaker":1}
+int SmartRemoteClass::CldJSONConfig(String jsonData)
+{
+	theStat.Command(STAT_SRC_CLOUD);
+	return theConfig.UpdateConfig(jsonData.c_str()) ? 0 : 1;
+}
+
+// Format: DevStatusRow_t fields by name, rings as [State,BR,CCT,R,G,B]
+/// node_id picks the row (main device if absent), new devices are added
+/// e.g. {"node_id":8,"present":1,"ring":[[1,80,3000,0,0,0],[1,80,3000,0,0,0],[0,0,2700,0,0,0]]}
+int SmartRemoteClass::CldJSONDevStatus(String jsonData)
+{
+	theStat.Command(STAT_SRC_CLOUD);
+	return theConfig.UpdateDevStatus(jsonData.c_str()) ? 0 : 1;
+}
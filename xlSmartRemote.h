@@ -8,6 +8,23 @@
 #include "MyMessage.h"
 #include "ArduinoJson.h"
 
+// Boot phases, in order. RF and the console work from BOOT_RADIO on,
+/// Wi-Fi and the Cloud come up afterwards from the main loop.
+#define BOOT_POWER_ON             0
+#define BOOT_CONFIG               1
+#define BOOT_RADIO                2
+#define BOOT_WIFI                 3
+#define BOOT_CLOUD                4
+#define BOOT_NETWORK              5
+#define BOOT_DONE                 6
+#define BOOT_PHASES               7
+
+// Outcome of a boot phase
+#define BOOT_ST_PENDING           0
+#define BOOT_ST_DONE              1
+#define BOOT_ST_SKIPPED           2
+#define BOOT_ST_FAILED            3
+
 //------------------------------------------------------------------
 // Smart Remote Class
 //------------------------------------------------------------------
@@ -18,6 +35,15 @@ private:
   BOOL m_isLAN;
   BOOL m_isWAN;
 
+  // Boot progress
+  UC m_bootPhase;                         // phase in progress
+  UL m_bootPhaseStart;                    // millis(), 0 until the phase is started
+  UL m_bootTime[BOOT_PHASES];             // millis() when each phase ended
+  UC m_bootResult[BOOT_PHASES];
+  UL m_bootFailures;                      // connection failures when the phase started
+
+  void BootNext(UC result, UC nextPhase);
+
 public:
   String m_SysID;
   String m_SysVersion;    // firmware version
@@ -31,6 +57,10 @@ public:
   void InitNetwork();
 
   BOOL Start();
+  void BootDone(UC phase);
+  void ProcessBoot();
+  BOOL IsBooted() { return (m_bootPhase >= BOOT_DONE); }
+  void PrintBoot();
   UC GetStatus();
   BOOL SetStatus(UC st);
   void ResetSerialPort();
@@ -41,7 +71,8 @@ public:
   String GetSysVersion();
 
   BOOL CheckRF();
-  BOOL SelfCheck(US ms);
+  void CheckRadio();
+  void CheckConnection();
   BOOL IsRFGood();
 
   BOOL CheckWiFi();
@@ -53,10 +84,12 @@ public:
   BOOL connectWiFi();
   BOOL connectCloud();
 
-  // Process all kinds of commands
-  void ProcessCommands();
+  // Main loop tasks
+  void InitTasks();
 
   int CldSetCurrentTime(String tmStr = "");
+  int CldJSONConfig(String jsonData);
+  int CldJSONDevStatus(String jsonData);
 
   // Device Control Functions
   int DevSoftSwitch(BOOL sw, UC dev = 0);
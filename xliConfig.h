@@ -6,8 +6,9 @@
 /*** USER DEFINES:  ***/
 #define FAILURE_HANDLING
 #define SYS_SERIAL_DEBUG
+//#define SYS_SERIAL_WAIT
 //#define SERIAL_DEBUG
-//#define MAINLOOP_TIMER
+//#define MAINLOOP_TIMER                // also print every probed task run, see xlxTaskList.cpp
 
 /**********************/
 
@@ -19,12 +20,6 @@
   #define IF_SERIAL_DEBUG(x)
 #endif
 
-#ifdef MAINLOOP_TIMER
-  #define IF_MAINLOOP_TIMER(x, name) ({unsigned long ulStart = millis(); x; SERIAL_LN("%s spent %lu ms", (name), millis() - ulStart);})
-#else
-  #define IF_MAINLOOP_TIMER(x, name) ({x;})
-#endif
-
 // Xlight Application Identification
 #define XLA_ORGANIZATION          "xlight.ca"               // Default value. Read from EEPROM
 #define XLA_PRODUCT_NAME          "XRemote"                 // Default value. Read from EEPROM
@@ -35,9 +30,17 @@
 // Running Time Environment Parameters
 #define RTE_DELAY_PUBLISH         60          // Maximum publish data refresh time in seconds
 #define RTE_DELAY_SYSTIMER        50          // System Timer interval, can be very fast, e.g. 50 means 25ms
-#define RTE_DELAY_SELFCHECK       100         // Self-check interval
+#define RTE_TASK_RF_POLL          2           // Drain the RF worker events, or poll the radio without the worker thread
+#define RTE_TASK_OUTPUT           10          // Pass on pending console output
+#define RTE_TASK_CLOUD            50          // Particle.process()
+#define RTE_TASK_BOOT             50          // Wi-Fi and Cloud bring-up steps
+#define RTE_TASK_RULES            1000        // Alarms, statistics and time of day for the rules
+#define RTE_TASK_CHECK            10000       // RF, network and time sync checks
+#define RTE_TASK_NETPROBE         1000        // Start or collect a network probe
+#define RTE_TASK_SAVE_CONFIG      30000       // Save config if it was changed
 #define RTE_WIFI_CONN_TIMEOUT     20000       // Timeout for attempting to connect WIFI
-#define RTE_CLOUD_CONN_TIMEOUT    3000        // Timeout for connecting to the Cloud
+#define RTE_CLOUD_CONN_TIMEOUT    10000       // Timeout for connecting to the Cloud, the handshake runs in the background
+#define RTE_MAC_WAIT_TIMEOUT      200         // Wait for the Wi-Fi module MAC at boot
 
 // Number of ticks on System Timer
 #define RTE_TICK_FASTPROCESS			1						// Pace of execution of FastProcess
@@ -57,6 +60,10 @@
 // Default value for maxBaseNetworkDuration (in seconds)
 #define MAX_BASE_NETWORK_DUR    180
 
+// Cloud functions, up to 12 characters
+#define CLOUD_FN_CONFIG         "JSONConfig"
+#define CLOUD_FN_DEVSTATUS      "JSONDevSt"
+
 // Maximum JSON data length
 #define COMMAND_JSON_SIZE				64
 #define SENSORDATA_JSON_SIZE			196